@@ -0,0 +1,324 @@
+#include "pch.h"
+#include "AssetCache.h"
+#include "CookedMesh.h"
+#include "MeshData.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+#include <filesystem>
+#include <fstream>
+#include <thread>
+
+AssetCache* AssetCache::m_Instance = nullptr;
+
+namespace
+{
+	size_t GetAssetBytes(const Texture& texture)
+	{
+		return texture.GetMemorySize();
+	}
+
+	size_t GetAssetBytes(const MaterialMaps& materialMaps)
+	{
+		return materialMaps.GetMemorySize();
+	}
+
+	size_t GetAssetBytes(const MeshData& meshData)
+	{
+		return meshData.GetMemorySize();
+	}
+
+	//"Resources\vehicle.obj" and "Resources/vehicle.obj" are the same file
+	std::string NormalizePath(std::string path)
+	{
+		std::replace(path.begin(), path.end(), '\\', '/');
+		return path;
+	}
+
+	//Size and last write time of every file, part of the key so an edited file gets loaded again without reading it first
+	std::string GetFileStamps(const std::vector<std::string>& paths)
+	{
+		std::string stamps;
+		for (const std::string& path : paths) {
+
+			std::error_code error;
+			const uint64_t size = std::filesystem::file_size(path, error);
+			const auto writeTime = std::filesystem::last_write_time(path, error);
+			stamps += error ? std::string{ "|?" } : '|' + std::to_string(size) + '@' + std::to_string(writeTime.time_since_epoch().count());
+		}
+		return stamps;
+	}
+}
+
+AssetCache::AssetCache()
+	: m_Budget{ size_t(512) << 20 }
+	, m_ResidentBytes{ 0 }
+	, m_UseCounter{ 0 }
+	, m_Entries{}
+	, m_EntriesByKey{}
+	, m_EntriesByContent{}
+	, m_pLoaderPool{ std::make_unique<ThreadPool>(std::max(std::thread::hardware_concurrency(), 1u)) }
+{
+}
+
+AssetCache::~AssetCache()
+{
+}
+
+AssetHandle<Texture> AssetCache::LoadTexture(const std::string& path, ID3D11Device* pDevice, bool keepMipChain)
+{
+	const std::string normalizedPath = NormalizePath(path);
+	//The same file can be resident as a mip chain, a DirectX texture or both, and a DirectX texture belongs to the device that made it
+	const char* type = keepMipChain ? (pDevice ? "Texture (CPU+GPU)" : "Texture (CPU)") : (pDevice ? "Texture (GPU)" : "Texture (none)");
+	const std::string variant = std::string{ type } + '@' + std::to_string(reinterpret_cast<uintptr_t>(pDevice)) + '|';
+	//Without a device or a mip chain the texture stays empty, the file never gets read so the stamp alone is enough
+	const bool decoded = pDevice || keepMipChain;
+	return LoadAsset<Texture>(variant, normalizedPath, { normalizedPath }, type, decoded, [normalizedPath, pDevice, keepMipChain]() {
+		PROFILE_ZONE("LoadTexture");
+		return std::make_shared<Texture>(normalizedPath, pDevice, keepMipChain);
+		});
+}
+
+AssetHandle<MaterialMaps> AssetCache::LoadMaterialMaps(const std::string& normalMapPath, const std::string& specularMapPath, const std::string& glossinessMapPath, ID3D11Device* pDevice)
+{
+	const std::vector<std::string> paths{ NormalizePath(normalMapPath), NormalizePath(specularMapPath), NormalizePath(glossinessMapPath) };
+	const char* type = pDevice ? "Material (CPU+GPU)" : "Material (CPU)";
+	const std::string variant = std::string{ type } + '@' + std::to_string(reinterpret_cast<uintptr_t>(pDevice)) + '|';
+	return LoadAsset<MaterialMaps>(variant, paths[0] + '+' + paths[1] + '+' + paths[2], paths, type, true, [paths, pDevice]() {
+		PROFILE_ZONE("LoadMaterialMaps");
+		return MaterialMaps::Load(paths[0], paths[1], paths[2], pDevice);
+		});
+}
+
+//Maps the cooked mesh, or parses the .obj and cooks it when there is no up to date one
+AssetHandle<MeshData> AssetCache::LoadMeshData(const std::string& path)
+{
+	const std::string normalizedPath = NormalizePath(path);
+	return LoadAsset<MeshData>("Mesh|", normalizedPath, { normalizedPath }, "Mesh", true, [normalizedPath]() {
+		PROFILE_ZONE("LoadMesh");
+		return CookedMesh::Load(normalizedPath);
+		});
+}
+
+std::shared_ptr<const Texture> AssetCache::GetTexture(const std::string& path, ID3D11Device* pDevice, bool keepMipChain)
+{
+	return LoadTexture(path, pDevice, keepMipChain).Get();
+}
+
+std::shared_ptr<const MaterialMaps> AssetCache::GetMaterialMaps(const std::string& normalMapPath, const std::string& specularMapPath, const std::string& glossinessMapPath, ID3D11Device* pDevice)
+{
+	return LoadMaterialMaps(normalMapPath, specularMapPath, glossinessMapPath, pDevice).Get();
+}
+
+std::shared_ptr<const MeshData> AssetCache::GetMeshData(const std::string& path)
+{
+	return LoadMeshData(path).Get();
+}
+
+void AssetCache::SetBudget(size_t bytes)
+{
+	std::lock_guard<std::mutex> lock{ m_Mutex };
+	m_Budget = bytes;
+	EvictUnusedLocked(m_Budget);
+}
+
+size_t AssetCache::GetBudget() const
+{
+	std::lock_guard<std::mutex> lock{ m_Mutex };
+	return m_Budget;
+}
+
+size_t AssetCache::GetResidentBytes() const
+{
+	std::lock_guard<std::mutex> lock{ m_Mutex };
+	return m_ResidentBytes;
+}
+
+void AssetCache::EvictUnused(size_t targetBytes)
+{
+	std::lock_guard<std::mutex> lock{ m_Mutex };
+	EvictUnusedLocked(targetBytes);
+}
+
+std::vector<AssetCache::AssetInformation> AssetCache::GetAssetInformation() const
+{
+	std::lock_guard<std::mutex> lock{ m_Mutex };
+	std::vector<AssetInformation> information;
+	for (const std::shared_ptr<Entry>& pEntry : m_Entries)
+		information.push_back(AssetInformation{ pEntry->Name, pEntry->Type, pEntry->Bytes, pEntry->Loaded ? pEntry->Asset.get().use_count() - 1 : -1 });
+	return information;
+}
+
+void AssetCache::PrintMemoryUsage() const
+{
+	const std::vector<AssetInformation> information = GetAssetInformation();
+	const double toMegabytes = 1.0 / (1024.0 * 1024.0);
+	std::cout << "Assets: " << information.size() << ", " << GetResidentBytes() * toMegabytes << " MB of " << GetBudget() * toMegabytes << " MB budget\n";
+	for (const AssetInformation& asset : information) {
+
+		std::cout << "  " << asset.Type << ' ' << asset.Name << ": ";
+		if (asset.References < 0)
+			std::cout << "loading\n";
+		else
+			std::cout << asset.Bytes * toMegabytes << " MB, " << asset.References << " references\n";
+	}
+}
+
+//Looks the asset up by key (the files with their size and write time), a miss starts loading right away.
+//With hashContents the loader thread hashes the contents first: when another asset has the same ones, the new key becomes an alias of it
+template<typename T, typename LoadFunction>
+AssetHandle<T> AssetCache::LoadAsset(const std::string& variant, const std::string& name, const std::vector<std::string>& paths, const char* type, bool hashContents, LoadFunction load)
+{
+	const std::string key = variant + name + GetFileStamps(paths);
+
+	std::lock_guard<std::mutex> lock{ m_Mutex };
+	auto keyIt = m_EntriesByKey.find(key);
+	if (keyIt != m_EntriesByKey.end()) {
+
+		Touch(*keyIt->second);
+		return AssetHandle<T>{ keyIt->second->Asset };
+	}
+
+	std::shared_ptr<Entry> pEntry = std::make_shared<Entry>(Entry{ name, type, {}, 0, 0, false });
+	auto pTask = std::make_shared<std::packaged_task<std::shared_ptr<const void>()>>([this, load, variant, paths, key, pEntry, hashContents]() -> std::shared_ptr<const void> {
+		if (hashContents) {
+
+			std::shared_future<std::shared_ptr<const void>> sameContents = FindSameContents(HashFiles(variant, paths), key, pEntry);
+			if (sameContents.valid())
+				return sameContents.get();
+		}
+		return load();
+		});
+	pEntry->Asset = pTask->get_future().share();
+	m_Entries.push_back(pEntry);
+	m_EntriesByKey[key] = pEntry;
+	Touch(*pEntry);
+
+	m_pLoaderPool->Submit([this, pTask, pEntry]() {
+		(*pTask)();
+		FinishLoading<T>(pEntry);
+		});
+	return AssetHandle<T>{ pEntry->Asset };
+}
+
+//Runs on the loader thread of pEntry. Returns the asset that has the same contents, pEntry is then dropped and key points to that asset.
+//Otherwise pEntry gets registered under contentHash and an empty future comes back.
+//A registered entry is always past this point, so waiting on its future can't wait on a task that is still queued
+std::shared_future<std::shared_ptr<const void>> AssetCache::FindSameContents(uint64_t contentHash, const std::string& key, const std::shared_ptr<Entry>& pEntry)
+{
+	std::lock_guard<std::mutex> lock{ m_Mutex };
+	if (contentHash == 0)
+		return {};
+
+	auto contentIt = m_EntriesByContent.find(contentHash);
+	if (contentIt == m_EntriesByContent.end()) {
+
+		m_EntriesByContent[contentHash] = pEntry;
+		return {};
+	}
+
+	std::shared_ptr<Entry> pOriginal = contentIt->second;
+	RemoveEntry(pEntry);
+	pOriginal->Name += " = " + pEntry->Name;
+	m_EntriesByKey[key] = pOriginal;
+	Touch(*pOriginal);
+	return pOriginal->Asset;
+}
+
+//Counts the loaded asset against the budget, a failed load is forgotten so the next request tries again.
+//An entry that turned into an alias is gone already, its asset is counted by the original
+template<typename T>
+void AssetCache::FinishLoading(const std::shared_ptr<Entry>& pEntry)
+{
+	std::shared_ptr<const T> pAsset;
+	try {
+		pAsset = std::static_pointer_cast<const T>(pEntry->Asset.get());
+	}
+	catch (const std::exception&) {
+	}
+
+	std::lock_guard<std::mutex> lock{ m_Mutex };
+	if (std::find(m_Entries.begin(), m_Entries.end(), pEntry) == m_Entries.end())
+		return;
+	if (!pAsset) {
+
+		RemoveEntry(pEntry);
+		return;
+	}
+
+	pEntry->Bytes = GetAssetBytes(*pAsset);
+	pEntry->Loaded = true;
+	m_ResidentBytes += pEntry->Bytes;
+
+	//The new asset is referenced by pAsset, it can't be evicted right away
+	if (m_ResidentBytes > m_Budget) {
+
+		EvictUnusedLocked(m_Budget);
+		if (m_ResidentBytes > m_Budget)
+			std::cout << "Asset cache is over its budget, every resident asset is still in use (" << m_ResidentBytes << " / " << m_Budget << " bytes)\n";
+	}
+}
+
+//Evicts unreferenced assets, least recently used first, until at most targetBytes are resident (or nothing unreferenced is left).
+//Handles that were not resolved with Get() yet don't count as references
+void AssetCache::EvictUnusedLocked(size_t targetBytes)
+{
+	std::vector<std::shared_ptr<Entry>> unused;
+	for (const std::shared_ptr<Entry>& pEntry : m_Entries)
+		if (pEntry->Loaded && pEntry->Asset.get().use_count() == 1)
+			unused.push_back(pEntry);
+
+	std::sort(unused.begin(), unused.end(), [](const std::shared_ptr<Entry>& pLeft, const std::shared_ptr<Entry>& pRight) {
+		return pLeft->LastUse < pRight->LastUse;
+		});
+
+	for (const std::shared_ptr<Entry>& pEntry : unused) {
+
+		if (m_ResidentBytes <= targetBytes)
+			break;
+		RemoveEntry(pEntry);
+	}
+}
+
+//FNV-1a over the variant and the bytes of every file, 0 when a file can't be read (those never get shared by content)
+uint64_t AssetCache::HashFiles(const std::string& variant, const std::vector<std::string>& paths) const
+{
+	const uint64_t prime = 1099511628211ull;
+	uint64_t hash = 14695981039346656037ull;
+	for (char character : variant)
+		hash = (hash ^ uint8_t(character)) * prime;
+
+	std::vector<char> buffer(size_t(1) << 16);
+	for (const std::string& path : paths) {
+
+		std::ifstream file{ path, std::ios::binary };
+		if (path.empty() || !file)
+			return 0;
+
+		while (file) {
+
+			file.read(buffer.data(), buffer.size());
+			const std::streamsize count = file.gcount();
+			for (std::streamsize i = 0; i < count; ++i)
+				hash = (hash ^ uint8_t(buffer[size_t(i)])) * prime;
+		}
+	}
+	return hash != 0 ? hash : 1;
+}
+
+void AssetCache::Touch(Entry& entry)
+{
+	entry.LastUse = ++m_UseCounter;
+}
+
+void AssetCache::RemoveEntry(const std::shared_ptr<Entry>& pEntry)
+{
+	if (pEntry->Loaded)
+		m_ResidentBytes -= pEntry->Bytes;
+	for (auto it = m_EntriesByKey.begin(); it != m_EntriesByKey.end();)
+		it = it->second == pEntry ? m_EntriesByKey.erase(it) : std::next(it);
+	for (auto it = m_EntriesByContent.begin(); it != m_EntriesByContent.end();)
+		it = it->second == pEntry ? m_EntriesByContent.erase(it) : std::next(it);
+	auto entryIt = std::find(m_Entries.begin(), m_Entries.end(), pEntry);
+	if (entryIt != m_Entries.end())
+		m_Entries.erase(entryIt);
+}
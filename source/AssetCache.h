@@ -0,0 +1,120 @@
+#pragma once
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Texture.h"
+
+class MeshData;
+class ThreadPool;
+
+//Asset that is loaded or still loading on the threads of the AssetCache
+template<typename T>
+class AssetHandle final
+{
+public:
+	AssetHandle() = default;
+	AssetHandle(std::shared_ptr<const T> pAsset) {
+		std::promise<std::shared_ptr<const void>> loaded;
+		loaded.set_value(std::move(pAsset));
+		m_Future = loaded.get_future().share();
+	}
+	explicit AssetHandle(std::shared_future<std::shared_ptr<const void>> future)
+		: m_Future{ std::move(future) }
+	{
+	}
+
+	bool IsValid() const {
+		return m_Future.valid();
+	}
+	bool IsReady() const {
+		return m_Future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+	}
+	//Waits until the asset is loaded, errors of the loading thread (like a missing .obj file) get thrown here
+	std::shared_ptr<const T> Get() const {
+		return std::static_pointer_cast<const T>(m_Future.get());
+	}
+private:
+	std::shared_future<std::shared_ptr<const void>> m_Future;
+};
+
+//Hands out shared textures and meshes, so every file gets decoded and uploaded once.
+//Assets are found by path, size and write time of their files. The loader threads hash the contents before loading,
+//so a copy of a file under another name is loaded once as well. Empty placeholder textures skip the hash, they never read their file.
+//Loading happens on a thread pool of its own: Load...() starts the work and returns a handle right away, Get...() waits for it.
+//The cache keeps every asset resident after its last user is gone; when the resident bytes go over the budget,
+//the least recently used assets nobody references anymore get evicted.
+class AssetCache final
+{
+public:
+	struct AssetInformation {
+		std::string Name;
+		std::string Type;
+		size_t Bytes;
+		long References; //Handles outside of the cache, -1 while loading
+	};
+
+	static AssetCache* GetInstance() {
+		if (m_Instance == nullptr) {
+			m_Instance = new AssetCache();
+		}
+		return m_Instance;
+	}
+	~AssetCache();
+	AssetCache(const AssetCache& other) = delete;
+	AssetCache& operator=(const AssetCache& other) = delete;
+	AssetCache(AssetCache&& other) = delete;
+	AssetCache& operator=(AssetCache&& other) = delete;
+
+	//pDevice and keepMipChain are passed on to Texture, they are part of the key (the device by its address)
+	AssetHandle<Texture> LoadTexture(const std::string& path, ID3D11Device* pDevice, bool keepMipChain = true);
+	//pDevice is part of the key like for LoadTexture, the separate DirectX maps and the packed texture come from one decode of every file
+	AssetHandle<MaterialMaps> LoadMaterialMaps(const std::string& normalMapPath, const std::string& specularMapPath, const std::string& glossinessMapPath, ID3D11Device* pDevice);
+	AssetHandle<MeshData> LoadMeshData(const std::string& path);
+	std::shared_ptr<const Texture> GetTexture(const std::string& path, ID3D11Device* pDevice, bool keepMipChain = true);
+	std::shared_ptr<const MaterialMaps> GetMaterialMaps(const std::string& normalMapPath, const std::string& specularMapPath, const std::string& glossinessMapPath, ID3D11Device* pDevice);
+	std::shared_ptr<const MeshData> GetMeshData(const std::string& path);
+
+	void SetBudget(size_t bytes);
+	size_t GetBudget() const;
+	size_t GetResidentBytes() const;
+	void EvictUnused(size_t targetBytes = 0);
+
+	std::vector<AssetInformation> GetAssetInformation() const;
+	void PrintMemoryUsage() const;
+private:
+	AssetCache();
+
+	struct Entry {
+		std::string Name;
+		const char* Type;
+		std::shared_future<std::shared_ptr<const void>> Asset;
+		size_t Bytes; //0 until loaded
+		uint64_t LastUse;
+		bool Loaded;
+	};
+
+	//Variables
+	static AssetCache* m_Instance;
+	mutable std::mutex m_Mutex; //Guards everything below, the loading itself runs without it
+	size_t m_Budget;
+	size_t m_ResidentBytes;
+	uint64_t m_UseCounter;
+	std::vector<std::shared_ptr<Entry>> m_Entries;
+	std::unordered_map<std::string, std::shared_ptr<Entry>> m_EntriesByKey;
+	std::unordered_map<uint64_t, std::shared_ptr<Entry>> m_EntriesByContent;
+	std::unique_ptr<ThreadPool> m_pLoaderPool; //Last, its threads stop before the entries go away
+
+	//Functions
+	template<typename T, typename LoadFunction>
+	AssetHandle<T> LoadAsset(const std::string& variant, const std::string& name, const std::vector<std::string>& paths, const char* type, bool hashContents, LoadFunction load);
+	std::shared_future<std::shared_ptr<const void>> FindSameContents(uint64_t contentHash, const std::string& key, const std::shared_ptr<Entry>& pEntry);
+	template<typename T>
+	void FinishLoading(const std::shared_ptr<Entry>& pEntry);
+	uint64_t HashFiles(const std::string& variant, const std::vector<std::string>& paths) const;
+	void Touch(Entry& entry);
+	void RemoveEntry(const std::shared_ptr<Entry>& pEntry);
+	void EvictUnusedLocked(size_t targetBytes);
+};
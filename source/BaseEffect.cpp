@@ -4,6 +4,8 @@
 
 BaseEffect::BaseEffect(ID3D11Device* pDevice, const std::wstring& assetFile)
 	: m_Type{ }
+	, m_CullMode{ Culling::Back }
+	, m_SampleMode{ SampleMode::Point }
 	, m_pEffect{ }
 	, m_pTechnique{ }
 	, m_pSampler{ }
@@ -21,6 +23,10 @@ BaseEffect::BaseEffect(ID3D11Device* pDevice, const std::wstring& assetFile)
 	, m_pMatWorldMatrixVariable{ }
 	, m_pDiffuseMapVariable{ }
 {
+	//Headless (no device), the effect only holds the settings the software rasterizer uses
+	if (!pDevice)
+		return;
+
 	m_pEffect = LoadEffect(pDevice, assetFile);
 
 	m_pTechnique = m_pEffect->GetTechniqueByName("DefaultTechnique");
@@ -134,6 +140,11 @@ BaseEffect::Culling BaseEffect::GetCullMode() const
 	return m_CullMode;
 }
 
+BaseEffect::SampleMode BaseEffect::GetSampleMode() const
+{
+	return m_SampleMode;
+}
+
 void BaseEffect::CreateSamplers(ID3D11Device* pDevice)
 {
 	auto data = Elite::FPoint4(0.0f, 0.0f, 1.0f, 1.0f).data[0];
@@ -36,6 +36,7 @@ public:
 	
 	virtual float GetShininess() const;
 	virtual Culling GetCullMode() const;
+	virtual SampleMode GetSampleMode() const;
 	//This function only works for certain effects
 	virtual void SetTransparency(bool state) = 0;
 	//This function only works for certain effects
@@ -44,6 +45,7 @@ public:
 protected:
 	EffectType m_Type;
 	Culling m_CullMode;
+	SampleMode m_SampleMode; //The software rasterizer reads this, Point: point, Linear: bilinear, Anisotropic: trilinear
 	ID3DX11Effect* m_pEffect;
 
 	//Everything below gets auto release when his parent (m_pEffect) gets released
@@ -0,0 +1,729 @@
+#include "pch.h"
+//#undef main
+
+//Standard includes
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+//Project includes
+#include "ERenderer.h"
+#include "Structs.h"
+#include "SceneGraph.h"
+#include "CameraManager.h"
+#include "EffectManager.h"
+#include "ObjParser.h"
+#include "AssetCache.h"
+#include "MeshData.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "Profiler.h"
+#include "Rasterizer.h"
+
+//Headless benchmark of the software rasterizer, every scene is rendered for every resolution and thread count
+//and the results get written as JSON.
+//--self-check hiz renders the same scenes with and without the Hi-Z rejection instead and fails when the frames differ,
+//--self-check coverage rasterizes --frames jittered triangle grids with the fixed point rules and fails when a pixel isn't drawn exactly once.
+
+struct Resolution {
+
+	uint32_t Width;
+	uint32_t Height;
+};
+
+struct BenchmarkOptions {
+
+	uint32_t NrOfWarmUpFrames = 10;
+	uint32_t NrOfFrames = 100;
+	std::string OutputPath = "benchmark.json";
+	RasterizationMode Mode = RasterizationMode::SIMD;
+	bool QuantizedVertices = false;
+	bool DepthRendering = false; //Depth-only view, the pixels per second count the depth writes instead of the shaded pixels
+	float LodErrorThreshold = 1.f; //Pixels, negative turns the level of detail selection off
+	std::vector<std::string> Scenes = { "vehicle", "small_triangles", "huge_triangles", "overdraw" };
+	std::vector<Resolution> Resolutions = { { 640, 480 }, { 1280, 720 }, { 1920, 1080 } };
+	std::vector<uint32_t> ThreadCounts;
+	std::vector<std::string> ObjPaths = { "Resources/vehicle.obj", "Resources/fireFX.obj" };
+	uint32_t NrOfParseRuns = 10;
+	std::string SelfCheck; //"hiz" or "coverage", empty runs the benchmark
+};
+
+struct BenchmarkResult {
+
+	std::string Scene;
+	Resolution Size;
+	uint32_t NrOfThreads;
+	std::vector<double> FrameMilliseconds;
+	uint64_t NrOfTriangles; //Submitted per frame
+	uint64_t VertexBytes; //Read by the vertex transformation per frame
+	uint64_t NrOfTrianglesSaved; //Left out by the levels of detail per frame
+	uint64_t NrOfPixels; //Shaded (or depth written in the depth-only view) over all measured frames
+	std::vector<Profiler::StageStatistics> Stages;
+};
+
+struct ParseResult {
+
+	std::string Path;
+	size_t Bytes;
+	size_t NrOfVertices;
+	size_t NrOfTriangles;
+	size_t VertexBytes; //InputVertex buffer
+	size_t QuantizedVertexBytes; //QuantizedVertex buffer
+	std::vector<double> Milliseconds;
+	MeshOptimizer::Statistics Parsed; //Triangle order of the file
+	MeshOptimizer::Statistics Optimized; //Triangle order of the cooked mesh
+	std::vector<uint32_t> LodTriangles; //Triangles of the levels of detail of the cooked mesh
+};
+
+void PrintUsage() {
+
+	std::cout << "Usage: benchmark [--frames N] [--warmup N] [--output file.json] [--mode reference|simd|fixedpoint]\n";
+	std::cout << "                 [--vertex-format float|quantized] [--lod-threshold pixels|off] [--view shaded|depth]\n";
+	std::cout << "                 [--scenes vehicle,small_triangles,huge_triangles,overdraw] [--resolutions 640x480,1280x720] [--threads 1,2,4]\n";
+	std::cout << "                 [--obj a.obj,b.obj|none] [--parse-runs N] [--self-check hiz|coverage]\n";
+	std::cout << "Scenes: vehicle, small_triangles, huge_triangles, overdraw, random_triangles\n";
+}
+
+std::vector<std::string> SplitList(const std::string& list) {
+
+	std::vector<std::string> items;
+	std::stringstream stream{ list };
+	std::string item;
+	while (std::getline(stream, item, ','))
+		if (!item.empty())
+			items.push_back(item);
+	return items;
+}
+
+//Returns false if the arguments could not be parsed
+bool ParseCommandLine(int argc, char* args[], BenchmarkOptions& options) {
+
+	//1, 2, 4, ... up to (and including) the amount of cores
+	const uint32_t nrOfCores = std::max(std::thread::hardware_concurrency(), 1u);
+	for (uint32_t nrOfThreads = 1; nrOfThreads < nrOfCores; nrOfThreads *= 2)
+		options.ThreadCounts.push_back(nrOfThreads);
+	options.ThreadCounts.push_back(nrOfCores);
+
+	try {
+		for (int i = 1; i < argc; ++i) {
+
+			const std::string argument = args[i];
+			if (i + 1 >= argc)
+				return false;
+
+			const std::string value = args[++i];
+			if (argument == "--frames")
+				options.NrOfFrames = uint32_t(std::stoul(value));
+			else if (argument == "--warmup")
+				options.NrOfWarmUpFrames = uint32_t(std::stoul(value));
+			else if (argument == "--output")
+				options.OutputPath = value;
+			else if (argument == "--mode") {
+
+				if (value == "reference")
+					options.Mode = RasterizationMode::Reference;
+				else if (value == "simd")
+					options.Mode = RasterizationMode::SIMD;
+				else if (value == "fixedpoint")
+					options.Mode = RasterizationMode::FixedPoint;
+				else
+					return false;
+			}
+			else if (argument == "--vertex-format") {
+
+				if (value == "float")
+					options.QuantizedVertices = false;
+				else if (value == "quantized")
+					options.QuantizedVertices = true;
+				else
+					return false;
+			}
+			else if (argument == "--view") {
+
+				if (value == "shaded")
+					options.DepthRendering = false;
+				else if (value == "depth")
+					options.DepthRendering = true;
+				else
+					return false;
+			}
+			else if (argument == "--lod-threshold")
+				options.LodErrorThreshold = value == "off" ? -1.f : std::stof(value);
+			else if (argument == "--scenes")
+				options.Scenes = SplitList(value);
+			else if (argument == "--resolutions") {
+
+				options.Resolutions.clear();
+				for (const std::string& item : SplitList(value)) {
+
+					const size_t separator = item.find('x');
+					if (separator == std::string::npos)
+						return false;
+					options.Resolutions.push_back(Resolution{ uint32_t(std::stoul(item.substr(0, separator))), uint32_t(std::stoul(item.substr(separator + 1))) });
+				}
+			}
+			else if (argument == "--obj")
+				options.ObjPaths = value == "none" ? std::vector<std::string>{} : SplitList(value);
+			else if (argument == "--parse-runs")
+				options.NrOfParseRuns = std::max(uint32_t(std::stoul(value)), 1u);
+			else if (argument == "--self-check") {
+
+				if (value != "hiz" && value != "coverage")
+					return false;
+				options.SelfCheck = value;
+			}
+			else if (argument == "--threads") {
+
+				options.ThreadCounts.clear();
+				for (const std::string& item : SplitList(value))
+					options.ThreadCounts.push_back(std::max(uint32_t(std::stoul(item)), 1u));
+			}
+			else
+				return false;
+		}
+	}
+	catch (const std::exception&) {
+		return false;
+	}
+
+	return options.NrOfFrames > 0 && !options.Scenes.empty() && !options.Resolutions.empty() && !options.ThreadCounts.empty();
+}
+
+//Adds a width x height plane at depth z, facing the camera and split in nrOfColumns x nrOfRows quads
+void AddPlane(std::vector<InputVertex>& vertices, std::vector<uint32_t>& indices, float width, float height, float z, uint32_t nrOfColumns, uint32_t nrOfRows) {
+
+	const uint32_t firstVertex = (uint32_t)vertices.size();
+	for (uint32_t row = 0; row <= nrOfRows; ++row) {
+		for (uint32_t column = 0; column <= nrOfColumns; ++column) {
+
+			const float u = float(column) / nrOfColumns;
+			const float v = float(row) / nrOfRows;
+			vertices.push_back(InputVertex{ { (u - 0.5f) * width, (0.5f - v) * height, z }, { u, v }, { 0.f, 0.f, 1.f }, { 1.f, 0.f, 0.f }, { 1.f, 1.f, 1.f } });
+		}
+	}
+
+	for (uint32_t row = 0; row < nrOfRows; ++row) {
+		for (uint32_t column = 0; column < nrOfColumns; ++column) {
+
+			const uint32_t topLeft = firstVertex + column + row * (nrOfColumns + 1);
+			const uint32_t bottomLeft = topLeft + nrOfColumns + 1;
+			indices.insert(indices.end(), { topLeft, bottomLeft, topLeft + 1, topLeft + 1, bottomLeft, bottomLeft + 1 });
+		}
+	}
+}
+
+//Returns false for unknown scenes
+bool CreateScene(const std::string& scene, const Resolution& resolution) {
+
+	SceneGraph::GetInstance()->ClearObjects();
+	CameraManager::GetInstance()->ClearCameras();
+
+	if (scene == "vehicle") {
+
+		//Same scene as the application
+		CameraManager::GetInstance()->AddNewCamera(new Camera{ { 0.f, 5.f, 35.f }, { 0.f, 0.f, 1.f }, float(resolution.Width), float(resolution.Height) });
+
+		const Mesh::Assets vehicleAssets = Mesh::LoadAssets("Resources/vehicle.obj", "Resources/vehicle_diffuse.png", "Resources/vehicle_normal.png", "Resources/vehicle_specular.png", "Resources/vehicle_gloss.png", nullptr);
+		const Mesh::Assets flameAssets = Mesh::LoadAssets("Resources/fireFX.obj", "Resources/fireFX_diffuse.png", "", "", "", nullptr);
+		SceneGraph::GetInstance()->AddObjectToGraph(new Mesh{ true, {}, vehicleAssets, nullptr, EffectManager::GetInstance()->GetEffect("VehicleEffect") });
+
+		SceneGraph::GetInstance()->AddObjectToGraph(new Mesh{ true, {}, flameAssets, nullptr, EffectManager::GetInstance()->GetEffect("FlameEffect") });
+		return true;
+	}
+
+	//The synthetic scenes are planes in front of a camera at 10 units, a 40 x 40 plane at z = 0 covers the screen
+	std::vector<InputVertex> vertices;
+	std::vector<uint32_t> indices;
+	if (scene == "small_triangles") {
+
+		//About one triangle per 2 x 2 pixels at 1280x720
+		AddPlane(vertices, indices, 40.f, 40.f, 0.f, 640, 360);
+	}
+	else if (scene == "huge_triangles") {
+
+		//One plane that fills the screen and one far past the guard band behind it
+		AddPlane(vertices, indices, 40.f, 40.f, 0.f, 1, 1);
+		AddPlane(vertices, indices, 4000.f, 4000.f, -20.f, 1, 1);
+	}
+	else if (scene == "overdraw") {
+
+		//Screen filling planes drawn back to front, every layer passes the depth test
+		for (int layer = 0; layer < 16; ++layer)
+			AddPlane(vertices, indices, 40.f, 40.f, -8.f + 0.5f * layer, 4, 4);
+	}
+	else if (scene == "random_triangles") {
+
+		//Triangles of every size at random depths, with slopes, overlapping in every order.
+		//A fixed seed so every run and every renderer gets the same scene
+		std::mt19937 generator{ 1234 };
+		std::uniform_real_distribution<float> unit{ -1.f, 1.f };
+		for (uint32_t i = 0; i < 4000; ++i) {
+
+			const float size = 0.05f * std::pow(2.f, 4.f + 4.f * unit(generator));
+			const Elite::FPoint3 center{ 18.f * unit(generator), 18.f * unit(generator), -2.f + 6.f * unit(generator) };
+			const uint32_t firstVertex = (uint32_t)vertices.size();
+			for (int corner = 0; corner < 3; ++corner) {
+
+				const Elite::FPoint3 position{ center.x + size * unit(generator), center.y + size * unit(generator), center.z + 0.5f * size * unit(generator) };
+				vertices.push_back(InputVertex{ position, { 0.5f + 0.5f * unit(generator), 0.5f + 0.5f * unit(generator) }, { 0.f, 0.f, 1.f }, { 1.f, 0.f, 0.f }, { 1.f, 1.f, 1.f } });
+			}
+			indices.insert(indices.end(), { firstVertex, firstVertex + 1, firstVertex + 2 });
+		}
+	}
+	else
+		return false;
+
+	CameraManager::GetInstance()->AddNewCamera(new Camera{ { 0.f, 0.f, 10.f }, { 0.f, 0.f, 1.f }, float(resolution.Width), float(resolution.Height) });
+	Mesh::Assets assets = Mesh::LoadAssets("", "Resources/vehicle_diffuse.png", "", "", "", nullptr);
+	MeshData meshData{ std::move(vertices), std::move(indices) };
+	meshData.Quantize();
+	assets.Geometry = AssetHandle<MeshData>{ std::make_shared<const MeshData>(std::move(meshData)) };
+	SceneGraph::GetInstance()->AddObjectToGraph(new Mesh{ false, {}, assets, nullptr, EffectManager::GetInstance()->GetEffect("SyntheticEffect") });
+	return true;
+}
+
+BenchmarkResult RunBenchmark(const BenchmarkOptions& options, const std::string& scene, const Resolution& resolution, uint32_t nrOfThreads) {
+
+	Elite::Renderer renderer{ resolution.Width, resolution.Height };
+	renderer.SetNrOfThreads(nrOfThreads);
+	renderer.SetRasterizationMode(options.Mode);
+	renderer.SetQuantizedVertices(options.QuantizedVertices);
+	renderer.SetLodSelection(options.LodErrorThreshold >= 0.f);
+	renderer.SetLodErrorThreshold(options.LodErrorThreshold);
+	renderer.SetDepthRendering(options.DepthRendering);
+
+	BenchmarkResult result{ scene, resolution, nrOfThreads, {}, 0, 0, 0, 0, {} };
+	result.FrameMilliseconds.reserve(options.NrOfFrames);
+
+	//Every frame advances the scene by 1/60th of a second, so all runs see the same frames
+	const float frameTime = 1.f / 60.f;
+	const double countsToMilliseconds = 1000.0 / double(SDL_GetPerformanceFrequency());
+	for (uint32_t frame = 0; frame < options.NrOfWarmUpFrames + options.NrOfFrames; ++frame) {
+
+		const uint64_t start = SDL_GetPerformanceCounter();
+		renderer.Render();
+		const uint64_t end = SDL_GetPerformanceCounter();
+
+		if (frame >= options.NrOfWarmUpFrames) {
+
+			result.FrameMilliseconds.push_back(double(end - start) * countsToMilliseconds);
+			for (const MeshStatistics& mesh : renderer.GetFrameStatistics().Meshes) {
+
+				result.NrOfTriangles += mesh.TrianglesSubmitted;
+				result.VertexBytes += mesh.VertexBytesRead;
+				result.NrOfTrianglesSaved += mesh.TrianglesSaved;
+				result.NrOfPixels += options.DepthRendering ? mesh.PixelsDepthPassed : mesh.PixelsShaded;
+			}
+		}
+
+		SceneGraph::GetInstance()->Update(frameTime);
+	}
+
+	//The profiler keeps exactly the measured frames, the pixels stay a total for the pixels per second
+	result.NrOfTriangles /= options.NrOfFrames;
+	result.VertexBytes /= options.NrOfFrames;
+	result.NrOfTrianglesSaved /= options.NrOfFrames;
+	result.Stages = Profiler::GetInstance()->GetStageStatistics();
+	return result;
+}
+
+//Renders the scene with and without the Hi-Z rejection, which may only skip work and never change a pixel.
+//Returns the amount of frames where the color or the depth buffer differ
+uint32_t RunHiZSelfCheck(const BenchmarkOptions& options, RasterizationMode mode, const Resolution& resolution, uint32_t nrOfThreads) {
+
+	Elite::Renderer renderers[2]{ { resolution.Width, resolution.Height }, { resolution.Width, resolution.Height } };
+	for (int i = 0; i < 2; ++i) {
+
+		renderers[i].SetNrOfThreads(nrOfThreads);
+		renderers[i].SetRasterizationMode(mode);
+		renderers[i].SetQuantizedVertices(options.QuantizedVertices);
+		renderers[i].SetLodSelection(options.LodErrorThreshold >= 0.f);
+		renderers[i].SetLodErrorThreshold(options.LodErrorThreshold);
+		renderers[i].SetDepthRendering(options.DepthRendering);
+		renderers[i].SetHiZ(i == 0);
+	}
+
+	uint32_t nrOfFailedFrames = 0;
+	std::vector<uint8_t> colors[2];
+	for (uint32_t frame = 0; frame < options.NrOfFrames; ++frame) {
+
+		for (int i = 0; i < 2; ++i) {
+
+			renderers[i].Render();
+			renderers[i].ReadColorBuffer(colors[i]);
+		}
+
+		uint32_t nrOfDifferentPixels = 0;
+		const std::vector<float>& depthWithHiZ = renderers[0].GetDepthBuffer();
+		const std::vector<float>& depthWithoutHiZ = renderers[1].GetDepthBuffer();
+		for (size_t pixel = 0; pixel < depthWithHiZ.size(); ++pixel)
+			nrOfDifferentPixels += depthWithHiZ[pixel] != depthWithoutHiZ[pixel] || std::memcmp(&colors[0][pixel * 4], &colors[1][pixel * 4], 4) != 0;
+
+		if (nrOfDifferentPixels > 0) {
+
+			std::cout << "  frame " << frame << ": " << nrOfDifferentPixels << " pixels differ\n";
+			++nrOfFailedFrames;
+		}
+		SceneGraph::GetInstance()->Update(1.f / 60.f);
+	}
+	return nrOfFailedFrames;
+}
+
+//Adds the pixels of the triangle to the coverage counts, with the fixed point setup and 8x8 block tests of RasterizationMode::FixedPoint
+void RasterizeFixedPointCoverage(std::vector<uint32_t>& coverage, uint32_t width, uint32_t height, const Elite::FPoint4& v0, const Elite::FPoint4& v1, const Elite::FPoint4& v2) {
+
+	const uint32_t blockSize = 8;
+	BinnedTriangle triangle{};
+	if (!Rasterizer::SetupFixedPointTriangle(triangle, v0, v1, v2))
+		return;
+
+	for (uint32_t blockY = 0; blockY < height; blockY += blockSize) {
+		for (uint32_t blockX = 0; blockX < width; blockX += blockSize) {
+
+			int32_t startValues[3];
+			int testedEdges;
+			if (Rasterizer::ClassifyFixedPointBlock(triangle, blockX, blockY, blockSize, startValues, testedEdges) == Rasterizer::BlockCoverage::Outside)
+				continue;
+
+			int32_t rowValues[3];
+			for (uint32_t r = blockY; r < blockY + blockSize; ++r) {
+
+				for (int i = 0; i < 3; ++i)
+					rowValues[i] = startValues[i] + int32_t(triangle.FixedPointEdges[i].B * Rasterizer::SubPixelScale) * int32_t(r - blockY);
+
+				Rasterizer::FixedPointEdgeBlock4 block{ rowValues, triangle, testedEdges };
+				for (uint32_t c = blockX; c < blockX + blockSize; c += 4, block.StepX()) {
+
+					const int mask = block.CoverageMask();
+					for (uint32_t lane = 0; lane < 4; ++lane)
+						coverage[c + lane + (r * width)] += (mask >> lane) & 1;
+				}
+			}
+		}
+	}
+}
+
+//Splits a screen in a grid of quads with jittered inner vertices, some of them on pixel centers and every quad cut along a random diagonal.
+//The triangles share their edges and tile the screen, so the top-left rule has to draw every pixel exactly once.
+//Returns the amount of grids where a pixel was missed or drawn more than once
+uint32_t RunCoverageSelfCheck(const BenchmarkOptions& options) {
+
+	const uint32_t width = 128;
+	const uint32_t height = 128;
+	const int nrOfCells = 6;
+	const float cellWidth = float(width) / nrOfCells;
+	const float cellHeight = float(height) / nrOfCells;
+
+	//Up to a quarter of a cell, so the quads never fold over
+	std::mt19937 generator{ 1234 };
+	std::uniform_real_distribution<float> jitter{ -0.25f, 0.25f };
+	std::uniform_int_distribution<int> coin{ 0, 1 };
+	std::uniform_int_distribution<int> die{ 0, 2 };
+
+	uint32_t nrOfFailedGrids = 0;
+	std::vector<uint32_t> coverage(width * height);
+	std::vector<Elite::FPoint4> grid((nrOfCells + 1) * (nrOfCells + 1));
+	for (uint32_t frame = 0; frame < options.NrOfFrames; ++frame) {
+
+		for (int y = 0; y <= nrOfCells; ++y) {
+			for (int x = 0; x <= nrOfCells; ++x) {
+
+				float px = x * cellWidth;
+				float py = y * cellHeight;
+				if (x > 0 && x < nrOfCells)
+					px += jitter(generator) * cellWidth;
+				if (y > 0 && y < nrOfCells)
+					py += jitter(generator) * cellHeight;
+
+				//Vertices on pixel centers put pixels exactly on the edges
+				if (die(generator) == 0)
+					px = std::floor(px) + 0.5f;
+				if (die(generator) == 0)
+					py = std::floor(py) + 0.5f;
+				grid[x + y * (nrOfCells + 1)] = Elite::FPoint4{ px, py, 0.5f, 1.f };
+			}
+		}
+
+		std::fill(coverage.begin(), coverage.end(), 0);
+		for (int y = 0; y < nrOfCells; ++y) {
+			for (int x = 0; x < nrOfCells; ++x) {
+
+				const Elite::FPoint4& topLeft = grid[x + y * (nrOfCells + 1)];
+				const Elite::FPoint4& topRight = grid[x + 1 + y * (nrOfCells + 1)];
+				const Elite::FPoint4& bottomLeft = grid[x + (y + 1) * (nrOfCells + 1)];
+				const Elite::FPoint4& bottomRight = grid[x + 1 + (y + 1) * (nrOfCells + 1)];
+				if (coin(generator) == 0) {
+
+					RasterizeFixedPointCoverage(coverage, width, height, topLeft, topRight, bottomRight);
+					RasterizeFixedPointCoverage(coverage, width, height, topLeft, bottomRight, bottomLeft);
+				}
+				else {
+					RasterizeFixedPointCoverage(coverage, width, height, topRight, bottomLeft, topLeft);
+					RasterizeFixedPointCoverage(coverage, width, height, topRight, bottomRight, bottomLeft);
+				}
+			}
+		}
+
+		uint32_t nrOfHoles = 0;
+		uint32_t nrOfDoubles = 0;
+		for (uint32_t count : coverage) {
+
+			nrOfHoles += count == 0;
+			nrOfDoubles += count > 1;
+		}
+
+		if (nrOfHoles > 0 || nrOfDoubles > 0) {
+
+			std::cout << "  grid " << frame << ": " << nrOfHoles << " pixels missed, " << nrOfDoubles << " pixels drawn more than once\n";
+			++nrOfFailedGrids;
+		}
+	}
+	return nrOfFailedGrids;
+}
+
+//Parses every .obj file a couple of times, after one run that gets the file into the OS cache.
+//The time includes building the vertex and index buffers, like the loading of a mesh
+std::vector<ParseResult> RunParseBenchmark(const BenchmarkOptions& options) {
+
+	//One parser for every run, like a loader thread that keeps its scratch buffers
+	ObjParser parser{};
+	std::vector<ParseResult> results;
+	const double countsToMilliseconds = 1000.0 / double(SDL_GetPerformanceFrequency());
+	for (const std::string& path : options.ObjPaths) {
+
+		ParseResult result{ path, 0, 0, 0, 0, 0, {}, {}, {}, {} };
+		try {
+			const MeshData meshData = parser.Parse(path);
+			result.NrOfVertices = meshData.GetNrOfVertices();
+			result.NrOfTriangles = meshData.GetNrOfIndices() / 3;
+			result.VertexBytes = meshData.GetNrOfVertices() * sizeof(InputVertex);
+			result.QuantizedVertexBytes = meshData.GetNrOfVertices() * sizeof(QuantizedVertex);
+			result.Parsed = MeshOptimizer::Analyze(meshData);
+			const MeshData cooked = MeshSimplifier::BuildLods(MeshOptimizer::Optimize(meshData));
+			result.Optimized = MeshOptimizer::Analyze(cooked);
+			for (uint32_t lod = 0; lod < cooked.GetNrOfLods(); ++lod)
+				result.LodTriangles.push_back(cooked.GetLods()[lod].NrOfIndices / 3);
+		}
+		catch (const std::runtime_error& error) {
+
+			std::cout << error.what();
+			continue;
+		}
+		result.Bytes = (size_t)std::ifstream{ path, std::ios::binary | std::ios::ate }.tellg();
+
+		for (uint32_t run = 0; run < options.NrOfParseRuns; ++run) {
+
+			const uint64_t start = SDL_GetPerformanceCounter();
+			parser.Parse(path);
+			result.Milliseconds.push_back(double(SDL_GetPerformanceCounter() - start) * countsToMilliseconds);
+		}
+		results.push_back(std::move(result));
+	}
+	return results;
+}
+
+double GetMegabytesPerSecond(const ParseResult& result, double milliseconds) {
+
+	return double(result.Bytes) / (1024.0 * 1024.0) / (milliseconds / 1000.0);
+}
+
+//Nearest rank percentile
+double Percentile(std::vector<double> values, double percentile) {
+
+	std::sort(values.begin(), values.end());
+	const size_t rank = size_t(std::ceil(percentile / 100.0 * values.size()));
+	return values[std::min(std::max(rank, size_t(1)), values.size()) - 1];
+}
+
+void WriteJson(std::ostream& stream, const BenchmarkOptions& options, const std::vector<BenchmarkResult>& results, const std::vector<ParseResult>& parseResults) {
+
+	const char* modeNames[] = { "reference", "simd", "fixedpoint" };
+
+	stream << "{\n";
+	stream << "  \"mode\": \"" << modeNames[int(options.Mode)] << "\",\n";
+	stream << "  \"vertex_format\": \"" << (options.QuantizedVertices ? "quantized" : "float") << "\",\n";
+	stream << "  \"view\": \"" << (options.DepthRendering ? "depth" : "shaded") << "\",\n";
+	if (options.LodErrorThreshold >= 0.f)
+		stream << "  \"lod_threshold_pixels\": " << options.LodErrorThreshold << ",\n";
+	else
+		stream << "  \"lod_threshold_pixels\": null,\n";
+	stream << "  \"warmup_frames\": " << options.NrOfWarmUpFrames << ",\n";
+	stream << "  \"frames\": " << options.NrOfFrames << ",\n";
+	stream << "  \"results\": [\n";
+	for (size_t i = 0; i < results.size(); ++i) {
+
+		const BenchmarkResult& result = results[i];
+		double totalMilliseconds = 0.0;
+		for (double milliseconds : result.FrameMilliseconds)
+			totalMilliseconds += milliseconds;
+		const double meanSeconds = totalMilliseconds / result.FrameMilliseconds.size() / 1000.0;
+		const double totalSeconds = totalMilliseconds / 1000.0;
+
+		stream << "    {\n";
+		stream << "      \"scene\": \"" << result.Scene << "\",\n";
+		stream << "      \"width\": " << result.Size.Width << ",\n";
+		stream << "      \"height\": " << result.Size.Height << ",\n";
+		stream << "      \"threads\": " << result.NrOfThreads << ",\n";
+		stream << "      \"triangles_per_frame\": " << result.NrOfTriangles << ",\n";
+		stream << "      \"vertex_bytes_per_frame\": " << result.VertexBytes << ",\n";
+		stream << "      \"triangles_saved_per_frame\": " << result.NrOfTrianglesSaved << ",\n";
+		stream << "      \"mean_ms\": " << totalMilliseconds / result.FrameMilliseconds.size() << ",\n";
+		stream << "      \"p50_ms\": " << Percentile(result.FrameMilliseconds, 50.0) << ",\n";
+		stream << "      \"p99_ms\": " << Percentile(result.FrameMilliseconds, 99.0) << ",\n";
+		stream << "      \"triangles_per_second\": " << double(result.NrOfTriangles) / meanSeconds << ",\n";
+		stream << "      \"pixels_per_second\": " << double(result.NrOfPixels) / totalSeconds << ",\n";
+		stream << "      \"stage_mean_ms\": {";
+		for (size_t stage = 0; stage < result.Stages.size(); ++stage)
+			stream << (stage == 0 ? "" : ", ") << '"' << result.Stages[stage].Name << "\": " << result.Stages[stage].MeanMilliseconds;
+		stream << "},\n";
+		stream << "      \"frame_ms\": [";
+		for (size_t frame = 0; frame < result.FrameMilliseconds.size(); ++frame)
+			stream << (frame == 0 ? "" : ", ") << result.FrameMilliseconds[frame];
+		stream << "]\n";
+		stream << "    }" << (i + 1 < results.size() ? "," : "") << "\n";
+	}
+	stream << "  ],\n";
+	stream << "  \"obj_parsing\": [\n";
+	for (size_t i = 0; i < parseResults.size(); ++i) {
+
+		const ParseResult& result = parseResults[i];
+		const double medianMilliseconds = Percentile(result.Milliseconds, 50.0);
+		stream << "    {\n";
+		stream << "      \"file\": \"" << result.Path << "\",\n";
+		stream << "      \"bytes\": " << result.Bytes << ",\n";
+		stream << "      \"vertices\": " << result.NrOfVertices << ",\n";
+		stream << "      \"triangles\": " << result.NrOfTriangles << ",\n";
+		stream << "      \"vertex_bytes\": " << result.VertexBytes << ",\n";
+		stream << "      \"quantized_vertex_bytes\": " << result.QuantizedVertexBytes << ",\n";
+		stream << "      \"p50_ms\": " << medianMilliseconds << ",\n";
+		stream << "      \"megabytes_per_second\": " << GetMegabytesPerSecond(result, medianMilliseconds) << ",\n";
+		stream << "      \"acmr\": " << result.Parsed.ACMR << ",\n";
+		stream << "      \"atvr\": " << result.Parsed.ATVR << ",\n";
+		stream << "      \"overdraw\": " << result.Parsed.Overdraw << ",\n";
+		stream << "      \"optimized_acmr\": " << result.Optimized.ACMR << ",\n";
+		stream << "      \"optimized_atvr\": " << result.Optimized.ATVR << ",\n";
+		stream << "      \"optimized_overdraw\": " << result.Optimized.Overdraw << ",\n";
+		stream << "      \"lod_triangles\": [";
+		for (size_t lod = 0; lod < result.LodTriangles.size(); ++lod)
+			stream << (lod == 0 ? "" : ", ") << result.LodTriangles[lod];
+		stream << "]\n";
+		stream << "    }" << (i + 1 < parseResults.size() ? "," : "") << "\n";
+	}
+	stream << "  ]\n";
+	stream << "}\n";
+}
+
+void ReleaseSingletons() {
+
+	delete SceneGraph::GetInstance();
+	delete CameraManager::GetInstance();
+	delete EffectManager::GetInstance();
+	delete AssetCache::GetInstance();
+	delete Profiler::GetInstance();
+	SDL_Quit();
+}
+
+int main(int argc, char* args[])
+{
+	BenchmarkOptions options{};
+	if (!ParseCommandLine(argc, args, options)) {
+
+		PrintUsage();
+		return 1;
+	}
+
+	//The cameras have to be made for the rasterizer
+	if (SceneGraph::GetInstance()->GetRenderMode() != RenderMode::Rasterizer)
+		SceneGraph::GetInstance()->ToggleRenderMode();
+
+	//Without a device the effects only hold the settings of the software rasterizer
+	EffectManager::GetInstance()->AddEffect("VehicleEffect", new MaterialEffect{ nullptr, L"Resources/PosCol3D.fx" });
+	EffectManager::GetInstance()->AddEffect("FlameEffect", new FlatEffect{ nullptr, L"Resources/Transparency.fx" });
+	EffectManager::GetInstance()->AddEffect("SyntheticEffect", new MaterialEffect{ nullptr, L"Resources/PosCol3D.fx" });
+	EffectManager::GetInstance()->GetEffect("SyntheticEffect")->SetCulling(BaseEffect::Culling::None);
+
+	Profiler::GetInstance()->SetHistorySize(options.NrOfFrames);
+
+	if (options.SelfCheck == "coverage") {
+
+		const uint32_t nrOfFailedGrids = RunCoverageSelfCheck(options);
+		std::cout << "Coverage self-check " << options.NrOfFrames << " grids: " << (nrOfFailedGrids == 0 ? "passed\n" : "FAILED\n");
+
+		ReleaseSingletons();
+		return nrOfFailedGrids == 0 ? 0 : 1;
+	}
+
+	if (options.SelfCheck == "hiz") {
+
+		const std::pair<RasterizationMode, const char*> modes[] = { { RasterizationMode::SIMD, "simd" }, { RasterizationMode::FixedPoint, "fixedpoint" } };
+		bool passed = true;
+		for (const std::string& scene : options.Scenes) {
+			for (const Resolution& resolution : options.Resolutions) {
+				for (const std::pair<RasterizationMode, const char*>& mode : modes) {
+					for (uint32_t nrOfThreads : options.ThreadCounts) {
+
+						if (!CreateScene(scene, resolution)) {
+
+							std::cout << "Unknown scene: " << scene << '\n';
+							PrintUsage();
+							return 1;
+						}
+
+						const uint32_t nrOfFailedFrames = RunHiZSelfCheck(options, mode.first, resolution, nrOfThreads);
+						std::cout << "Hi-Z self-check " << scene << ' ' << resolution.Width << 'x' << resolution.Height << ' ' << mode.second << ' ' << nrOfThreads << " threads: "
+							<< (nrOfFailedFrames == 0 ? "passed\n" : "FAILED\n");
+						passed = passed && nrOfFailedFrames == 0;
+					}
+				}
+			}
+		}
+
+		ReleaseSingletons();
+		return passed ? 0 : 1;
+	}
+
+	std::vector<BenchmarkResult> results;
+	for (const std::string& scene : options.Scenes) {
+		for (const Resolution& resolution : options.Resolutions) {
+
+			if (!CreateScene(scene, resolution)) {
+
+				std::cout << "Unknown scene: " << scene << '\n';
+				PrintUsage();
+				return 1;
+			}
+
+			for (uint32_t nrOfThreads : options.ThreadCounts) {
+
+				results.push_back(RunBenchmark(options, scene, resolution, nrOfThreads));
+				std::cout << scene << ' ' << resolution.Width << 'x' << resolution.Height << ' ' << nrOfThreads << " threads: "
+					<< Percentile(results.back().FrameMilliseconds, 50.0) << " ms (p50)\n";
+
+				//Every thread count starts from the same frame
+				CreateScene(scene, resolution);
+			}
+		}
+	}
+
+	const std::vector<ParseResult> parseResults = RunParseBenchmark(options);
+	for (const ParseResult& result : parseResults)
+		std::cout << result.Path << ": " << GetMegabytesPerSecond(result, Percentile(result.Milliseconds, 50.0)) << " MB/s (p50), ACMR "
+			<< result.Parsed.ACMR << " -> " << result.Optimized.ACMR << ", overdraw " << result.Parsed.Overdraw << " -> " << result.Optimized.Overdraw << '\n';
+
+	std::ofstream file{ options.OutputPath };
+	if (!file) {
+
+		std::cout << "Could not write " << options.OutputPath << '\n';
+		return 1;
+	}
+	WriteJson(file, options, results, parseResults);
+	std::cout << "Results written to " << options.OutputPath << '\n';
+
+	ReleaseSingletons();
+	return 0;
+}
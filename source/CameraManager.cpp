@@ -38,6 +38,15 @@ void CameraManager::CycleTroughCameras()
 	}
 }
 
+void CameraManager::ClearCameras()
+{
+	for (Camera* cam : m_Cameras)
+		delete cam;
+	m_Cameras.clear();
+	m_ActiveCamera = nullptr;
+	m_ActiveCameraId = 0;
+}
+
 //Force every camera to recalculate its coordinate system
 void CameraManager::RecalculateCameras()
 {
@@ -22,6 +22,7 @@ public:
 	Camera* GetActiveCamera();
 	void CycleTroughCameras();
 	void RecalculateCameras();
+	void ClearCameras();
 private:
 	CameraManager();
 
@@ -0,0 +1,299 @@
+#include "pch.h"
+#include "CookedMesh.h"
+#include "MappedFile.h"
+#include "MeshData.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "ObjParser.h"
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+	const char g_Magic[4]{ 'C', 'M', 'S', 'H' };
+	const uint32_t g_Version{ 4 }; //2: optimized triangle and vertex order, 3: quantized vertices, 4: levels of detail
+	const uint64_t g_BlobAlignment{ 64 };
+
+	struct CookedHeader
+	{
+		char Magic[4];
+		uint32_t Version;
+		uint32_t VertexSize; //sizeof(InputVertex) when cooked
+		uint32_t MeshletSize;
+		uint32_t NrOfVertices;
+		uint32_t NrOfIndices;
+		uint32_t NrOfMeshlets;
+		uint32_t QuantizedVertexSize;
+		uint32_t LodSize;
+		uint32_t NrOfLods;
+		uint32_t NrOfLodIndices;
+		uint32_t Padding;
+		uint64_t SourceSize;
+		int64_t SourceWriteTime;
+		uint64_t SourceHash;
+		uint64_t VertexOffset;
+		uint64_t QuantizedVertexOffset;
+		uint64_t IndexOffset;
+		uint64_t MeshletOffset;
+		uint64_t LodOffset;
+		uint64_t LodIndexOffset;
+		float BoundsMin[3];
+		float BoundsMax[3];
+	};
+
+	struct SourceInformation
+	{
+		bool Exists;
+		uint64_t Size;
+		int64_t WriteTime;
+	};
+
+	SourceInformation GetSourceInformation(const std::string& path)
+	{
+		std::error_code error;
+		const uint64_t size = std::filesystem::file_size(path, error);
+		if (error)
+			return SourceInformation{ false, 0, 0 };
+		const auto writeTime = std::filesystem::last_write_time(path, error);
+		return SourceInformation{ !error, size, error ? 0 : int64_t(writeTime.time_since_epoch().count()) };
+	}
+
+	//FNV-1a over the whole file, 0 when it can't be read
+	uint64_t HashFile(const std::string& path)
+	{
+		MappedFile file{ path };
+		if (!file.IsOpen())
+			return 0;
+
+		uint64_t hash = 14695981039346656037ull;
+		for (size_t i = 0; i < file.GetSize(); ++i)
+			hash = (hash ^ uint8_t(file.GetData()[i])) * 1099511628211ull;
+		return hash;
+	}
+
+	uint64_t AlignBlob(uint64_t offset)
+	{
+		return (offset + g_BlobAlignment - 1) / g_BlobAlignment * g_BlobAlignment;
+	}
+
+	//Runs of Meshlet::MaxTriangles triangles in index order, the parser writes neighbouring faces next to each other
+	std::vector<Meshlet> BuildMeshlets(const MeshData& meshData)
+	{
+		const InputVertex* vertices = meshData.GetVertices();
+		const uint32_t* indices = meshData.GetIndices();
+		const uint32_t nrOfIndices = meshData.GetNrOfIndices();
+		std::vector<Meshlet> meshlets;
+		const uint32_t indicesPerMeshlet = Meshlet::MaxTriangles * 3;
+		meshlets.reserve((nrOfIndices + indicesPerMeshlet - 1) / indicesPerMeshlet);
+		for (uint32_t first = 0; first + 2 < nrOfIndices; first += indicesPerMeshlet) {
+
+			Meshlet meshlet{ first, std::min(indicesPerMeshlet, nrOfIndices - first) / 3 * 3, vertices[indices[first]].Position, vertices[indices[first]].Position };
+			for (uint32_t i = first; i < first + meshlet.NrOfIndices; ++i) {
+
+				const Elite::FPoint3& position = vertices[indices[i]].Position;
+				meshlet.BoundsMin = Elite::FPoint3{ std::min(meshlet.BoundsMin.x, position.x), std::min(meshlet.BoundsMin.y, position.y), std::min(meshlet.BoundsMin.z, position.z) };
+				meshlet.BoundsMax = Elite::FPoint3{ std::max(meshlet.BoundsMax.x, position.x), std::max(meshlet.BoundsMax.y, position.y), std::max(meshlet.BoundsMax.z, position.z) };
+			}
+			meshlets.push_back(meshlet);
+		}
+		return meshlets;
+	}
+
+	//The meshlets are made after the optimizer, as runs of triangles in its order (see BuildMeshlets), they are not clustered on their own.
+	//The levels of detail come last, they renumber the vertices but keep the triangle order of the full mesh
+	std::shared_ptr<const MeshData> ParseObjFile(const std::string& objPath, bool buildMeshlets, CookedMesh::CookStatistics* pStatistics)
+	{
+		const MeshData parsed = ObjParser::ReadObjFile(objPath);
+		std::shared_ptr<MeshData> pMeshData = std::make_shared<MeshData>(MeshSimplifier::BuildLods(MeshOptimizer::Optimize(parsed)));
+		if (pStatistics) {
+
+			*pStatistics = CookedMesh::CookStatistics{ MeshOptimizer::Analyze(parsed), MeshOptimizer::Analyze(*pMeshData), { pMeshData->GetNrOfIndices() / 3 } };
+			for (uint32_t lod = 0; lod < pMeshData->GetNrOfLods(); ++lod)
+				pStatistics->LodTriangles.push_back(pMeshData->GetLods()[lod].NrOfIndices / 3);
+		}
+		if (buildMeshlets)
+			pMeshData->SetMeshlets(BuildMeshlets(*pMeshData));
+		pMeshData->Quantize();
+		return pMeshData;
+	}
+
+	//Written to a temporary file of the thread first, a cooked file is either complete or not there
+	bool WriteCookedFile(const std::string& cookedPath, const MeshData& meshData, const SourceInformation& source, uint64_t sourceHash)
+	{
+		CookedHeader header{};
+		std::memcpy(header.Magic, g_Magic, sizeof(g_Magic));
+		header.Version = g_Version;
+		header.VertexSize = sizeof(InputVertex);
+		header.MeshletSize = sizeof(Meshlet);
+		header.QuantizedVertexSize = sizeof(QuantizedVertex);
+		header.LodSize = sizeof(MeshLod);
+		header.NrOfVertices = meshData.GetNrOfVertices();
+		header.NrOfIndices = meshData.GetNrOfIndices();
+		header.NrOfMeshlets = meshData.GetNrOfMeshlets();
+		header.NrOfLods = meshData.GetNrOfLods();
+		header.NrOfLodIndices = meshData.GetNrOfLodIndices();
+		header.SourceSize = source.Size;
+		header.SourceWriteTime = source.WriteTime;
+		header.SourceHash = sourceHash;
+		header.VertexOffset = AlignBlob(sizeof(CookedHeader));
+		header.QuantizedVertexOffset = AlignBlob(header.VertexOffset + uint64_t(header.NrOfVertices) * sizeof(InputVertex));
+		header.IndexOffset = AlignBlob(header.QuantizedVertexOffset + uint64_t(header.NrOfVertices) * sizeof(QuantizedVertex));
+		header.MeshletOffset = AlignBlob(header.IndexOffset + uint64_t(header.NrOfIndices) * sizeof(uint32_t));
+		header.LodOffset = AlignBlob(header.MeshletOffset + uint64_t(header.NrOfMeshlets) * sizeof(Meshlet));
+		header.LodIndexOffset = AlignBlob(header.LodOffset + uint64_t(header.NrOfLods) * sizeof(MeshLod));
+		for (int i = 0; i < 3; ++i) {
+
+			header.BoundsMin[i] = meshData.GetBoundsMin().data[i];
+			header.BoundsMax[i] = meshData.GetBoundsMax().data[i];
+		}
+
+		std::stringstream temporaryPath;
+		temporaryPath << cookedPath << '.' << std::this_thread::get_id() << ".tmp";
+		{
+			std::ofstream file{ temporaryPath.str(), std::ios::binary | std::ios::trunc };
+			if (!file)
+				return false;
+
+			const char padding[g_BlobAlignment]{};
+			auto writeBlob = [&file, &padding](uint64_t offset, const void* pData, uint64_t size) {
+				file.write(padding, std::streamsize(offset - uint64_t(file.tellp())));
+				file.write(static_cast<const char*>(pData), std::streamsize(size));
+			};
+			file.write(reinterpret_cast<const char*>(&header), sizeof(CookedHeader));
+			writeBlob(header.VertexOffset, meshData.GetVertices(), uint64_t(header.NrOfVertices) * sizeof(InputVertex));
+			writeBlob(header.QuantizedVertexOffset, meshData.GetQuantizedVertices(), uint64_t(header.NrOfVertices) * sizeof(QuantizedVertex));
+			writeBlob(header.IndexOffset, meshData.GetIndices(), uint64_t(header.NrOfIndices) * sizeof(uint32_t));
+			writeBlob(header.MeshletOffset, meshData.GetMeshlets(), uint64_t(header.NrOfMeshlets) * sizeof(Meshlet));
+			writeBlob(header.LodOffset, meshData.GetLods(), uint64_t(header.NrOfLods) * sizeof(MeshLod));
+			writeBlob(header.LodIndexOffset, meshData.GetLodIndices(), uint64_t(header.NrOfLodIndices) * sizeof(uint32_t));
+			if (!file)
+				return false;
+		}
+
+		std::error_code error;
+		std::filesystem::rename(temporaryPath.str(), cookedPath, error);
+		if (error)
+			std::filesystem::remove(temporaryPath.str(), error);
+		return !error;
+	}
+
+	//Stores the write time of the .obj in the header of a cooked file, it must not be mapped
+	bool WriteSourceWriteTime(const std::string& cookedPath, int64_t writeTime)
+	{
+		std::fstream file{ cookedPath, std::ios::binary | std::ios::in | std::ios::out };
+		if (!file)
+			return false;
+
+		file.seekp(offsetof(CookedHeader, SourceWriteTime));
+		file.write(reinterpret_cast<const char*>(&writeTime), sizeof(writeTime));
+		return bool(file);
+	}
+
+	//Everything the renderer indexes with, checked once here instead of on every use:
+	//the indices stay within the vertices and every level stays within the level indices and the vertices it claims
+	bool HasValidContents(const CookedHeader& header, const uint32_t* pIndices, const Meshlet* pMeshlets, const MeshLod* pLods, const uint32_t* pLodIndices)
+	{
+		for (uint32_t i = 0; i < header.NrOfIndices; ++i)
+			if (pIndices[i] >= header.NrOfVertices)
+				return false;
+
+		for (uint32_t meshlet = 0; meshlet < header.NrOfMeshlets; ++meshlet)
+			if (uint64_t(pMeshlets[meshlet].FirstIndex) + pMeshlets[meshlet].NrOfIndices > header.NrOfIndices)
+				return false;
+
+		for (uint32_t lod = 0; lod < header.NrOfLods; ++lod) {
+
+			const MeshLod& level = pLods[lod];
+			if (uint64_t(level.FirstIndex) + level.NrOfIndices > header.NrOfLodIndices || level.NrOfVertices > header.NrOfVertices)
+				return false;
+			for (uint32_t i = level.FirstIndex; i < level.FirstIndex + level.NrOfIndices; ++i)
+				if (pLodIndices[i] >= level.NrOfVertices)
+					return false;
+		}
+		return true;
+	}
+
+	//nullptr when the cooked file is missing, broken or stale
+	std::shared_ptr<const MeshData> MapCookedFile(const std::string& cookedPath, const std::string& objPath, const SourceInformation& source)
+	{
+		auto pFile = std::make_shared<MappedFile>(cookedPath);
+		if (!pFile->IsOpen() || pFile->GetSize() < sizeof(CookedHeader))
+			return nullptr;
+
+		CookedHeader header;
+		std::memcpy(&header, pFile->GetData(), sizeof(CookedHeader));
+		if (std::memcmp(header.Magic, g_Magic, sizeof(g_Magic)) != 0 || header.Version != g_Version
+			|| header.VertexSize != sizeof(InputVertex) || header.QuantizedVertexSize != sizeof(QuantizedVertex) || header.MeshletSize != sizeof(Meshlet) || header.LodSize != sizeof(MeshLod))
+			return nullptr;
+
+		const uint64_t fileSize = pFile->GetSize();
+		if (header.VertexOffset % g_BlobAlignment != 0 || header.QuantizedVertexOffset % g_BlobAlignment != 0
+			|| header.IndexOffset % g_BlobAlignment != 0 || header.MeshletOffset % g_BlobAlignment != 0
+			|| header.LodOffset % g_BlobAlignment != 0 || header.LodIndexOffset % g_BlobAlignment != 0
+			|| header.VertexOffset + uint64_t(header.NrOfVertices) * sizeof(InputVertex) > fileSize
+			|| header.QuantizedVertexOffset + uint64_t(header.NrOfVertices) * sizeof(QuantizedVertex) > fileSize
+			|| header.IndexOffset + uint64_t(header.NrOfIndices) * sizeof(uint32_t) > fileSize
+			|| header.MeshletOffset + uint64_t(header.NrOfMeshlets) * sizeof(Meshlet) > fileSize
+			|| header.LodOffset + uint64_t(header.NrOfLods) * sizeof(MeshLod) > fileSize
+			|| header.LodIndexOffset + uint64_t(header.NrOfLodIndices) * sizeof(uint32_t) > fileSize)
+			return nullptr;
+
+		//Without its .obj the cooked file is all there is
+		if (source.Exists && (header.SourceSize != source.Size || (header.SourceWriteTime != source.WriteTime && header.SourceHash != HashFile(objPath))))
+			return nullptr;
+
+		//Same contents with another write time (a checkout or a copy), the new time gets stored so the next load doesn't hash the .obj again.
+		//The file can't be written while it is mapped. When writing fails it gets mapped as is, its contents were just compared
+		if (source.Exists && header.SourceWriteTime != source.WriteTime) {
+
+			pFile.reset();
+			const bool updated = WriteSourceWriteTime(cookedPath, source.WriteTime);
+			return MapCookedFile(cookedPath, objPath, updated ? source : SourceInformation{ false, 0, 0 });
+		}
+
+		const char* pData = pFile->GetData();
+		const InputVertex* pVertices = reinterpret_cast<const InputVertex*>(pData + header.VertexOffset);
+		const QuantizedVertex* pQuantizedVertices = reinterpret_cast<const QuantizedVertex*>(pData + header.QuantizedVertexOffset);
+		const uint32_t* pIndices = reinterpret_cast<const uint32_t*>(pData + header.IndexOffset);
+		const Meshlet* pMeshlets = reinterpret_cast<const Meshlet*>(pData + header.MeshletOffset);
+		const MeshLod* pLods = reinterpret_cast<const MeshLod*>(pData + header.LodOffset);
+		const uint32_t* pLodIndices = reinterpret_cast<const uint32_t*>(pData + header.LodIndexOffset);
+		if (!HasValidContents(header, pIndices, pMeshlets, pLods, pLodIndices))
+			return nullptr;
+
+		return std::make_shared<MeshData>(std::move(pFile), pVertices, pQuantizedVertices, header.NrOfVertices, pIndices, header.NrOfIndices, pMeshlets, header.NrOfMeshlets,
+			pLods, header.NrOfLods, pLodIndices, header.NrOfLodIndices,
+			Elite::FPoint3{ header.BoundsMin[0], header.BoundsMin[1], header.BoundsMin[2] }, Elite::FPoint3{ header.BoundsMax[0], header.BoundsMax[1], header.BoundsMax[2] });
+	}
+}
+
+std::string CookedMesh::GetCookedPath(const std::string& objPath)
+{
+	return objPath + ".cmesh";
+}
+
+std::shared_ptr<const MeshData> CookedMesh::Load(const std::string& objPath)
+{
+	const std::string cookedPath = GetCookedPath(objPath);
+	const SourceInformation source = GetSourceInformation(objPath);
+	std::shared_ptr<const MeshData> pMeshData = MapCookedFile(cookedPath, objPath, source);
+	if (pMeshData)
+		return pMeshData;
+
+	//Stale or missing, the parsed data is used right away and the next run maps the new file
+	pMeshData = ParseObjFile(objPath, true, nullptr);
+	if (!WriteCookedFile(cookedPath, *pMeshData, source, HashFile(objPath)))
+		std::cout << "Could not write cooked mesh " << cookedPath << '\n';
+	return pMeshData;
+}
+
+bool CookedMesh::Cook(const std::string& objPath, bool buildMeshlets, CookStatistics* pStatistics)
+{
+	const SourceInformation source = GetSourceInformation(objPath);
+	std::shared_ptr<const MeshData> pMeshData = ParseObjFile(objPath, buildMeshlets, pStatistics);
+	return WriteCookedFile(GetCookedPath(objPath), *pMeshData, source, HashFile(objPath));
+}
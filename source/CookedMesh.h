@@ -0,0 +1,32 @@
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "MeshOptimizer.h"
+
+class MeshData;
+
+//Binary mesh files made from .obj files, so loading a mesh is mapping a file instead of parsing one.
+//"vehicle.obj" gets cooked to "vehicle.obj.cmesh" next to it, either up front (Cook) or the first time it's loaded (Load).
+//A cooked file is header, vertices, quantized vertices, indices, meshlets, levels of detail and their indices, every blob 64 byte aligned,
+//the vertices are InputVertex as is. Cooking reorders the triangles and vertices with the MeshOptimizer and adds the levels of the MeshSimplifier.
+//It goes stale when the version, the layout of InputVertex or the .obj changes; a changed timestamp with the same
+//contents (a fresh checkout) is caught by the hash of the .obj and keeps the cooked file.
+namespace CookedMesh
+{
+	struct CookStatistics {
+		MeshOptimizer::Statistics Parsed;
+		MeshOptimizer::Statistics Cooked;
+		std::vector<uint32_t> LodTriangles; //Triangles of every level of detail, the full mesh first
+	};
+
+	std::string GetCookedPath(const std::string& objPath);
+
+	//Maps the cooked file when it's up to date, the MeshData points into the mapping.
+	//Otherwise the .obj gets parsed and cooked, that MeshData owns its data.
+	std::shared_ptr<const MeshData> Load(const std::string& objPath);
+
+	//Parses the .obj and (re)writes its cooked file, throws the errors of the parser, returns false when the file couldn't be written.
+	//pStatistics gets the cache and overdraw statistics of the mesh before and after the optimizer, measuring them takes a while
+	bool Cook(const std::string& objPath, bool buildMeshlets = true, CookStatistics* pStatistics = nullptr);
+}
@@ -1,5 +1,7 @@
 #include "pch.h"
 #include "SDL_surface.h"
+#include <SDL_image.h>
+#include <fstream>
 
 //Project includes
 #include "ERenderer.h"
@@ -7,6 +9,8 @@
 #include "CameraManager.h"
 #include "EffectManager.h"
 #include "Rasterizer.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
 
 Elite::Renderer::Renderer(SDL_Window * pWindow)
 	: m_pWindow{ pWindow }
@@ -19,9 +23,7 @@ Elite::Renderer::Renderer(SDL_Window * pWindow)
 	SDL_GetWindowSize(pWindow, &width, &height);
 	m_Width = static_cast<uint32_t>(width);
 	m_Height = static_cast<uint32_t>(height);
-	m_pBackBuffer = SDL_CreateRGBSurface(0, m_Width, m_Height, 32, 0, 0, 0, 0);
-	m_pBackBufferPixels = (uint32_t*)m_pBackBuffer->pixels;
-	m_DepthBuffer = std::vector<float>(width * height);
+	InitializeRasterizer();
 
 	//Initialize DirectX pipeline
 	if (InitializeDirectX() == 0) {
@@ -31,8 +33,62 @@ Elite::Renderer::Renderer(SDL_Window * pWindow)
 	} else 
 		std::cout << "DirectX failed\n";
 
+	PrintInformation();
+}
+
+//Headless, renders into the in memory back and depth buffer without a window or a DirectX device
+Elite::Renderer::Renderer(uint32_t width, uint32_t height)
+	: m_pWindow{ nullptr }
+	, m_Width{ width }
+	, m_Height{ height }
+	, m_IsInitialized{ false }
+{
+	InitializeRasterizer();
+
+	std::cout << "Headless " << m_Width << "x" << m_Height << ", only the software rasterizer is available\n";
+	PrintInformation();
+}
+
+void Elite::Renderer::InitializeRasterizer()
+{
+	m_pBackBuffer = SDL_CreateRGBSurface(0, m_Width, m_Height, 32, 0, 0, 0, 0);
+	if (!m_pBackBuffer)
+		throw std::runtime_error("Back buffer could not be made.\n");
+
+	m_pBackBufferPixels = (uint32_t*)m_pBackBuffer->pixels;
+	m_DepthBuffer = std::vector<float>(m_Width * m_Height);
+	m_VisibilityBuffer = std::vector<uint32_t>(m_Width * m_Height);
+	m_OverdrawBuffer = std::vector<uint32_t>(m_Width * m_Height);
+
+	//Split the screen in tiles, the last row and column can be smaller than m_TileSize
+	m_NrOfTilesX = (m_Width + m_TileSize - 1) / m_TileSize;
+	m_NrOfTilesY = (m_Height + m_TileSize - 1) / m_TileSize;
+	m_TileBins.resize(m_NrOfTilesX * m_NrOfTilesY);
+	m_TileStatistics.resize(m_NrOfTilesX * m_NrOfTilesY);
+
+	//Hi-Z levels, one value per 8x8 block and one per tile
+	m_NrOfBlocksX = (m_Width + m_BlockSize - 1) / m_BlockSize;
+	m_HiZBlocks.resize(m_NrOfBlocksX * ((m_Height + m_BlockSize - 1) / m_BlockSize));
+	m_HiZBlockWrites.resize(m_HiZBlocks.size());
+	m_HiZBlockCoverage.resize(m_HiZBlocks.size());
+	m_HiZTiles.resize(m_NrOfTilesX * m_NrOfTilesY);
+
+	//Makes the profiler before the workers can use it
+	Profiler::GetInstance()->SetThreadName("Render thread");
+	SetNrOfThreads(std::max(std::thread::hardware_concurrency(), 1u));
+}
+
+void Elite::Renderer::PrintInformation()
+{
 	PrintEffectRenderingInformation();
 	PrintDepthRenderingInformation();
+	PrintMultiThreadingInformation();
+	PrintRasterizationModeInformation();
+	PrintVisibilityBufferRenderingInformation();
+	PrintOverdrawRenderingInformation();
+	PrintHiZInformation();
+	PrintQuantizedVerticesInformation();
+	PrintLodSelectionInformation();
 }
 
 Elite::Renderer::~Renderer()
@@ -60,6 +116,8 @@ Elite::Renderer::~Renderer()
 	}
 	if (m_pDevice)
 		m_pDevice->Release();
+
+	SDL_FreeSurface(m_pBackBuffer);
 }
 
 void Elite::Renderer::Render()
@@ -67,12 +125,14 @@ void Elite::Renderer::Render()
 	RGBColor clearColor = RGBColor(0.f, 0.f, 0.3f);
 	const std::vector<Mesh*>& meshes = SceneGraph::GetInstance()->GetObjects();
 	const Camera* activeCamera = CameraManager::GetInstance()->GetActiveCamera();
+	Profiler::GetInstance()->BeginFrame();
+	SelectLods(meshes, activeCamera);
 
 	switch (SceneGraph::GetInstance()->GetRenderMode()) {
 	case RenderMode::DirectX:
 		{
 			if (!m_IsInitialized)
-				return;
+				break;
 
 			//Clear Buffers
 			m_pDeviceContext->ClearRenderTargetView(m_pRenderTargetView, &clearColor.r);
@@ -118,6 +178,7 @@ void Elite::Renderer::Render()
 			}
 
 			//Present
+			PROFILE_ZONE("Present");
 			m_pSwapChain->Present(0, 0);
 		}
 		break;
@@ -125,154 +186,60 @@ void Elite::Renderer::Render()
 		{
 			SDL_LockSurface(m_pBackBuffer);
 
-			//Initialize variables
-			std::vector<OutputVertex> vertices;
-			std::for_each(m_DepthBuffer.begin(), m_DepthBuffer.end(), [](float& value) {
-				value = FLT_MAX;
-				});
+			const uint32_t clearPixel = SDL_MapRGB(m_pBackBuffer->format,
+				static_cast<uint8_t>(clearColor.r * 255),
+				static_cast<uint8_t>(clearColor.g * 255),
+				static_cast<uint8_t>(clearColor.b * 255));
 
-			const float farPlane = activeCamera->GetFarPlane();
-			const float nearPlane = activeCamera->GetNearPlane();
-			const float FOV = activeCamera->GetFOV();
-			const Elite::FPoint3& cameraLocation = activeCamera->GetLocation();
-			const Elite::FMatrix4& lookAtMatrix = activeCamera->GetViewMatrix();
+			//Transform all vertices and sort the triangles into the screen tiles they touch
+			m_FrameStatistics = FrameStatistics{};
+			TransformVertices(meshes, activeCamera);
+			BinTriangles();
 
+			//Every tile owns its pixels, so tiles can be cleared, depth tested and shaded without locking
+			const uint32_t nrOfTiles = m_NrOfTilesX * m_NrOfTilesY;
+			if (m_MultiThreading) {
 
-			//Set pixel to black
-			for (uint32_t r = 0; r < m_Height; ++r) {
-				for (uint32_t c = 0; c < m_Width; ++c) {
-
-					m_pBackBufferPixels[c + (r * m_Width)] = SDL_MapRGB(m_pBackBuffer->format,
-						static_cast<uint8_t>(clearColor.r * 255),
-						static_cast<uint8_t>(clearColor.g * 255),
-						static_cast<uint8_t>(clearColor.b * 255));
-				}
+				m_pThreadPool->ParallelFor(nrOfTiles, [this, clearPixel](uint32_t tileIndex, uint32_t) {
+					RenderTile(tileIndex, clearPixel);
+					});
 			}
+			else {
 
-			//Loop over all Objects
-			for (Mesh* currentMesh : meshes) {
-			
-				if (!m_RenderEffects && currentMesh->GetEffect()->GetEffectType() != BaseEffect::EffectType::Material)
-					continue;
-
-				Rasterizer::VertexTransformationFunction(currentMesh->GetVertices(), vertices, cameraLocation, lookAtMatrix, currentMesh->GetWorldMatrix(), activeCamera->GetProjectionMatrix(), (float)m_Width, (float)m_Height, nearPlane, farPlane, FOV);
-
-				//loop over all indices
-				Mesh::PrimitiveToplogy topology = currentMesh->GetPrimitveTopology();
-				for (int i = 0; i < currentMesh->GetNrOfTriangles(); i += (int)topology) {
-
-					//Check which topology we use and implement it
-					int index0{}, index1{}, index2{};
-					currentMesh->GetTriangleIndices(i, index0, index1, index2);
-
-					//If end of strip (surface triangle), continue
-					if (index0 == index1 || index1 == index2 || index0 == index2)
-						continue;
+				for (uint32_t tileIndex = 0; tileIndex < nrOfTiles; ++tileIndex)
+					RenderTile(tileIndex, clearPixel);
+			}
 
-					const Elite::FPoint4& v0 = vertices[index0].Position;
-					const Elite::FPoint4& v1 = vertices[index1].Position;
-					const Elite::FPoint4& v2 = vertices[index2].Position;
+			//Merge the counters of all tiles
+			for (const FrameStatistics& tileStatistics : m_TileStatistics)
+				m_FrameStatistics += tileStatistics;
 
-					//Frustrum culling
-					if (v0.z < 0 || v0.z > 1)
-						continue;
+			SDL_UnlockSurface(m_pBackBuffer);
 
-					if (v1.z < 0 || v1.z > 1)
-						continue;
+			//Headless renderers keep the frame in the back buffer
+			if (m_pWindow) {
 
-					if (v2.z < 0 || v2.z > 1)
-						continue;
-					
-					//Calculate total weight and create the bounding box for the current triangle
-					float totalWeight = Elite::Cross(v0.xy - v1.xy, v0.xy - v2.xy);
-					std::pair<Elite::FPoint2, Elite::FPoint2> boundingBox = Rasterizer::CreateBoundingBox(v0, v1, v2, m_Width, m_Height);
-
-					//Loop over all the pixels
-					for (uint32_t r = uint32_t(boundingBox.first.y); r < boundingBox.second.y; ++r)
-					{
-						for (uint32_t c = uint32_t(boundingBox.first.x); c < boundingBox.second.x; ++c)
-						{
-
-							//Create current pixel
-							float weight0, weight1, weight2;
-							if (!PixelInTri((float)c, (float)r, v0, v1, v2, weight0, weight1, weight2, currentMesh->GetCullMode()))
-								continue;
-
-							//Transform weights into ratio's
-							weight0 /= totalWeight;
-							weight1 /= totalWeight;
-							weight2 /= totalWeight;
-
-							//Check if the weights add up to 1
-							if (std::round(weight0 + weight1 + weight2) != 1)
-								continue;
-
-							//Calculate the depth for a depth-check
-							float depth{};
-						
-							CalculateDepthBuffer(depth, weight0, weight1, weight2, index0, index1, index2, vertices);
-							if (depth > 0.f && depth < 1.f && depth < m_DepthBuffer[c + (r * m_Width)]) {
-
-								//Set depth to found depth and recalculate it for calculations
-								m_DepthBuffer[c + (r * m_Width)] = depth;
-								CalculateDepthInterpolated(depth, weight0, weight1, weight2, index0, index1, index2, vertices);
-
-								Elite::RGBColor finalColor{};
-								if (!m_DepthRendering) {
-
-									//Uv calculation
-									Elite::FVector2 finalUV{};
-									CalculateUV(finalUV, depth, weight0, weight1, weight2, index0, index1, index2, vertices);
-
-									//Color calculation (either with uv or colors)
-									finalColor = currentMesh->SampleTexture(finalUV);
-
-									//Normal Calculation
-									Elite::FVector3 finalNormal{};
-									CalculateNormal(finalNormal, depth, weight0, weight1, weight2, index0, index1, index2, vertices);
-
-									//Tangent Calculation
-									Elite::FVector3 finalTangent{};
-									CalculateTangent(finalTangent, depth, weight0, weight1, weight2, index0, index1, index2, vertices);
-
-									//ViewDirection Calculation
-									Elite::FVector3 finalViewDirection{};
-									CalculateViewDirection(finalViewDirection, depth, weight0, weight1, weight2, index0, index1, index2, vertices);
-
-									//Lighting Calculation
-									if (currentMesh->GetNormalMap().IsValid() && currentMesh->GetSpecularMap().IsValid() && currentMesh->GetGlossinessMap().IsValid())
-										finalColor = Rasterizer::PixelShading(OutputVertex{ {}, finalUV, finalNormal, finalTangent, finalColor, finalViewDirection }, currentMesh->SampleNormalMap(finalUV), currentMesh->SampleSpecularMap(finalUV), currentMesh->SampleGlossinessMap(finalUV), currentMesh->GetShininess(), currentMesh->GetLightIntensity());
-								}
-								else {
-									float depthColor = Elite::Remap(m_DepthBuffer[c + (r * m_Width)], 0.985f, 1.f);
-									finalColor = { depthColor, depthColor, depthColor };
-								}
-								finalColor.MaxToOne();
-								finalColor.Clamp();
-
-								//Color the pixels
-								m_pBackBufferPixels[c + (r * m_Width)] = SDL_MapRGB(m_pBackBuffer->format,
-									static_cast<uint8_t>(finalColor.r * 255.f),
-									static_cast<uint8_t>(finalColor.g * 255.f),
-									static_cast<uint8_t>(finalColor.b * 255.f));
-							}
-						}
-					}
-				}
+				PROFILE_ZONE("Blit");
+				SDL_BlitSurface(m_pBackBuffer, 0, m_pFrontBuffer, 0);
+				SDL_UpdateWindowSurface(m_pWindow);
 			}
-			SDL_UnlockSurface(m_pBackBuffer);
-			SDL_BlitSurface(m_pBackBuffer, 0, m_pFrontBuffer, 0);
-			SDL_UpdateWindowSurface(m_pWindow);
 		}
 		break;
 	default:
 		break;
 	}
+
+	Profiler::GetInstance()->EndFrame();
+}
+
+void Elite::Renderer::SetDepthRendering(bool depthRendering)
+{
+	m_DepthRendering = depthRendering;
 }
 
 void Elite::Renderer::ToggleDepthRendering()
 {
-	m_DepthRendering = !m_DepthRendering;
+	SetDepthRendering(!m_DepthRendering);
 	PrintDepthRenderingInformation();
 }
 
@@ -290,6 +257,249 @@ ID3D11Device* Elite::Renderer::GetDevice()
 	return m_pDevice;
 }
 
+bool Elite::Renderer::IsHeadless() const
+{
+	return m_pWindow == nullptr;
+}
+
+uint32_t Elite::Renderer::GetWidth() const
+{
+	return m_Width;
+}
+
+uint32_t Elite::Renderer::GetHeight() const
+{
+	return m_Height;
+}
+
+//Converts the last rasterized frame to tightly packed RGBA, 4 bytes per pixel, top row first
+void Elite::Renderer::ReadColorBuffer(std::vector<uint8_t>& rgba) const
+{
+	rgba.resize(m_Width * m_Height * 4);
+	for (uint32_t i = 0; i < m_Width * m_Height; ++i)
+		SDL_GetRGBA(m_pBackBufferPixels[i], m_pBackBuffer->format, &rgba[i * 4], &rgba[i * 4 + 1], &rgba[i * 4 + 2], &rgba[i * 4 + 3]);
+}
+
+const std::vector<float>& Elite::Renderer::GetDepthBuffer() const
+{
+	return m_DepthBuffer;
+}
+
+//Writes the last rasterized frame to disk, .png files go trough SDL_image and everything else becomes a binary PPM
+bool Elite::Renderer::SaveFrame(const std::string& path) const
+{
+	const std::string pngExtension = ".png";
+	if (path.size() >= pngExtension.size() && path.compare(path.size() - pngExtension.size(), pngExtension.size(), pngExtension) == 0) {
+
+		if (IMG_SavePNG(m_pBackBuffer, path.c_str()) != 0) {
+
+			std::cout << "Could not save " << path << ": " << IMG_GetError() << '\n';
+			return false;
+		}
+		return true;
+	}
+
+	std::ofstream file{ path, std::ios::binary };
+	if (!file) {
+
+		std::cout << "Could not save " << path << '\n';
+		return false;
+	}
+
+	std::vector<uint8_t> rgba;
+	ReadColorBuffer(rgba);
+
+	std::vector<uint8_t> rgb(m_Width * m_Height * 3);
+	for (uint32_t i = 0; i < m_Width * m_Height; ++i) {
+
+		rgb[i * 3] = rgba[i * 4];
+		rgb[i * 3 + 1] = rgba[i * 4 + 1];
+		rgb[i * 3 + 2] = rgba[i * 4 + 2];
+	}
+
+	file << "P6\n" << m_Width << ' ' << m_Height << "\n255\n";
+	file.write((const char*)rgb.data(), rgb.size());
+	return bool(file);
+}
+
+void Elite::Renderer::ToggleMultiThreading()
+{
+	m_MultiThreading = !m_MultiThreading;
+	PrintMultiThreadingInformation();
+}
+
+void Elite::Renderer::PrintMultiThreadingInformation()
+{
+	std::cout << "Multithreading: ";
+	if (m_MultiThreading)
+		std::cout << "true (" << m_pThreadPool->GetNrOfThreads() << " threads)\n";
+	else
+		std::cout << "false\n";
+}
+
+//The thread calling Render() works along, so the pool gets one worker less
+void Elite::Renderer::SetNrOfThreads(uint32_t nrOfThreads)
+{
+	nrOfThreads = std::max(nrOfThreads, 1u);
+	m_pThreadPool = std::make_unique<ThreadPool>(nrOfThreads - 1);
+	m_MultiThreading = nrOfThreads > 1;
+}
+
+//The reference mode also samples textures without SSE
+void Elite::Renderer::SetRasterizationMode(RasterizationMode mode)
+{
+	m_RasterizationMode = mode;
+	Texture::SetSIMDGather(m_RasterizationMode != RasterizationMode::Reference);
+}
+
+void Elite::Renderer::ToggleRasterizationMode()
+{
+	SetRasterizationMode(RasterizationMode((int(m_RasterizationMode) + 1) % 3));
+	PrintRasterizationModeInformation();
+}
+
+void Elite::Renderer::PrintRasterizationModeInformation()
+{
+	std::cout << "Rasterization Mode: ";
+	switch (m_RasterizationMode)
+	{
+	case RasterizationMode::Reference:
+		std::cout << "Reference (scalar PixelInTri and texture sampling)\n";
+		break;
+	case RasterizationMode::SIMD:
+		std::cout << "SIMD (SSE edge functions, 8x8 and 4x4 blocks)\n";
+		break;
+	case RasterizationMode::FixedPoint:
+		std::cout << "FixedPoint (28.4 integer edge functions, pixel centers, top-left rule)\n";
+		break;
+	default:
+		break;
+	}
+}
+
+const FrameStatistics& Elite::Renderer::GetFrameStatistics() const
+{
+	return m_FrameStatistics;
+}
+
+void Elite::Renderer::PrintFrameStatistics() const
+{
+	const MeshStatistics total = m_FrameStatistics.GetTotal();
+	std::cout << "Frame: " << total.VerticesTransformed << " vertices (" << total.VertexBytesRead << " bytes read), " << total.TrianglesSubmitted << " triangles (" << total.TrianglesSaved << " saved by LOD), " << total.PixelsEdgeTested << " pixels edge tested, "
+		<< total.PixelsDepthPassed << " depth passed, " << total.PixelsShaded << " shaded, " << total.TexelFetches << " texel fetches, overdraw " << m_FrameStatistics.GetOverdrawRatio() << "\n";
+	std::cout << "Hi-Z rejected: " << m_FrameStatistics.HiZTrianglesRejected << " triangles, " << m_FrameStatistics.HiZBlocksRejected << " blocks\n";
+	for (size_t i = 0; i < m_FrameStatistics.Meshes.size(); ++i) {
+
+		const MeshStatistics& mesh = m_FrameStatistics.Meshes[i];
+		std::cout << "Mesh " << i << ": LOD " << m_RenderedMeshes[i]->GetLod() << '/' << m_RenderedMeshes[i]->GetNrOfLods() - 1 << ", " << mesh.VerticesTransformed << " vertices, "
+			<< mesh.TrianglesSubmitted << " triangles (" << mesh.TrianglesSaved << " saved), culled " << mesh.BackFacesCulled << " back, "
+			<< mesh.FrontFacesCulled << " front, " << mesh.DegenerateCulled << " degenerate, " << mesh.FrustumCulled << " frustum, clipped " << mesh.TrianglesClipped << ", "
+			<< mesh.PixelsEdgeTested << " pixels edge tested, " << mesh.PixelsDepthPassed << " depth passed, " << mesh.PixelsShaded << " shaded, " << mesh.TexelFetches << " texel fetches\n";
+	}
+}
+
+void Elite::Renderer::ToggleVisibilityBufferRendering()
+{
+	m_VisibilityBufferRendering = !m_VisibilityBufferRendering;
+	PrintVisibilityBufferRenderingInformation();
+}
+
+void Elite::Renderer::PrintVisibilityBufferRenderingInformation()
+{
+	std::cout << "Visibility Buffer Rendering: ";
+	if (m_VisibilityBufferRendering)
+		std::cout << "true\n";
+	else
+		std::cout << "false\n";
+}
+
+void Elite::Renderer::ToggleOverdrawRendering()
+{
+	m_OverdrawRendering = !m_OverdrawRendering;
+	PrintOverdrawRenderingInformation();
+}
+
+void Elite::Renderer::PrintOverdrawRenderingInformation()
+{
+	std::cout << "Overdraw Rendering: ";
+	if (m_OverdrawRendering)
+		std::cout << "true\n";
+	else
+		std::cout << "false\n";
+}
+
+void Elite::Renderer::SetHiZ(bool enabled)
+{
+	m_HiZ = enabled;
+}
+
+void Elite::Renderer::ToggleHiZ()
+{
+	SetHiZ(!m_HiZ);
+	PrintHiZInformation();
+}
+
+void Elite::Renderer::PrintHiZInformation()
+{
+	std::cout << "Hi-Z Rejection: ";
+	if (m_HiZ)
+		std::cout << "true (SIMD and FixedPoint only)\n";
+	else
+		std::cout << "false\n";
+}
+
+void Elite::Renderer::SetQuantizedVertices(bool quantized)
+{
+	m_QuantizedVertices = quantized;
+}
+
+void Elite::Renderer::ToggleQuantizedVertices()
+{
+	SetQuantizedVertices(!m_QuantizedVertices);
+	PrintQuantizedVerticesInformation();
+}
+
+void Elite::Renderer::PrintQuantizedVerticesInformation()
+{
+	std::cout << "Quantized Vertices: ";
+	if (m_QuantizedVertices)
+		std::cout << "true (" << sizeof(QuantizedVertex) << " bytes per vertex, cooked meshes only)\n";
+	else
+		std::cout << "false (" << sizeof(InputVertex) << " bytes per vertex)\n";
+}
+
+void Elite::Renderer::SetLodSelection(bool enabled)
+{
+	m_LodSelection = enabled;
+}
+
+void Elite::Renderer::SetLodErrorThreshold(float pixels)
+{
+	m_LodErrorThreshold = std::max(pixels, 0.f);
+}
+
+void Elite::Renderer::ToggleLodSelection()
+{
+	SetLodSelection(!m_LodSelection);
+	PrintLodSelectionInformation();
+}
+
+//0.5, 1, 2, 4, 8 pixels and back
+void Elite::Renderer::ToggleLodErrorThreshold()
+{
+	SetLodErrorThreshold(m_LodErrorThreshold >= 8.f ? 0.5f : m_LodErrorThreshold * 2.f);
+	PrintLodSelectionInformation();
+}
+
+void Elite::Renderer::PrintLodSelectionInformation()
+{
+	std::cout << "Level Of Detail Selection: ";
+	if (m_LodSelection)
+		std::cout << "true (error threshold " << m_LodErrorThreshold << " pixels)\n";
+	else
+		std::cout << "false\n";
+}
+
 void Elite::Renderer::ToggleEffectRendering()
 {
 	m_RenderEffects = !m_RenderEffects;
@@ -404,6 +614,657 @@ long Elite::Renderer::InitializeDirectX()
 	return 0;
 }
 
+//Both render modes draw the level of detail picked here.
+//The inverse view matrix holds the camera position the way the current render mode sees it
+void Elite::Renderer::SelectLods(const std::vector<Mesh*>& meshes, const Camera* activeCamera)
+{
+	PROFILE_ZONE("SelectLods");
+	const Elite::FVector4& cameraColumn = activeCamera->GetInverseViewMatrix()[3];
+	const Elite::FPoint3 cameraLocation{ cameraColumn.x, cameraColumn.y, cameraColumn.z };
+	const float pixelsPerUnit = activeCamera->GetProjectionMatrix()(1, 1) * m_Height * 0.5f;
+	const RenderMode mode = SceneGraph::GetInstance()->GetRenderMode();
+	for (Mesh* currentMesh : meshes) {
+
+		if (m_LodSelection)
+			currentMesh->SelectLod(cameraLocation, pixelsPerUnit, m_LodErrorThreshold, mode);
+		else
+			currentMesh->SetLod(0);
+	}
+}
+
+void Elite::Renderer::TransformVertices(const std::vector<Mesh*>& meshes, const Camera* activeCamera)
+{
+	PROFILE_ZONE("TransformVertices");
+	const float farPlane = activeCamera->GetFarPlane();
+	const float nearPlane = activeCamera->GetNearPlane();
+	const float FOV = activeCamera->GetFOV();
+	const Elite::FPoint3& cameraLocation = activeCamera->GetLocation();
+	const Elite::FMatrix4& lookAtMatrix = activeCamera->GetViewMatrix();
+
+	m_RenderedMeshes.clear();
+	for (Mesh* currentMesh : meshes) {
+
+		if (!m_RenderEffects && currentMesh->GetEffect()->GetEffectType() != BaseEffect::EffectType::Material)
+			continue;
+
+		m_RenderedMeshes.push_back(currentMesh);
+	}
+	m_FrameStatistics.Meshes.assign(m_RenderedMeshes.size(), MeshStatistics{});
+
+	//Keep the vertex vectors around between frames so their memory gets reused
+	if (m_TransformedVertices.size() < m_RenderedMeshes.size()) {
+
+		m_TransformedVertices.resize(m_RenderedMeshes.size());
+		m_ClipVertices.resize(m_RenderedMeshes.size());
+	}
+
+	for (size_t i = 0; i < m_RenderedMeshes.size(); ++i) {
+
+		Mesh* currentMesh = m_RenderedMeshes[i];
+		m_FrameStatistics.Meshes[i].VerticesTransformed = currentMesh->GetNrOfVertices();
+		m_FrameStatistics.Meshes[i].TrianglesSaved = currentMesh->GetNrOfTrianglesSaved();
+
+		//Meshes without a quantized copy (parsed, not cooked) stay on the float vertices
+		if (m_QuantizedVertices && currentMesh->GetQuantizedVertices()) {
+
+			m_FrameStatistics.Meshes[i].VertexBytesRead = currentMesh->GetNrOfVertices() * sizeof(QuantizedVertex);
+			Rasterizer::VertexTransformationFunction(currentMesh->GetQuantizedVertices(), currentMesh->GetQuantizationOffset(), currentMesh->GetQuantizationScale(), currentMesh->GetNrOfVertices(),
+				m_TransformedVertices[i], m_ClipVertices[i], cameraLocation, lookAtMatrix, currentMesh->GetWorldMatrix(), activeCamera->GetProjectionMatrix(), (float)m_Width, (float)m_Height, nearPlane, farPlane, FOV);
+			continue;
+		}
+
+		m_FrameStatistics.Meshes[i].VertexBytesRead = currentMesh->GetNrOfVertices() * sizeof(InputVertex);
+		Rasterizer::VertexTransformationFunction(currentMesh->GetVertices(), currentMesh->GetNrOfVertices(), m_TransformedVertices[i], m_ClipVertices[i], cameraLocation, lookAtMatrix, currentMesh->GetWorldMatrix(), activeCamera->GetProjectionMatrix(), (float)m_Width, (float)m_Height, nearPlane, farPlane, FOV);
+	}
+}
+
+void Elite::Renderer::BinTriangles()
+{
+	PROFILE_ZONE("SetupAndBinTriangles");
+	m_Triangles.clear();
+	m_TriangleAttributes.clear();
+	for (std::vector<uint32_t>& bin : m_TileBins)
+		bin.clear();
+
+	for (uint32_t meshIndex = 0; meshIndex < (uint32_t)m_RenderedMeshes.size(); ++meshIndex) {
+
+		const Mesh* currentMesh = m_RenderedMeshes[meshIndex];
+		const std::vector<ClipVertex>& clipVertices = m_ClipVertices[meshIndex];
+		const BaseEffect::Culling cullMode = currentMesh->GetCullMode();
+		MeshStatistics& statistics = m_FrameStatistics.Meshes[meshIndex];
+
+		//loop over all indices
+		Mesh::PrimitiveToplogy topology = currentMesh->GetPrimitveTopology();
+		for (int i = 0; i < currentMesh->GetNrOfTriangles(); i += (int)topology) {
+
+			//Check which topology we use and implement it
+			int index0, index1, index2;
+			currentMesh->GetTriangleIndices(i, index0, index1, index2);
+
+			//If end of strip (surface triangle), continue
+			if (index0 == index1 || index1 == index2 || index0 == index2)
+				continue;
+			++statistics.TrianglesSubmitted;
+
+			//Frustrum culling, all vertices outside of the same plane
+			const uint32_t outCode0 = clipVertices[index0].OutCode;
+			const uint32_t outCode1 = clipVertices[index1].OutCode;
+			const uint32_t outCode2 = clipVertices[index2].OutCode;
+			if (outCode0 & outCode1 & outCode2 & Rasterizer::FrustumPlanes) {
+
+				++statistics.FrustumCulled;
+				continue;
+			}
+
+			//Only triangles crossing the near/far plane or the guard band need clipping
+			const uint32_t clipPlanes = (outCode0 | outCode1 | outCode2) & Rasterizer::ClippingPlanes;
+			if (clipPlanes == 0)
+				BinTriangle(meshIndex, index0, index1, index2, cullMode, statistics);
+			else
+				ClipTriangle(meshIndex, index0, index1, index2, clipPlanes, cullMode, statistics);
+		}
+	}
+}
+
+void Elite::Renderer::ClipTriangle(uint32_t meshIndex, int index0, int index1, int index2, uint32_t clipPlanes, BaseEffect::Culling cullMode, MeshStatistics& statistics)
+{
+	std::vector<OutputVertex>& vertices = m_TransformedVertices[meshIndex];
+	const std::vector<ClipVertex>& clipVertices = m_ClipVertices[meshIndex];
+	++statistics.TrianglesClipped;
+
+	//Clip with the positions from before the divide
+	Rasterizer::ClipPolygon polygon;
+	polygon.NrOfVertices = 3;
+	const int indices[3] = { index0, index1, index2 };
+	for (int i = 0; i < 3; ++i) {
+
+		polygon.Vertices[i] = vertices[indices[i]];
+		polygon.Vertices[i].Position = clipVertices[indices[i]].Position;
+	}
+
+	if (!Rasterizer::ClipPolygonToPlanes(polygon, clipPlanes))
+		return;
+
+	//The new vertices get added behind the ones of the mesh, so the clipped triangles can use indices like any other triangle
+	const int firstIndex = (int)vertices.size();
+	for (uint32_t i = 0; i < polygon.NrOfVertices; ++i) {
+
+		Rasterizer::ProjectToScreen(polygon.Vertices[i].Position, (float)m_Width, (float)m_Height);
+		vertices.push_back(polygon.Vertices[i]);
+	}
+
+	//Triangle fan, the clipper keeps the winding order
+	for (uint32_t i = 1; i + 1 < polygon.NrOfVertices; ++i)
+		BinTriangle(meshIndex, firstIndex, firstIndex + (int)i, firstIndex + (int)i + 1, cullMode, statistics);
+}
+
+void Elite::Renderer::BinTriangle(uint32_t meshIndex, int index0, int index1, int index2, BaseEffect::Culling cullMode, MeshStatistics& statistics)
+{
+	const std::vector<OutputVertex>& vertices = m_TransformedVertices[meshIndex];
+
+	//The fixed point coverage uses the snapped vertices, so the culling, the bounds and the planes have to use them as well
+	//or depth and attributes get evaluated on a slightly different triangle than the one that gets covered
+	const bool snap = m_RasterizationMode == RasterizationMode::FixedPoint;
+	const Elite::FPoint4 v0 = snap ? Rasterizer::SnapToSubPixel(vertices[index0].Position) : vertices[index0].Position;
+	const Elite::FPoint4 v1 = snap ? Rasterizer::SnapToSubPixel(vertices[index1].Position) : vertices[index1].Position;
+	const Elite::FPoint4 v2 = snap ? Rasterizer::SnapToSubPixel(vertices[index2].Position) : vertices[index2].Position;
+
+	//Face and degenerate culling, once per triangle instead of scanning the whole bounding box
+	const float signedArea = Rasterizer::SignedArea(v0, v1, v2);
+	if (signedArea == 0.f) {
+
+		++statistics.DegenerateCulled;
+		return;
+	}
+	if (Rasterizer::IsCulled(signedArea, cullMode)) {
+
+		if (signedArea > 0.f)
+			++statistics.BackFacesCulled;
+		else
+			++statistics.FrontFacesCulled;
+		return;
+	}
+
+	//Edge equations are calculated once here instead of for every pixel
+	BinnedTriangle triangle{ meshIndex, index0, index1, index2 };
+	if (!Rasterizer::SetupTriangle(triangle, v0, v1, v2))
+		return;
+	if (m_RasterizationMode == RasterizationMode::FixedPoint && !Rasterizer::SetupFixedPointTriangle(triangle, v0, v1, v2))
+		return;
+	triangle.MinDepth = std::min(v0.z, std::min(v1.z, v2.z));
+
+	//The loops used to run while pixel < max, so the exclusive bound is the rounded up max.
+	//Clamping to the screen makes sure nothing outside of it (inside the guard band) gets rasterized
+	std::pair<Elite::FPoint2, Elite::FPoint2> boundingBox = Rasterizer::CreateBoundingBox(v0, v1, v2, m_Width, m_Height);
+	triangle.MinX = uint32_t(boundingBox.first.x);
+	triangle.MinY = uint32_t(boundingBox.first.y);
+	triangle.MaxX = uint32_t(std::ceil(boundingBox.second.x));
+	triangle.MaxY = uint32_t(std::ceil(boundingBox.second.y));
+	if (triangle.MinX >= triangle.MaxX || triangle.MinY >= triangle.MaxY)
+		return;
+
+	//Add the triangle to every tile its bounding box touches, triangles stay in submission order per tile
+	const uint32_t triangleIndex = (uint32_t)m_Triangles.size();
+	m_Triangles.push_back(triangle);
+
+	//Attribute planes replace reading and dividing the 3 vertices for every pixel
+	m_TriangleAttributes.emplace_back();
+	Rasterizer::SetupAttributes(m_TriangleAttributes.back(), triangle, vertices[index0], vertices[index1], vertices[index2]);
+
+	for (uint32_t tileY = triangle.MinY / m_TileSize; tileY <= (triangle.MaxY - 1) / m_TileSize; ++tileY)
+		for (uint32_t tileX = triangle.MinX / m_TileSize; tileX <= (triangle.MaxX - 1) / m_TileSize; ++tileX)
+			m_TileBins[tileX + (tileY * m_NrOfTilesX)].push_back(triangleIndex);
+}
+
+void Elite::Renderer::RenderTile(uint32_t tileIndex, uint32_t clearPixel)
+{
+	const uint32_t tileMinX = (tileIndex % m_NrOfTilesX) * m_TileSize;
+	const uint32_t tileMinY = (tileIndex / m_NrOfTilesX) * m_TileSize;
+	const uint32_t tileMaxX = std::min(tileMinX + m_TileSize, m_Width);
+	const uint32_t tileMaxY = std::min(tileMinY + m_TileSize, m_Height);
+
+	//Clear the part of the buffers that this tile owns
+	{
+		PROFILE_ZONE("ClearTile");
+		for (uint32_t r = tileMinY; r < tileMaxY; ++r) {
+
+			std::fill(m_pBackBufferPixels + tileMinX + (r * m_Width), m_pBackBufferPixels + tileMaxX + (r * m_Width), clearPixel);
+			std::fill(m_DepthBuffer.begin() + tileMinX + (r * m_Width), m_DepthBuffer.begin() + tileMaxX + (r * m_Width), FLT_MAX);
+			if (m_VisibilityBufferRendering)
+				std::fill(m_VisibilityBuffer.begin() + tileMinX + (r * m_Width), m_VisibilityBuffer.begin() + tileMaxX + (r * m_Width), 0);
+			if (m_OverdrawRendering)
+				std::fill(m_OverdrawBuffer.begin() + tileMinX + (r * m_Width), m_OverdrawBuffer.begin() + tileMaxX + (r * m_Width), 0);
+		}
+
+		for (uint32_t blockY = tileMinY / m_BlockSize; blockY < (tileMaxY + m_BlockSize - 1) / m_BlockSize; ++blockY) {
+			for (uint32_t blockX = tileMinX / m_BlockSize; blockX < (tileMaxX + m_BlockSize - 1) / m_BlockSize; ++blockX) {
+
+				m_HiZBlocks[blockX + (blockY * m_NrOfBlocksX)] = FLT_MAX;
+				m_HiZBlockWrites[blockX + (blockY * m_NrOfBlocksX)] = 0.f;
+				m_HiZBlockCoverage[blockX + (blockY * m_NrOfBlocksX)] = 0;
+			}
+		}
+		m_HiZTiles[tileIndex] = FLT_MAX;
+	}
+
+	//Reset the counters of this tile, the memory of the mesh counters gets reused
+	FrameStatistics& statistics = m_TileStatistics[tileIndex];
+	std::vector<MeshStatistics> meshStatistics = std::move(statistics.Meshes);
+	meshStatistics.assign(m_RenderedMeshes.size(), MeshStatistics{});
+	statistics = FrameStatistics{};
+	statistics.Meshes = std::move(meshStatistics);
+
+	//The reference mode stays as it was, without the Hi-Z rejection.
+	//Without the visibility buffer the pixels get shaded while rasterizing, so this zone holds the shading as well
+	const bool useHiZ = m_HiZ && m_RasterizationMode != RasterizationMode::Reference;
+	{
+		PROFILE_ZONE("RasterizeTile");
+		for (uint32_t triangleIndex : m_TileBins[tileIndex]) {
+
+			const BinnedTriangle& triangle = m_Triangles[triangleIndex];
+
+			//The whole triangle lies behind everything that was drawn in this tile
+			if (useHiZ && triangle.MinDepth > m_HiZTiles[tileIndex]) {
+
+				++statistics.HiZTrianglesRejected;
+				continue;
+			}
+
+			if (RasterizeTriangle(triangle, tileMinX, tileMinY, tileMaxX, tileMaxY, statistics) && useHiZ)
+				UpdateHiZTile(tileIndex, tileMinX, tileMinY, tileMaxX, tileMaxY);
+		}
+	}
+
+	if (m_OverdrawRendering)
+		ResolveOverdraw(tileMinX, tileMinY, tileMaxX, tileMaxY);
+	else if (m_VisibilityBufferRendering) {
+
+		PROFILE_ZONE("ShadeTile");
+		ResolveVisibilityBuffer(tileMinX, tileMinY, tileMaxX, tileMaxY, statistics);
+	}
+}
+
+//Depths only ever get closer, so a bound of the block stays valid until a triangle covers the whole block and gives a tighter one.
+//Partly covered blocks can't tighten without reading the depths back, they keep the bound they had
+void Elite::Renderer::UpdateHiZBlock(uint32_t blockX, uint32_t blockY, const HiZBlockWrite& blockWrite)
+{
+	const uint32_t blockIndex = blockX + (blockY * m_NrOfBlocksX);
+	const uint32_t nrOfBlockPixels = (std::min((blockX + 1) * m_BlockSize, m_Width) - blockX * m_BlockSize) * (std::min((blockY + 1) * m_BlockSize, m_Height) - blockY * m_BlockSize);
+	if (blockWrite.NrOfPixels == nrOfBlockPixels) {
+
+		m_HiZBlockCoverage[blockIndex] = nrOfBlockPixels;
+		m_HiZBlocks[blockIndex] = blockWrite.FarthestDepth;
+		m_HiZBlockWrites[blockIndex] = blockWrite.FarthestDepth;
+		return;
+	}
+
+	m_HiZBlockWrites[blockIndex] = std::max(m_HiZBlockWrites[blockIndex], blockWrite.FarthestDepth);
+	m_HiZBlockCoverage[blockIndex] += blockWrite.NrOfNewPixels;
+	if (m_HiZBlockCoverage[blockIndex] == nrOfBlockPixels)
+		m_HiZBlocks[blockIndex] = std::min(m_HiZBlocks[blockIndex], m_HiZBlockWrites[blockIndex]);
+}
+
+void Elite::Renderer::UpdateHiZTile(uint32_t tileIndex, uint32_t tileMinX, uint32_t tileMinY, uint32_t tileMaxX, uint32_t tileMaxY)
+{
+	float farthestDepth = 0.f;
+	for (uint32_t blockY = tileMinY / m_BlockSize; blockY < (tileMaxY + m_BlockSize - 1) / m_BlockSize; ++blockY)
+		for (uint32_t blockX = tileMinX / m_BlockSize; blockX < (tileMaxX + m_BlockSize - 1) / m_BlockSize; ++blockX)
+			farthestDepth = std::max(farthestDepth, m_HiZBlocks[blockX + (blockY * m_NrOfBlocksX)]);
+
+	m_HiZTiles[tileIndex] = farthestDepth;
+}
+
+//Returns true if any pixel of the tile was written
+bool Elite::Renderer::RasterizeTriangle(const BinnedTriangle& triangle, uint32_t tileMinX, uint32_t tileMinY, uint32_t tileMaxX, uint32_t tileMaxY, FrameStatistics& statistics)
+{
+	bool written = false;
+	const BaseEffect::Culling cullMode = m_RenderedMeshes[triangle.MeshIndex]->GetCullMode();
+	MeshStatistics& meshStatistics = statistics.Meshes[triangle.MeshIndex];
+
+	//Clip the bounding box to this tile
+	const uint32_t minX = std::max(triangle.MinX, tileMinX);
+	const uint32_t minY = std::max(triangle.MinY, tileMinY);
+	const uint32_t maxX = std::min(triangle.MaxX, tileMaxX);
+	const uint32_t maxY = std::min(triangle.MaxY, tileMaxY);
+
+	switch (m_RasterizationMode)
+	{
+	case RasterizationMode::Reference:
+		{
+			const std::vector<OutputVertex>& vertices = m_TransformedVertices[triangle.MeshIndex];
+			const Elite::FPoint4& v0 = vertices[triangle.Index0].Position;
+			const Elite::FPoint4& v1 = vertices[triangle.Index1].Position;
+			const Elite::FPoint4& v2 = vertices[triangle.Index2].Position;
+
+			//Calculate total weight
+			float totalWeight = Elite::Cross(v0.xy - v1.xy, v0.xy - v2.xy);
+
+			//Loop over all the pixels
+			for (uint32_t r = minY; r < maxY; ++r)
+			{
+				for (uint32_t c = minX; c < maxX; ++c)
+				{
+					//Create current pixel
+					++meshStatistics.PixelsEdgeTested;
+					float weight0, weight1, weight2;
+					if (!PixelInTri((float)c, (float)r, v0, v1, v2, weight0, weight1, weight2, cullMode))
+						continue;
+
+					//Transform weights into ratio's
+					weight0 /= totalWeight;
+					weight1 /= totalWeight;
+					weight2 /= totalWeight;
+
+					//Check if the weights add up to 1
+					if (std::round(weight0 + weight1 + weight2) != 1)
+						continue;
+
+					written |= ShadePixel(triangle, c, r, meshStatistics, nullptr);
+				}
+			}
+		}
+		break;
+	case RasterizationMode::SIMD:
+	case RasterizationMode::FixedPoint:
+		{
+			//Walk the bounding box in aligned blocks, tiles start on a multiple of the block size
+			const uint32_t blockMask = ~(m_BlockSize - 1);
+			for (uint32_t blockY = minY & blockMask; blockY < maxY; blockY += m_BlockSize) {
+				for (uint32_t blockX = minX & blockMask; blockX < maxX; blockX += m_BlockSize) {
+
+					//Skip blocks where the triangle lies behind everything that was drawn
+					const uint32_t hiZIndex = (blockX / m_BlockSize) + ((blockY / m_BlockSize) * m_NrOfBlocksX);
+					if (m_HiZ && triangle.MinDepth > m_HiZBlocks[hiZIndex]) {
+
+						++statistics.HiZBlocksRejected;
+						continue;
+					}
+
+					HiZBlockWrite blockWrite{};
+					const bool blockWritten = m_RasterizationMode == RasterizationMode::FixedPoint
+						? RasterizeFixedPointBlock(triangle, blockX, blockY, minX, minY, maxX, maxY, meshStatistics, blockWrite)
+						: RasterizeBlock(triangle, blockX, blockY, m_BlockSize, cullMode, minX, minY, maxX, maxY, meshStatistics, blockWrite);
+					if (blockWritten) {
+
+						UpdateHiZBlock(blockX / m_BlockSize, blockY / m_BlockSize, blockWrite);
+						written = true;
+					}
+				}
+			}
+		}
+		break;
+	default:
+		break;
+	}
+
+	return written;
+}
+
+//Returns true if any pixel of the block was written
+bool Elite::Renderer::RasterizeBlock(const BinnedTriangle& triangle, uint32_t blockX, uint32_t blockY, uint32_t blockSize, BaseEffect::Culling cullMode, uint32_t minX, uint32_t minY, uint32_t maxX, uint32_t maxY, MeshStatistics& statistics, HiZBlockWrite& blockWrite)
+{
+	switch (Rasterizer::ClassifyBlock(triangle, (float)blockX, (float)blockY, (float)blockSize, cullMode))
+	{
+	case Rasterizer::BlockCoverage::Outside:
+		return false;
+	case Rasterizer::BlockCoverage::Inside:
+		return RasterizeBlockRows(triangle, blockX, blockY, blockSize, cullMode, false, minX, minY, maxX, maxY, statistics, blockWrite);
+	case Rasterizer::BlockCoverage::Partial:
+		{
+			//Split 8x8 blocks into 4x4 blocks, the edge of the triangle goes trough 4x4 blocks are tested per pixel
+			if (blockSize <= 4)
+				return RasterizeBlockRows(triangle, blockX, blockY, blockSize, cullMode, true, minX, minY, maxX, maxY, statistics, blockWrite);
+
+			bool written = false;
+
+			const uint32_t subBlockSize = blockSize / 2;
+			for (uint32_t subBlockY = blockY; subBlockY < std::min(blockY + blockSize, maxY); subBlockY += subBlockSize) {
+				for (uint32_t subBlockX = blockX; subBlockX < std::min(blockX + blockSize, maxX); subBlockX += subBlockSize) {
+
+					//Skip the parts of the block that fall outside of the bounding box
+					if (subBlockX + subBlockSize <= minX || subBlockY + subBlockSize <= minY)
+						continue;
+
+					written |= RasterizeBlock(triangle, subBlockX, subBlockY, subBlockSize, cullMode, minX, minY, maxX, maxY, statistics, blockWrite);
+				}
+			}
+			return written;
+		}
+	default:
+		return false;
+	}
+}
+
+//Returns true if any pixel of the block was written
+bool Elite::Renderer::RasterizeBlockRows(const BinnedTriangle& triangle, uint32_t blockX, uint32_t blockY, uint32_t blockSize, BaseEffect::Culling cullMode, bool testEdges, uint32_t minX, uint32_t minY, uint32_t maxX, uint32_t maxY, MeshStatistics& statistics, HiZBlockWrite& blockWrite)
+{
+	bool written = false;
+	const uint32_t rowStart = std::max(blockY, minY);
+	const uint32_t rowEnd = std::min(blockY + blockSize, maxY);
+	const uint32_t columnEnd = std::min(blockX + blockSize, maxX);
+
+	//Step the edge equations 4 pixels at a time, the start of every row is evaluated directly
+	for (uint32_t r = rowStart; r < rowEnd; ++r)
+	{
+		Rasterizer::EdgeBlock4 block{ triangle, (float)blockX, (float)r };
+		for (uint32_t c = blockX; c < columnEnd; c += 4, block.Step())
+		{
+			//Switch off the pixels outside of the (tile clipped) bounding box
+			int coverage = 0xF;
+			for (uint32_t lane = 0; lane < 4; ++lane) {
+
+				if (c + lane < minX || c + lane >= maxX)
+					coverage &= ~(1 << lane);
+			}
+
+			//Blocks that are completely inside skip the edge test
+			if (testEdges) {
+
+				statistics.PixelsEdgeTested += Rasterizer::CountCoveredPixels(coverage);
+				coverage &= block.CoverageMask(cullMode);
+			}
+
+			if (coverage == 0)
+				continue;
+
+			for (uint32_t lane = 0; lane < 4; ++lane) {
+
+				if (coverage & (1 << lane))
+					written |= ShadePixel(triangle, c + lane, r, statistics, &blockWrite);
+			}
+		}
+	}
+
+	return written;
+}
+
+//Returns true if any pixel of the block was written
+bool Elite::Renderer::RasterizeFixedPointBlock(const BinnedTriangle& triangle, uint32_t blockX, uint32_t blockY, uint32_t minX, uint32_t minY, uint32_t maxX, uint32_t maxY, MeshStatistics& statistics, HiZBlockWrite& blockWrite)
+{
+	int32_t startValues[3];
+	int testedEdges;
+	if (Rasterizer::ClassifyFixedPointBlock(triangle, blockX, blockY, m_BlockSize, startValues, testedEdges) == Rasterizer::BlockCoverage::Outside)
+		return false;
+
+	bool written = false;
+	const uint32_t rowStart = std::max(blockY, minY);
+	const uint32_t rowEnd = std::min(blockY + m_BlockSize, maxY);
+	const uint32_t columnEnd = std::min(blockX + m_BlockSize, maxX);
+
+	//Integer steps are exact, every row starts from the block values moved down by B per pixel
+	int32_t rowValues[3];
+	for (uint32_t r = rowStart; r < rowEnd; ++r)
+	{
+		for (int i = 0; i < 3; ++i)
+			rowValues[i] = startValues[i] + int32_t(triangle.FixedPointEdges[i].B * Rasterizer::SubPixelScale) * int32_t(r - blockY);
+
+		Rasterizer::FixedPointEdgeBlock4 block{ rowValues, triangle, testedEdges };
+		for (uint32_t c = blockX; c < columnEnd; c += 4, block.StepX())
+		{
+			//Switch off the pixels outside of the (tile clipped) bounding box
+			int coverage = 0xF;
+			for (uint32_t lane = 0; lane < 4; ++lane) {
+
+				if (c + lane < minX || c + lane >= maxX)
+					coverage &= ~(1 << lane);
+			}
+
+			statistics.PixelsEdgeTested += Rasterizer::CountCoveredPixels(coverage);
+			coverage &= block.CoverageMask();
+			for (uint32_t lane = 0; lane < 4; ++lane) {
+
+				if (coverage & (1 << lane))
+					written |= ShadePixel(triangle, c + lane, r, statistics, &blockWrite);
+			}
+		}
+	}
+
+	return written;
+}
+
+//Returns true if the pixel passed the depth test and got written, pBlockWrite (optional) gathers the depth for the Hi-Z block
+bool Elite::Renderer::ShadePixel(const BinnedTriangle& triangle, uint32_t c, uint32_t r, MeshStatistics& statistics, HiZBlockWrite* pBlockWrite)
+{
+	const uint32_t triangleIndex = GetTriangleIndex(triangle);
+
+	//Calculate the depth for a depth-check, the clipper keeps it within [0, 1] up to rounding.
+	//Triangle.MinDepth is the smallest vertex depth, so it bounds this plane for the Hi-Z tests
+	const float sampleOffset = GetSampleOffset();
+	const float depth = Rasterizer::InterpolateAttribute(m_TriangleAttributes[triangleIndex], TriangleAttributes::Depth, (float)c + sampleOffset, (float)r + sampleOffset);
+	if (!(depth >= 0.f && depth <= 1.f && depth < m_DepthBuffer[c + (r * m_Width)]))
+		return false;
+
+	//The pixel still has the cleared depth, this is its first write
+	const bool firstWrite = m_DepthBuffer[c + (r * m_Width)] == FLT_MAX;
+	if (pBlockWrite) {
+
+		pBlockWrite->FarthestDepth = std::max(pBlockWrite->FarthestDepth, depth);
+		++pBlockWrite->NrOfPixels;
+		pBlockWrite->NrOfNewPixels += firstWrite;
+	}
+
+	//Set depth to found depth
+	m_DepthBuffer[c + (r * m_Width)] = depth;
+	++statistics.PixelsDepthPassed;
+	statistics.PixelsCovered += firstWrite;
+
+	//Only count the write, the heat map gets drawn once the whole tile is rasterized
+	if (m_OverdrawRendering) {
+
+		++m_OverdrawBuffer[c + (r * m_Width)];
+		return true;
+	}
+
+	//Only remember which triangle is visible, it gets shaded once the whole tile is rasterized
+	if (m_VisibilityBufferRendering) {
+
+		m_VisibilityBuffer[c + (r * m_Width)] = triangleIndex + 1;
+		return true;
+	}
+
+	ShadeFragment(triangleIndex, c, r, statistics);
+	return true;
+}
+
+void Elite::Renderer::ShadeFragment(uint32_t triangleIndex, uint32_t c, uint32_t r, MeshStatistics& statistics)
+{
+	const Mesh* currentMesh = m_RenderedMeshes[m_Triangles[triangleIndex].MeshIndex];
+	++statistics.PixelsShaded;
+
+	Elite::RGBColor finalColor{};
+	if (!m_DepthRendering) {
+
+		//Every map uses the sample mode of the effect
+		const uint32_t texelFetches = Texture::GetNrOfTexelFetches(currentMesh->GetEffect()->GetSampleMode());
+
+		//Interpolate every attribute at once, the planes hold attribute / w
+		alignas(16) float interpolants[TriangleAttributes::NrOfPaddedSlots];
+		const float sampleOffset = GetSampleOffset();
+		Rasterizer::InterpolateAttributes(m_TriangleAttributes[triangleIndex], (float)c + sampleOffset, (float)r + sampleOffset, interpolants);
+		const float depth = 1.f / interpolants[TriangleAttributes::InverseW];
+
+		//Uv calculation, the derivatives of the 2x2 quad the pixel is in pick the mip level
+		const Elite::FVector2 finalUV{ interpolants[TriangleAttributes::U] * depth, interpolants[TriangleAttributes::V] * depth };
+		Elite::FVector2 dUVdx, dUVdy;
+		Rasterizer::CalculateUVDerivatives(m_TriangleAttributes[triangleIndex], float(c & ~1u) + sampleOffset, float(r & ~1u) + sampleOffset, dUVdx, dUVdy);
+
+		//Color calculation (either with uv or colors)
+		finalColor = currentMesh->SampleTexture(finalUV, dUVdx, dUVdy);
+		statistics.TexelFetches += texelFetches;
+
+		//Normal Calculation
+		const Elite::FVector3 finalNormal = Elite::GetNormalized(Elite::FVector3{ interpolants[TriangleAttributes::NormalX], interpolants[TriangleAttributes::NormalY], interpolants[TriangleAttributes::NormalZ] } * depth);
+
+		//Tangent Calculation
+		const Elite::FVector3 finalTangent = Elite::GetNormalized(Elite::FVector3{ interpolants[TriangleAttributes::TangentX], interpolants[TriangleAttributes::TangentY], interpolants[TriangleAttributes::TangentZ] } * depth);
+
+		//ViewDirection Calculation
+		const Elite::FVector3 finalViewDirection = Elite::FVector3{ interpolants[TriangleAttributes::ViewDirectionX], interpolants[TriangleAttributes::ViewDirectionY], interpolants[TriangleAttributes::ViewDirectionZ] } * depth;
+
+		//Lighting Calculation
+		if (currentMesh->GetMaterialMap().IsValid()) {
+
+			statistics.TexelFetches += texelFetches;
+			finalColor = Rasterizer::PixelShading(OutputVertex{ {}, finalUV, finalNormal, finalTangent, finalColor, finalViewDirection }, currentMesh->SampleMaterialMap(finalUV, dUVdx, dUVdy), currentMesh->GetShininess(), currentMesh->GetLightIntensity());
+		}
+	}
+	else {
+		float depthColor = Elite::Remap(m_DepthBuffer[c + (r * m_Width)], 0.985f, 1.f);
+		finalColor = { depthColor, depthColor, depthColor };
+	}
+	finalColor.MaxToOne();
+	finalColor.Clamp();
+
+	//Color the pixels
+	m_pBackBufferPixels[c + (r * m_Width)] = SDL_MapRGB(m_pBackBuffer->format,
+		static_cast<uint8_t>(finalColor.r * 255.f),
+		static_cast<uint8_t>(finalColor.g * 255.f),
+		static_cast<uint8_t>(finalColor.b * 255.f));
+}
+
+//Second pass of the visibility buffer, every covered pixel of the tile gets shaded exactly once
+void Elite::Renderer::ResolveVisibilityBuffer(uint32_t tileMinX, uint32_t tileMinY, uint32_t tileMaxX, uint32_t tileMaxY, FrameStatistics& statistics)
+{
+	for (uint32_t r = tileMinY; r < tileMaxY; ++r) {
+		for (uint32_t c = tileMinX; c < tileMaxX; ++c) {
+
+			const uint32_t visibleTriangle = m_VisibilityBuffer[c + (r * m_Width)];
+			if (visibleTriangle != 0)
+				ShadeFragment(visibleTriangle - 1, c, r, statistics.Meshes[m_Triangles[visibleTriangle - 1].MeshIndex]);
+		}
+	}
+}
+
+//Colors every written pixel of the tile by the amount of times it passed the depth test
+void Elite::Renderer::ResolveOverdraw(uint32_t tileMinX, uint32_t tileMinY, uint32_t tileMaxX, uint32_t tileMaxY)
+{
+	for (uint32_t r = tileMinY; r < tileMaxY; ++r) {
+		for (uint32_t c = tileMinX; c < tileMaxX; ++c) {
+
+			const uint32_t nrOfWrites = m_OverdrawBuffer[c + (r * m_Width)];
+			if (nrOfWrites == 0)
+				continue;
+
+			const Elite::RGBColor heatColor = Rasterizer::OverdrawColor(nrOfWrites);
+			m_pBackBufferPixels[c + (r * m_Width)] = SDL_MapRGB(m_pBackBuffer->format,
+				static_cast<uint8_t>(heatColor.r * 255.f),
+				static_cast<uint8_t>(heatColor.g * 255.f),
+				static_cast<uint8_t>(heatColor.b * 255.f));
+		}
+	}
+}
+
+//The fixed point rasterizer samples pixel centers, the float ones the top left corner of the pixel
+float Elite::Renderer::GetSampleOffset() const
+{
+	return m_RasterizationMode == RasterizationMode::FixedPoint ? 0.5f : 0.f;
+}
+
+uint32_t Elite::Renderer::GetTriangleIndex(const BinnedTriangle& triangle) const
+{
+	return uint32_t(&triangle - m_Triangles.data());
+}
+
 bool Elite::Renderer::PixelInTri(float col, float row, const Elite::FPoint4& v0, const Elite::FPoint4& v1, const Elite::FPoint4& v2, float& weight0, float& weight1, float& weight2, BaseEffect::Culling cullMode) const
 {
 	Elite::FVector2 currentEdge;
@@ -444,60 +1305,3 @@ bool Elite::Renderer::PixelInTri(float col, float row, const Elite::FPoint4& v0,
 
 	return true;
 }
-
-void Elite::Renderer::CalculateDepthBuffer(float& depth, float w0, float w1, float w2, int i0, int i1, int i2, const std::vector<OutputVertex>& vertices) const
-{
-	depth = (1 / vertices[i0].Position.z) * w0;
-	depth += (1 / vertices[i1].Position.z) * w1;
-	depth += (1 / vertices[i2].Position.z) * w2;
-	depth = 1 / depth;
-}
-void Elite::Renderer::CalculateDepthInterpolated(float& depth, float w0, float w1, float w2, int i0, int i1, int i2, const std::vector<OutputVertex>& vertices) const
-{
-	depth = (1 / vertices[i0].Position.w) * w0;
-	depth += (1 / vertices[i1].Position.w) * w1;
-	depth += (1 / vertices[i2].Position.w) * w2;
-	depth = 1 / depth;
-}
-
-void Elite::Renderer::CalculateUV(Elite::FVector2& finalUV, float depth, float w0, float w1, float w2, int i0, int i1, int i2, const std::vector<OutputVertex>& vertices) const
-{
-	finalUV = (vertices[i0].UV / vertices[i0].Position.w) * w0;
-	finalUV += (vertices[i1].UV / vertices[i1].Position.w) * w1;
-	finalUV += (vertices[i2].UV / vertices[i2].Position.w) * w2;
-	finalUV *= depth;
-}
-
-void Elite::Renderer::CalculateNormal(Elite::FVector3& finalNormal, float depth, float w0, float w1, float w2, int i0, int i1, int i2, const std::vector<OutputVertex>& vertices) const
-{
-	finalNormal = (vertices[i0].Normal / vertices[i0].Position.w) * w0;
-	finalNormal += (vertices[i1].Normal / vertices[i1].Position.w) * w1;
-	finalNormal += (vertices[i2].Normal / vertices[i2].Position.w) * w2;
-	finalNormal *= depth;
-	Elite::Normalize(finalNormal);
-}
-
-void Elite::Renderer::CalculateTangent(Elite::FVector3& finalTangent, float depth, float w0, float w1, float w2, int i0, int i1, int i2, const std::vector<OutputVertex>& vertices) const
-{
-	finalTangent = (vertices[i0].Tangent / vertices[i0].Position.w) * w0;
-	finalTangent += (vertices[i1].Tangent / vertices[i1].Position.w) * w1;
-	finalTangent += (vertices[i2].Tangent / vertices[i2].Position.w) * w2;
-	finalTangent *= depth;
-	Elite::Normalize(finalTangent);
-}
-
-void Elite::Renderer::CalculateViewDirection(Elite::FVector3& finalViewDirection, float depth, float w0, float w1, float w2, int i0, int i1, int i2, const std::vector<OutputVertex>& vertices) const
-{
-	finalViewDirection = (vertices[i0].ViewDirection / vertices[i0].Position.w) * w0;
-	finalViewDirection += (vertices[i1].ViewDirection / vertices[i1].Position.w) * w1;
-	finalViewDirection += (vertices[i2].ViewDirection / vertices[i2].Position.w) * w2;
-	finalViewDirection *= depth;
-}
-
-void Elite::Renderer::CalculateColor(Elite::RGBColor& finalColor, float depth, float w0, float w1, float w2, int i0, int i1, int i2, const std::vector<OutputVertex>& vertices) const
-{
-	finalColor = (vertices[i0].Color / vertices[i0].Position.w) * w0;
-	finalColor += (vertices[i1].Color / vertices[i1].Position.w) * w1;
-	finalColor += (vertices[i2].Color / vertices[i2].Position.w) * w2;
-	finalColor *= depth;
-}
\ No newline at end of file
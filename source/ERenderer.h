@@ -13,6 +13,8 @@
 
 struct SDL_Window;
 struct SDL_Surface;
+class Camera;
+class ThreadPool;
 
 namespace Elite
 {
@@ -20,6 +22,7 @@ namespace Elite
 	{
 	public:
 		Renderer(SDL_Window* pWindow);
+		Renderer(uint32_t width, uint32_t height);
 		~Renderer();
 
 		Renderer(const Renderer&) = delete;
@@ -29,10 +32,40 @@ namespace Elite
 
 		void Render();
 		ID3D11Device* GetDevice();
+		bool IsHeadless() const;
+		uint32_t GetWidth() const;
+		uint32_t GetHeight() const;
+		void ReadColorBuffer(std::vector<uint8_t>& rgba) const;
+		const std::vector<float>& GetDepthBuffer() const;
+		bool SaveFrame(const std::string& path) const;
+		void SetDepthRendering(bool depthRendering);
 		void ToggleDepthRendering();
 		void PrintDepthRenderingInformation();
 		void ToggleEffectRendering();
 		void PrintEffectRenderingInformation();
+		void ToggleMultiThreading();
+		void PrintMultiThreadingInformation();
+		void SetNrOfThreads(uint32_t nrOfThreads);
+		void SetRasterizationMode(RasterizationMode mode);
+		void ToggleRasterizationMode();
+		void PrintRasterizationModeInformation();
+		void ToggleVisibilityBufferRendering();
+		void PrintVisibilityBufferRenderingInformation();
+		void ToggleOverdrawRendering();
+		void PrintOverdrawRenderingInformation();
+		void SetHiZ(bool enabled);
+		void ToggleHiZ();
+		void PrintHiZInformation();
+		void SetQuantizedVertices(bool quantized);
+		void ToggleQuantizedVertices();
+		void PrintQuantizedVerticesInformation();
+		void SetLodSelection(bool enabled);
+		void SetLodErrorThreshold(float pixels);
+		void ToggleLodSelection();
+		void ToggleLodErrorThreshold();
+		void PrintLodSelectionInformation();
+		const FrameStatistics& GetFrameStatistics() const;
+		void PrintFrameStatistics() const;
 
 	private:
 		SDL_Window* m_pWindow;
@@ -41,19 +74,21 @@ namespace Elite
 
 		//My Variables
 		bool m_RenderEffects = true;
+		bool m_LodSelection = true;
+		float m_LodErrorThreshold = 1.f; //Pixels a level of detail may be off on the screen
 
 		//DirectX
-		ID3D11Device* m_pDevice;
-		ID3D11DeviceContext* m_pDeviceContext;
+		ID3D11Device* m_pDevice = nullptr;
+		ID3D11DeviceContext* m_pDeviceContext = nullptr;
 		
-		IDXGIFactory* m_pDXGIFactory;
-		IDXGISwapChain* m_pSwapChain;
+		IDXGIFactory* m_pDXGIFactory = nullptr;
+		IDXGISwapChain* m_pSwapChain = nullptr;
 		
-		ID3D11Texture2D* m_pDepthStencilBuffer;
-		ID3D11DepthStencilView* m_pDepthStencilView;
+		ID3D11Texture2D* m_pDepthStencilBuffer = nullptr;
+		ID3D11DepthStencilView* m_pDepthStencilView = nullptr;
 
-		ID3D11Texture2D* m_pRenderTargetBuffer;
-		ID3D11RenderTargetView* m_pRenderTargetView;
+		ID3D11Texture2D* m_pRenderTargetBuffer = nullptr;
+		ID3D11RenderTargetView* m_pRenderTargetView = nullptr;
 
 		bool m_IsInitialized;
 
@@ -64,20 +99,71 @@ namespace Elite
 
 		std::vector<float> m_DepthBuffer;
 		bool m_DepthRendering = false;
+
+		//Per pixel the index of the visible triangle in m_Triangles + 1, 0 means nothing was drawn
+		std::vector<uint32_t> m_VisibilityBuffer;
+		bool m_VisibilityBufferRendering = false;
+
+		//Per pixel the amount of times it passed the depth test, shown as a heat map
+		std::vector<uint32_t> m_OverdrawBuffer;
+		bool m_OverdrawRendering = false;
+
+		//Tiled Rasterizer
+		static const uint32_t m_TileSize = 64;
+		static const uint32_t m_BlockSize = 8;
+		uint32_t m_NrOfTilesX = 0;
+		uint32_t m_NrOfTilesY = 0;
+		bool m_MultiThreading = true;
+		bool m_QuantizedVertices = false; //Transform the QuantizedVertex copy of the meshes that have one
+		bool m_HiZ = true; //Reject triangles and blocks behind the Hi-Z, the block bounds are kept up to date either way
+		RasterizationMode m_RasterizationMode = RasterizationMode::SIMD;
+		std::unique_ptr<ThreadPool> m_pThreadPool;
+
+		std::vector<Mesh*> m_RenderedMeshes;
+		std::vector<std::vector<OutputVertex>> m_TransformedVertices;
+		std::vector<std::vector<ClipVertex>> m_ClipVertices; //Clip space positions of the mesh vertices, the clipper adds its new vertices to m_TransformedVertices only
+		std::vector<BinnedTriangle> m_Triangles;
+		std::vector<TriangleAttributes> m_TriangleAttributes; //Same index as m_Triangles
+		std::vector<std::vector<uint32_t>> m_TileBins;
+
+		//Hi-Z, the farthest depth per 8x8 block and per tile. A triangle that lies behind it can't pass the depth test.
+		//A block stays at FLT_MAX until all its pixels got written, m_HiZBlockCoverage counts them and m_HiZBlockWrites
+		//holds the farthest depth written so far, which bounds every pixel once the block is covered
+		uint32_t m_NrOfBlocksX = 0;
+		std::vector<float> m_HiZBlocks;
+		std::vector<float> m_HiZBlockWrites;
+		std::vector<uint32_t> m_HiZBlockCoverage;
+		std::vector<float> m_HiZTiles;
+
+		std::vector<FrameStatistics> m_TileStatistics;
+		FrameStatistics m_FrameStatistics;
 		
 		//My Functions
 		//DirectX
 		long InitializeDirectX();
+		void InitializeRasterizer();
+		void PrintInformation();
+		void SelectLods(const std::vector<Mesh*>& meshes, const Camera* activeCamera);
 
 		//Rasterizer
+		void TransformVertices(const std::vector<Mesh*>& meshes, const Camera* activeCamera);
+		void BinTriangles();
+		void ClipTriangle(uint32_t meshIndex, int index0, int index1, int index2, uint32_t clipPlanes, BaseEffect::Culling cullMode, MeshStatistics& statistics);
+		void BinTriangle(uint32_t meshIndex, int index0, int index1, int index2, BaseEffect::Culling cullMode, MeshStatistics& statistics);
+		void RenderTile(uint32_t tileIndex, uint32_t clearPixel);
+		void UpdateHiZBlock(uint32_t blockX, uint32_t blockY, const HiZBlockWrite& blockWrite);
+		void UpdateHiZTile(uint32_t tileIndex, uint32_t tileMinX, uint32_t tileMinY, uint32_t tileMaxX, uint32_t tileMaxY);
+		bool RasterizeTriangle(const BinnedTriangle& triangle, uint32_t tileMinX, uint32_t tileMinY, uint32_t tileMaxX, uint32_t tileMaxY, FrameStatistics& statistics);
+		bool RasterizeBlock(const BinnedTriangle& triangle, uint32_t blockX, uint32_t blockY, uint32_t blockSize, BaseEffect::Culling cullMode, uint32_t minX, uint32_t minY, uint32_t maxX, uint32_t maxY, MeshStatistics& statistics, HiZBlockWrite& blockWrite);
+		bool RasterizeBlockRows(const BinnedTriangle& triangle, uint32_t blockX, uint32_t blockY, uint32_t blockSize, BaseEffect::Culling cullMode, bool testEdges, uint32_t minX, uint32_t minY, uint32_t maxX, uint32_t maxY, MeshStatistics& statistics, HiZBlockWrite& blockWrite);
+		bool RasterizeFixedPointBlock(const BinnedTriangle& triangle, uint32_t blockX, uint32_t blockY, uint32_t minX, uint32_t minY, uint32_t maxX, uint32_t maxY, MeshStatistics& statistics, HiZBlockWrite& blockWrite);
+		bool ShadePixel(const BinnedTriangle& triangle, uint32_t c, uint32_t r, MeshStatistics& statistics, HiZBlockWrite* pBlockWrite);
+		void ShadeFragment(uint32_t triangleIndex, uint32_t c, uint32_t r, MeshStatistics& statistics);
+		void ResolveVisibilityBuffer(uint32_t tileMinX, uint32_t tileMinY, uint32_t tileMaxX, uint32_t tileMaxY, FrameStatistics& statistics);
+		void ResolveOverdraw(uint32_t tileMinX, uint32_t tileMinY, uint32_t tileMaxX, uint32_t tileMaxY);
+		float GetSampleOffset() const;
+		uint32_t GetTriangleIndex(const BinnedTriangle& triangle) const;
 		bool PixelInTri(float col, float row, const Elite::FPoint4& v0, const Elite::FPoint4& v1, const Elite::FPoint4& v2, float& weight0, float& weight1, float& weight2, BaseEffect::Culling cullMode) const;
-		void CalculateDepthBuffer(float& depth, float w0, float w1, float w2, int i0, int i1, int i2, const std::vector<OutputVertex>& vertices) const;
-		void CalculateDepthInterpolated(float& depth, float w0, float w1, float w2, int i0, int i1, int i2, const std::vector<OutputVertex>& vertices) const;
-		void CalculateUV(Elite::FVector2& finalUV, float depth, float w0, float w1, float w2, int i0, int i1, int i2, const std::vector<OutputVertex>& vertices) const;
-		void CalculateNormal(Elite::FVector3& finalNormal, float depth, float w0, float w1, float w2, int i0, int i1, int i2, const std::vector<OutputVertex>& vertices) const;
-		void CalculateTangent(Elite::FVector3& finalTangent, float depth, float w0, float w1, float w2, int i0, int i1, int i2, const std::vector<OutputVertex>& vertices) const;
-		void CalculateViewDirection(Elite::FVector3& finalViewDirection, float depth, float w0, float w1, float w2, int i0, int i1, int i2, const std::vector<OutputVertex>& vertices) const;
-		void CalculateColor(Elite::RGBColor& finalColor, float depth, float w0, float w1, float w2, int i0, int i1, int i2, const std::vector<OutputVertex>& vertices) const;
 	};
 }
 
@@ -26,13 +26,13 @@ void EffectManager::PrintPixelShadingInformation()
 	switch (m_CurrentTechnique)
 	{
 	case BaseEffect::SampleMode::Point:
-		std::cout << "Point\n";
+		std::cout << "Point (Rasterizer: point, nearest mip)\n";
 		break;
 	case BaseEffect::SampleMode::Linear:
-		std::cout << "Linear\n";
+		std::cout << "Linear (Rasterizer: bilinear, nearest mip)\n";
 		break;
 	case BaseEffect::SampleMode::Anisotropic:
-		std::cout << "Anisotropic\n";
+		std::cout << "Anisotropic (Rasterizer: trilinear)\n";
 		break;
 	}
 }
@@ -6,6 +6,8 @@ FlatEffect::FlatEffect(ID3D11Device* pDevice, const std::wstring& assetFile)
 {
 	m_Type = BaseEffect::EffectType::Flat;
 	m_CullMode = Culling::None;
+	if (!m_pEffect)
+		return;
 
 	HRESULT result = m_pRasterizer->SetRasterizerState(0, m_pNoCulling);
 	if (FAILED(result))
@@ -22,6 +24,9 @@ FlatEffect::~FlatEffect()
 
 void FlatEffect::SetTransparency(bool state)
 {
+	if (!m_pEffect)
+		return;
+
 	HRESULT result;
 	if (state) {
 
@@ -45,6 +50,10 @@ void FlatEffect::SetCulling(Culling cull)
 
 void FlatEffect::SetSampler(SampleMode technique)
 {
+	m_SampleMode = technique;
+	if (!m_pEffect)
+		return;
+
 	switch (technique)
 	{
 	case BaseEffect::SampleMode::Point:
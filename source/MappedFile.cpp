@@ -0,0 +1,107 @@
+#include "pch.h"
+#include "MappedFile.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+MappedFile::MappedFile(const std::string& path)
+	: m_FileHandle{ INVALID_HANDLE_VALUE }
+	, m_MappingHandle{ nullptr }
+	, m_pData{ nullptr }
+	, m_Size{ 0 }
+	, m_IsOpen{ false }
+{
+	//Sequential scan tells the cache manager to read ahead, which is how every parser walks the file
+	m_FileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (m_FileHandle == INVALID_HANDLE_VALUE)
+		return;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_FileHandle, &size))
+		return;
+	m_Size = size_t(size.QuadPart);
+
+	//A mapping of 0 bytes can't be made
+	if (m_Size == 0) {
+
+		m_IsOpen = true;
+		return;
+	}
+
+	m_MappingHandle = CreateFileMappingA(m_FileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!m_MappingHandle)
+		return;
+
+	m_pData = static_cast<const char*>(MapViewOfFile(m_MappingHandle, FILE_MAP_READ, 0, 0, 0));
+	m_IsOpen = m_pData != nullptr;
+}
+
+MappedFile::~MappedFile()
+{
+	if (m_pData)
+		UnmapViewOfFile(m_pData);
+	if (m_MappingHandle)
+		CloseHandle(m_MappingHandle);
+	if (m_FileHandle != INVALID_HANDLE_VALUE)
+		CloseHandle(m_FileHandle);
+}
+#else
+MappedFile::MappedFile(const std::string& path)
+	: m_FileDescriptor{ -1 }
+	, m_pData{ nullptr }
+	, m_Size{ 0 }
+	, m_IsOpen{ false }
+{
+	m_FileDescriptor = open(path.c_str(), O_RDONLY);
+	if (m_FileDescriptor < 0)
+		return;
+
+	struct stat status;
+	if (fstat(m_FileDescriptor, &status) != 0)
+		return;
+	m_Size = size_t(status.st_size);
+
+	if (m_Size == 0) {
+
+		m_IsOpen = true;
+		return;
+	}
+
+	void* pData = mmap(nullptr, m_Size, PROT_READ, MAP_PRIVATE, m_FileDescriptor, 0);
+	if (pData == MAP_FAILED)
+		return;
+
+	madvise(pData, m_Size, MADV_SEQUENTIAL);
+	m_pData = static_cast<const char*>(pData);
+	m_IsOpen = true;
+}
+
+MappedFile::~MappedFile()
+{
+	if (m_pData)
+		munmap(const_cast<char*>(m_pData), m_Size);
+	if (m_FileDescriptor >= 0)
+		close(m_FileDescriptor);
+}
+#endif
+
+bool MappedFile::IsOpen() const
+{
+	return m_IsOpen;
+}
+
+const char* MappedFile::GetData() const
+{
+	return m_pData;
+}
+
+size_t MappedFile::GetSize() const
+{
+	return m_Size;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+//Read-only view of a whole file, the OS pages it in while it gets read instead of copying it into a buffer first
+class MappedFile final
+{
+public:
+	MappedFile(const std::string& path);
+	~MappedFile();
+	MappedFile(const MappedFile& other) = delete;
+	MappedFile& operator=(const MappedFile& other) = delete;
+	MappedFile(MappedFile&& other) = delete;
+	MappedFile& operator=(MappedFile&& other) = delete;
+
+	//An empty file is open but has no data
+	bool IsOpen() const;
+	const char* GetData() const;
+	size_t GetSize() const;
+private:
+#ifdef _WIN32
+	void* m_FileHandle;
+	void* m_MappingHandle;
+#else
+	int m_FileDescriptor;
+#endif
+	const char* m_pData;
+	size_t m_Size;
+	bool m_IsOpen;
+};
@@ -14,6 +14,8 @@ MaterialEffect::MaterialEffect(ID3D11Device* pDevice, const std::wstring& assetF
 	, m_pGlossinessMapVariable{ }
 {
 	m_Type = BaseEffect::EffectType::Material;
+	if (!m_pEffect)
+		return;
 
 	//Constants
 	m_pFloatPIVariable = m_pEffect->GetVariableByName("gPI")->AsScalar();
@@ -112,6 +114,9 @@ void MaterialEffect::SetTransparency(bool state)
 void MaterialEffect::SetCulling(Culling cull)
 {
 	m_CullMode = cull;
+	if (!m_pEffect)
+		return;
+
 	HRESULT result;
 	switch (m_CullMode)
 	{
@@ -137,6 +142,10 @@ void MaterialEffect::SetCulling(Culling cull)
 
 void MaterialEffect::SetSampler(SampleMode technique)
 {
+	m_SampleMode = technique;
+	if (!m_pEffect)
+		return;
+
 	switch (technique)
 	{
 	case BaseEffect::SampleMode::Point:
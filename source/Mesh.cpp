@@ -1,25 +1,47 @@
 #include "pch.h"
 #include "Mesh.h"
+#include "MeshData.h"
 #include "Structs.h"
 #include "SceneGraph.h"
+#include "AssetCache.h"
 
-Mesh::Mesh(bool rotating, const Elite::FVector3& displacement, const std::string& texturePath, const std::string& normalMapPath, const std::string& specularMapPath, const std::string& glossinessMapPath, ID3D11Device* pDevice, const std::vector<InputVertex>& vertices, const std::vector<uint32_t>& indices, BaseEffect* effect, PrimitiveToplogy PrimitiveToplogy)
+Mesh::Assets Mesh::LoadAssets(const std::string& objPath, const std::string& texturePath, const std::string& normalMapPath, const std::string& specularMapPath, const std::string& glossinessMapPath, ID3D11Device* pDevice)
+{
+	//The rasterizer reads the lighting maps from the packed material texture, DirectX from the separate ones
+	AssetCache* pAssetCache = AssetCache::GetInstance();
+	Assets assets{};
+	if (!objPath.empty())
+		assets.Geometry = pAssetCache->LoadMeshData(objPath);
+	assets.DiffuseMap = pAssetCache->LoadTexture(texturePath, pDevice);
+	assets.Material = pAssetCache->LoadMaterialMaps(normalMapPath, specularMapPath, glossinessMapPath, pDevice);
+	return assets;
+}
+
+Mesh::Mesh(bool rotating, const Elite::FVector3& displacement, const Assets& assets, ID3D11Device* pDevice, BaseEffect* effect, PrimitiveToplogy PrimitiveToplogy)
 	: m_Rotating{ rotating }
 	, m_WorldMatrix{ Elite::MakeTranslation(displacement) }
-	, m_Texture{ texturePath, pDevice }
-	, m_NormalMap{ normalMapPath, pDevice }
-	, m_SpecularMap{ specularMapPath, pDevice }
-	, m_GlossinessMap{ glossinessMapPath, pDevice }
+	, m_pTexture{ assets.DiffuseMap.Get() }
+	, m_pNormalMap{ assets.Material.Get(), assets.Material.Get()->NormalMap.get() }
+	, m_pSpecularMap{ assets.Material.Get(), assets.Material.Get()->SpecularMap.get() }
+	, m_pGlossinessMap{ assets.Material.Get(), assets.Material.Get()->GlossinessMap.get() }
+	, m_pMaterialMap{ assets.Material.Get(), assets.Material.Get()->MaterialMap.get() }
 	, m_Device{ pDevice }
 	, m_pVertexBuffer{ }
 	, m_pIndexBuffer{ }
 	, m_pEffect{ effect }
 	, m_pVertexLayout{ }
 	, m_AmountIndices{ }
-	, m_VertexBuffer{ vertices }
-	, m_IndexBuffer{ indices }
+	, m_pMeshData{ assets.Geometry.Get() }
 	, m_PrimitiveToplogy{ PrimitiveToplogy }
+	, m_Lod{ 0 }
+	, m_pIndices{ m_pMeshData->GetIndices() }
+	, m_NrOfIndices{ m_pMeshData->GetNrOfIndices() }
+	, m_NrOfVertices{ m_pMeshData->GetNrOfVertices() }
 {
+	//Headless (no device), only the software rasterizer uses this mesh
+	if (!pDevice)
+		return;
+
 	//Create Vertex Layout
 	HRESULT result = S_OK;
 	static const uint32_t numElements{ 5 };
@@ -77,10 +99,12 @@ Mesh::Mesh(bool rotating, const Elite::FVector3& displacement, const std::string
 	if (FAILED(result))
 		return;
 
-	//Create index buffer
-	m_AmountIndices = (int32_t)indices.size();
+	//Create index buffer, the full mesh followed by its levels of detail
+	m_AmountIndices = m_pMeshData->GetNrOfIndices();
+	std::vector<uint32_t> indices{ m_pMeshData->GetIndices(), m_pMeshData->GetIndices() + m_AmountIndices };
+	indices.insert(indices.end(), m_pMeshData->GetLodIndices(), m_pMeshData->GetLodIndices() + m_pMeshData->GetNrOfLodIndices());
 	bd.Usage = D3D11_USAGE_IMMUTABLE;
-	bd.ByteWidth = sizeof(int32_t) * m_AmountIndices;
+	bd.ByteWidth = sizeof(int32_t) * (uint32_t)indices.size();
 	bd.BindFlags = D3D11_BIND_INDEX_BUFFER;
 	bd.CPUAccessFlags = 0;
 	bd.MiscFlags = 0;
@@ -121,6 +145,66 @@ void Mesh::Rotate(float angle, const Elite::FVector3& axis, RenderMode mode, flo
 	m_WorldMatrix *= Elite::FMatrix4(rotationMatrix);
 }
 
+uint32_t Mesh::GetNrOfLods() const
+{
+	return m_PrimitiveToplogy == PrimitiveToplogy::TriangleList ? m_pMeshData->GetNrOfLods() + 1 : 1;
+}
+
+uint32_t Mesh::GetLod() const
+{
+	return m_Lod;
+}
+
+void Mesh::SetLod(uint32_t lod)
+{
+	m_Lod = std::min(lod, GetNrOfLods() - 1);
+	if (m_Lod == 0) {
+
+		m_pIndices = m_pMeshData->GetIndices();
+		m_NrOfIndices = m_pMeshData->GetNrOfIndices();
+		m_NrOfVertices = m_pMeshData->GetNrOfVertices();
+		return;
+	}
+
+	const MeshLod& lodData = m_pMeshData->GetLods()[m_Lod - 1];
+	m_pIndices = m_pMeshData->GetLodIndices() + lodData.FirstIndex;
+	m_NrOfIndices = lodData.NrOfIndices;
+	m_NrOfVertices = lodData.NrOfVertices;
+}
+
+//The error of a level shrinks with the distance to the bounding sphere of the mesh, inside of it the full mesh is used.
+//DirectX gets the vertices with a flipped z (GetDirectXReadyVertices), so does the center of the bounds
+uint32_t Mesh::SelectLod(const Elite::FPoint3& cameraLocation, float pixelsPerUnit, float errorThreshold, RenderMode mode)
+{
+	const Elite::FPoint3 boundsMin = m_pMeshData->GetBoundsMin();
+	const Elite::FPoint3 boundsMax = m_pMeshData->GetBoundsMax();
+	const Elite::FPoint3 center{ (boundsMin.x + boundsMax.x) * 0.5f, (boundsMin.y + boundsMax.y) * 0.5f, (boundsMin.z + boundsMax.z) * 0.5f * (mode == RenderMode::DirectX ? -1.f : 1.f) };
+	const Elite::FPoint4 worldCenter = m_WorldMatrix * Elite::FPoint4{ center.x, center.y, center.z, 1.f };
+
+	//Largest scale of the world matrix, for the errors and the radius
+	float scale = 0.f;
+	for (uint8_t column = 0; column < 3; ++column)
+		scale = std::max(scale, Elite::Magnitude(Elite::FVector3{ m_WorldMatrix(0, column), m_WorldMatrix(1, column), m_WorldMatrix(2, column) }));
+	const float radius = Elite::Magnitude(boundsMax - boundsMin) * 0.5f * scale;
+	const float distance = Elite::Magnitude(Elite::FPoint3{ worldCenter.x, worldCenter.y, worldCenter.z } - cameraLocation) - radius;
+
+	uint32_t lod = 0;
+	if (distance > 0.f) {
+
+		const float errorToPixels = scale * pixelsPerUnit / distance;
+		while (lod + 1 < GetNrOfLods() && m_pMeshData->GetLods()[lod].Error * errorToPixels <= errorThreshold)
+			++lod;
+	}
+	SetLod(lod);
+	return m_Lod;
+}
+
+//Triangles of the full mesh the current level of detail doesn't draw
+uint32_t Mesh::GetNrOfTrianglesSaved() const
+{
+	return (m_pMeshData->GetNrOfIndices() - m_NrOfIndices) / 3;
+}
+
 void Mesh::Render(ID3D11DeviceContext* pDeviceContext)
 {
 	UINT stride = sizeof(InputVertex);
@@ -141,7 +225,7 @@ void Mesh::Render(ID3D11DeviceContext* pDeviceContext)
 	for (UINT p = 0; p < techDesc.Passes; ++p) {
 
 		m_pEffect->GetTechnique()->GetPassByIndex(p)->Apply(0, pDeviceContext);
-		pDeviceContext->DrawIndexed(m_AmountIndices, 0, 0);
+		pDeviceContext->DrawIndexed(m_NrOfIndices, m_Lod == 0 ? 0 : m_AmountIndices + m_pMeshData->GetLods()[m_Lod - 1].FirstIndex, 0);
 	}
 }
 
@@ -152,22 +236,22 @@ const Elite::FMatrix4& Mesh::GetWorldMatrix() const
 
 const Texture& Mesh::GetTexture() const
 {
-	return m_Texture;
+	return *m_pTexture;
 }
 
 const Texture& Mesh::GetNormalMap() const
 {
-	return m_NormalMap;
+	return *m_pNormalMap;
 }
 
 const Texture& Mesh::GetSpecularMap() const
 {
-	return m_SpecularMap;
+	return *m_pSpecularMap;
 }
 
 const Texture& Mesh::GetGlossinessMap() const
 {
-	return m_GlossinessMap;
+	return *m_pGlossinessMap;
 }
 
 BaseEffect* Mesh::GetEffect() const
@@ -180,9 +264,35 @@ BaseEffect::Culling Mesh::GetCullMode() const
 	return m_pEffect->GetCullMode();
 }
 
-const std::vector<InputVertex>& Mesh::GetVertices() const
+const Texture& Mesh::GetMaterialMap() const
+{
+	return *m_pMaterialMap;
+}
+
+const InputVertex* Mesh::GetVertices() const
+{
+	return m_pMeshData->GetVertices();
+}
+
+uint32_t Mesh::GetNrOfVertices() const
+{
+	return m_NrOfVertices;
+}
+
+//nullptr when the mesh data has no quantized copy
+const QuantizedVertex* Mesh::GetQuantizedVertices() const
 {
-	return m_VertexBuffer;
+	return m_pMeshData->GetQuantizedVertices();
+}
+
+const Elite::FPoint3& Mesh::GetQuantizationOffset() const
+{
+	return m_pMeshData->GetBoundsMin();
+}
+
+const Elite::FVector3& Mesh::GetQuantizationScale() const
+{
+	return m_pMeshData->GetQuantizationScale();
 }
 
 const Mesh::PrimitiveToplogy Mesh::GetPrimitveTopology() const
@@ -193,7 +303,7 @@ const Mesh::PrimitiveToplogy Mesh::GetPrimitveTopology() const
 //Return the amount of times we need to loop to get all triangles
 const int Mesh::GetNrOfTriangles() const
 {
-	return (int)m_IndexBuffer.size() - 2;
+	return (int)m_NrOfIndices - 2;
 }
 
 const float Mesh::GetLightIntensity() const
@@ -214,44 +324,42 @@ void Mesh::GetTriangleIndices(int tIndex, int& i1, int& i2, int& i3) const
 	switch (m_PrimitiveToplogy)
 	{
 	case Mesh::PrimitiveToplogy::TriangleList:
-		i1 = m_IndexBuffer[tIndex];
-		i2 = m_IndexBuffer[tIndex + 1];
-		i3 = m_IndexBuffer[tIndex + 2];
+		i1 = m_pIndices[tIndex];
+		i2 = m_pIndices[tIndex + 1];
+		i3 = m_pIndices[tIndex + 2];
 		break;
 	case Mesh::PrimitiveToplogy::TriangleStrip:
 		//Check order of indices
-		i1 = m_IndexBuffer[tIndex];
-		i2 = m_IndexBuffer[tIndex + ((tIndex % 2) + 1)];
-		i3 = m_IndexBuffer[tIndex + (2 - (tIndex % 2))];
+		i1 = m_pIndices[tIndex];
+		i2 = m_pIndices[tIndex + ((tIndex % 2) + 1)];
+		i3 = m_pIndices[tIndex + (2 - (tIndex % 2))];
 		break;
 	}
 }
 
-const Elite::RGBColor Mesh::SampleTexture(const Elite::FVector2& uv) const
+//The derivatives pick the mip level, the sample mode of the effect the filtering
+const Elite::RGBColor Mesh::SampleTexture(const Elite::FVector2& uv, const Elite::FVector2& dUVdx, const Elite::FVector2& dUVdy) const
 {
-	return m_Texture.Sample(uv);
+	return m_pTexture->Sample(uv, dUVdx, dUVdy, m_pEffect->GetSampleMode());
 }
 
-const Elite::RGBColor Mesh::SampleNormalMap(const Elite::FVector2& uv) const
+//Normal, specular and glossiness come from one fetch of the packed texture, normal.z is rebuilt from x and y
+const MaterialSample Mesh::SampleMaterialMap(const Elite::FVector2& uv, const Elite::FVector2& dUVdx, const Elite::FVector2& dUVdy) const
 {
-	return m_NormalMap.Sample(uv);
-}
-
-const Elite::RGBColor Mesh::SampleSpecularMap(const Elite::FVector2& uv) const
-{
-	return m_SpecularMap.Sample(uv);
-}
-
-const float Mesh::SampleGlossinessMap(const Elite::FVector2& uv) const
-{
-	return m_GlossinessMap.Sample(uv).r;
+	const Elite::FVector4 texel = m_pMaterialMap->SampleRGBA(uv, dUVdx, dUVdy, m_pEffect->GetSampleMode());
+	const float x = 2.f * texel.r - 1.f;
+	const float y = 2.f * texel.g - 1.f;
+	return MaterialSample{ Elite::FVector3{ x, y, sqrtf(std::max(1.f - x * x - y * y, 0.f)) }, texel.b, texel.a };
 }
 
 std::vector<InputVertex> Mesh::GetDirectXReadyVertices() const
 {
 	std::vector<InputVertex> flippedVertices;
+	flippedVertices.reserve(m_pMeshData->GetNrOfVertices());
+
+	for (uint32_t i = 0; i < m_pMeshData->GetNrOfVertices(); ++i) {
 
-	for (const InputVertex& currentVertex : m_VertexBuffer) {
+		const InputVertex& currentVertex = m_pMeshData->GetVertices()[i];
 
 		Elite::FPoint3 flippedPosition = { currentVertex.Position.x, currentVertex.Position.y, -currentVertex.Position.z };
 		Elite::FVector3 flippedNormal = { currentVertex.Normal.x, currentVertex.Normal.y, -currentVertex.Normal.z };
@@ -1,10 +1,15 @@
 #pragma once
+#include <memory>
 #include <vector>
+#include "AssetCache.h"
 #include "BaseEffect.h"
 #include "Texture.h"
 
 struct InputVertex;
+struct QuantizedVertex;
+class MeshData;
 struct OutputVertex;
+struct MaterialSample;
 enum class RenderMode;
 class Mesh final
 {
@@ -14,7 +19,17 @@ public:
 		TriangleList = 3,
 		TriangleStrip = 1
 	};
-	Mesh(bool rotating, const Elite::FVector3& displacement, const std::string& texturePath, const std::string& normalMapPath, const std::string& specularMapPath, const std::string& glossinessMapPath, ID3D11Device* pDevice, const std::vector<InputVertex>& vertices, const std::vector<uint32_t>& indices, BaseEffect* effect, PrimitiveToplogy PrimitiveToplogy = PrimitiveToplogy::TriangleList);
+	//Everything a mesh is made of, the files load on the threads of the AssetCache while the handles get passed around
+	struct Assets {
+		AssetHandle<MeshData> Geometry;
+		AssetHandle<Texture> DiffuseMap;
+		AssetHandle<MaterialMaps> Material;
+	};
+	//Starts loading every file and returns right away, empty paths stay empty. Without objPath the geometry has to be filled in.
+	static Assets LoadAssets(const std::string& objPath, const std::string& texturePath, const std::string& normalMapPath, const std::string& specularMapPath, const std::string& glossinessMapPath, ID3D11Device* pDevice);
+
+	//Waits for the assets that are still loading
+	Mesh(bool rotating, const Elite::FVector3& displacement, const Assets& assets, ID3D11Device* pDevice, BaseEffect* effect, PrimitiveToplogy PrimitiveToplogy = PrimitiveToplogy::TriangleList);
 	~Mesh();
 	Mesh(const Mesh& other) = delete;
 	Mesh& operator=(const Mesh& other) = delete;
@@ -24,6 +39,15 @@ public:
 	void Update(float deltaTime);
 	void Rotate(float angle, const Elite::FVector3& axis, RenderMode mode, float delta);
 
+	//Levels of detail of the MeshData, level 0 is the full mesh. Triangle strips only have that one.
+	//SelectLod takes the coarsest level whose error stays within errorThreshold pixels on the screen,
+	//pixelsPerUnit is the size in pixels of one unit at a distance of one unit in front of the camera
+	uint32_t GetNrOfLods() const;
+	uint32_t GetLod() const;
+	void SetLod(uint32_t lod);
+	uint32_t SelectLod(const Elite::FPoint3& cameraLocation, float pixelsPerUnit, float errorThreshold, RenderMode mode);
+	uint32_t GetNrOfTrianglesSaved() const;
+
 	//DirectX
 	void Render(ID3D11DeviceContext* pDeviceContext);
 	const Elite::FMatrix4& GetWorldMatrix() const;
@@ -35,23 +59,29 @@ public:
 
 	//Rasterizer
 	BaseEffect::Culling GetCullMode() const;
-	const std::vector<InputVertex>& GetVertices() const;
+	const Texture& GetMaterialMap() const;
+	const InputVertex* GetVertices() const;
+	//Vertices the current level of detail uses, the first ones of GetVertices()
+	uint32_t GetNrOfVertices() const;
+	const QuantizedVertex* GetQuantizedVertices() const;
+	const Elite::FPoint3& GetQuantizationOffset() const;
+	const Elite::FVector3& GetQuantizationScale() const;
 	const PrimitiveToplogy GetPrimitveTopology() const;
 	const int GetNrOfTriangles() const;
 	const float GetLightIntensity() const;
 	const float GetShininess() const;
 	void GetTriangleIndices(int tIndex, int& i1, int& i2, int& i3) const;
-	const Elite::RGBColor SampleTexture(const Elite::FVector2& uv) const;
-	const Elite::RGBColor SampleNormalMap(const Elite::FVector2& uv) const;
-	const Elite::RGBColor SampleSpecularMap(const Elite::FVector2& uv) const;
-	const float SampleGlossinessMap(const Elite::FVector2& uv) const;
+	const Elite::RGBColor SampleTexture(const Elite::FVector2& uv, const Elite::FVector2& dUVdx, const Elite::FVector2& dUVdy) const;
+	const MaterialSample SampleMaterialMap(const Elite::FVector2& uv, const Elite::FVector2& dUVdx, const Elite::FVector2& dUVdy) const;
 private:
 	bool m_Rotating;
 	Elite::FMatrix4 m_WorldMatrix;
-	Texture m_Texture;
-	Texture m_NormalMap;
-	Texture m_SpecularMap;
-	Texture m_GlossinessMap;
+	//Shared with every mesh that uses the same files (AssetCache), the lighting maps keep their whole MaterialMaps alive
+	std::shared_ptr<const Texture> m_pTexture;
+	std::shared_ptr<const Texture> m_pNormalMap;
+	std::shared_ptr<const Texture> m_pSpecularMap;
+	std::shared_ptr<const Texture> m_pGlossinessMap;
+	std::shared_ptr<const Texture> m_pMaterialMap;
 
 	//DirectX
 	ID3D11Device* m_Device; //not the meshes job to release this
@@ -60,12 +90,15 @@ private:
 
 	BaseEffect* m_pEffect; //not the meshes job to release this
 	ID3D11InputLayout* m_pVertexLayout;
-	uint32_t m_AmountIndices;
+	uint32_t m_AmountIndices; //Of the full mesh, the indices of the levels of detail come after it in the index buffer
 
 	//Rasterizer
-	std::vector<InputVertex> m_VertexBuffer;
-	std::vector<uint32_t> m_IndexBuffer;
+	std::shared_ptr<const MeshData> m_pMeshData;
 	PrimitiveToplogy m_PrimitiveToplogy;
+	uint32_t m_Lod;
+	const uint32_t* m_pIndices; //Of the current level of detail
+	uint32_t m_NrOfIndices;
+	uint32_t m_NrOfVertices;
 
 	std::vector<InputVertex> GetDirectXReadyVertices() const;
 };
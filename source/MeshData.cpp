@@ -0,0 +1,255 @@
+#include "pch.h"
+#include "MeshData.h"
+#include "VertexQuantization.h"
+
+MeshData::MeshData(std::vector<InputVertex> vertices, std::vector<uint32_t> indices, std::vector<Meshlet> meshlets)
+	: m_Vertices{ std::move(vertices) }
+	, m_QuantizedVertices{}
+	, m_Indices{ std::move(indices) }
+	, m_Meshlets{ std::move(meshlets) }
+	, m_Lods{}
+	, m_LodIndices{}
+	, m_pStorage{}
+	, m_pVertices{ m_Vertices.data() }
+	, m_pQuantizedVertices{ nullptr }
+	, m_NrOfVertices{ (uint32_t)m_Vertices.size() }
+	, m_pIndices{ m_Indices.data() }
+	, m_NrOfIndices{ (uint32_t)m_Indices.size() }
+	, m_pMeshlets{ m_Meshlets.data() }
+	, m_NrOfMeshlets{ (uint32_t)m_Meshlets.size() }
+	, m_pLods{ nullptr }
+	, m_NrOfLods{ 0 }
+	, m_pLodIndices{ nullptr }
+	, m_NrOfLodIndices{ 0 }
+	, m_BoundsMin{ 0.f, 0.f, 0.f }
+	, m_BoundsMax{ 0.f, 0.f, 0.f }
+	, m_QuantizationScale{ 0.f, 0.f, 0.f }
+{
+	if (m_Vertices.empty())
+		return;
+
+	m_BoundsMin = m_Vertices[0].Position;
+	m_BoundsMax = m_Vertices[0].Position;
+	for (const InputVertex& vertex : m_Vertices) {
+
+		m_BoundsMin = Elite::FPoint3{ std::min(m_BoundsMin.x, vertex.Position.x), std::min(m_BoundsMin.y, vertex.Position.y), std::min(m_BoundsMin.z, vertex.Position.z) };
+		m_BoundsMax = Elite::FPoint3{ std::max(m_BoundsMax.x, vertex.Position.x), std::max(m_BoundsMax.y, vertex.Position.y), std::max(m_BoundsMax.z, vertex.Position.z) };
+	}
+	m_QuantizationScale = (m_BoundsMax - m_BoundsMin) / 65535.f;
+}
+
+MeshData::MeshData(std::shared_ptr<const void> pStorage, const InputVertex* pVertices, const QuantizedVertex* pQuantizedVertices, uint32_t nrOfVertices,
+	const uint32_t* pIndices, uint32_t nrOfIndices, const Meshlet* pMeshlets, uint32_t nrOfMeshlets,
+	const MeshLod* pLods, uint32_t nrOfLods, const uint32_t* pLodIndices, uint32_t nrOfLodIndices, const Elite::FPoint3& boundsMin, const Elite::FPoint3& boundsMax)
+	: m_Vertices{}
+	, m_QuantizedVertices{}
+	, m_Indices{}
+	, m_Meshlets{}
+	, m_Lods{}
+	, m_LodIndices{}
+	, m_pStorage{ std::move(pStorage) }
+	, m_pVertices{ pVertices }
+	, m_pQuantizedVertices{ pQuantizedVertices }
+	, m_NrOfVertices{ nrOfVertices }
+	, m_pIndices{ pIndices }
+	, m_NrOfIndices{ nrOfIndices }
+	, m_pMeshlets{ pMeshlets }
+	, m_NrOfMeshlets{ nrOfMeshlets }
+	, m_pLods{ pLods }
+	, m_NrOfLods{ nrOfLods }
+	, m_pLodIndices{ pLodIndices }
+	, m_NrOfLodIndices{ nrOfLodIndices }
+	, m_BoundsMin{ boundsMin }
+	, m_BoundsMax{ boundsMax }
+	, m_QuantizationScale{ (boundsMax - boundsMin) / 65535.f }
+{
+}
+
+//Moving a vector keeps its buffer, the pointers can be taken over as they are
+MeshData::MeshData(MeshData&& other) noexcept
+	: m_Vertices{ std::move(other.m_Vertices) }
+	, m_QuantizedVertices{ std::move(other.m_QuantizedVertices) }
+	, m_Indices{ std::move(other.m_Indices) }
+	, m_Meshlets{ std::move(other.m_Meshlets) }
+	, m_Lods{ std::move(other.m_Lods) }
+	, m_LodIndices{ std::move(other.m_LodIndices) }
+	, m_pStorage{ std::move(other.m_pStorage) }
+	, m_pVertices{ other.m_pVertices }
+	, m_pQuantizedVertices{ other.m_pQuantizedVertices }
+	, m_NrOfVertices{ other.m_NrOfVertices }
+	, m_pIndices{ other.m_pIndices }
+	, m_NrOfIndices{ other.m_NrOfIndices }
+	, m_pMeshlets{ other.m_pMeshlets }
+	, m_NrOfMeshlets{ other.m_NrOfMeshlets }
+	, m_pLods{ other.m_pLods }
+	, m_NrOfLods{ other.m_NrOfLods }
+	, m_pLodIndices{ other.m_pLodIndices }
+	, m_NrOfLodIndices{ other.m_NrOfLodIndices }
+	, m_BoundsMin{ other.m_BoundsMin }
+	, m_BoundsMax{ other.m_BoundsMax }
+	, m_QuantizationScale{ other.m_QuantizationScale }
+{
+	other.Clear();
+}
+
+MeshData& MeshData::operator=(MeshData&& other) noexcept
+{
+	if (this == &other)
+		return *this;
+
+	m_Vertices = std::move(other.m_Vertices);
+	m_QuantizedVertices = std::move(other.m_QuantizedVertices);
+	m_Indices = std::move(other.m_Indices);
+	m_Meshlets = std::move(other.m_Meshlets);
+	m_Lods = std::move(other.m_Lods);
+	m_LodIndices = std::move(other.m_LodIndices);
+	m_pStorage = std::move(other.m_pStorage);
+	m_pVertices = other.m_pVertices;
+	m_pQuantizedVertices = other.m_pQuantizedVertices;
+	m_NrOfVertices = other.m_NrOfVertices;
+	m_pIndices = other.m_pIndices;
+	m_NrOfIndices = other.m_NrOfIndices;
+	m_pMeshlets = other.m_pMeshlets;
+	m_NrOfMeshlets = other.m_NrOfMeshlets;
+	m_pLods = other.m_pLods;
+	m_NrOfLods = other.m_NrOfLods;
+	m_pLodIndices = other.m_pLodIndices;
+	m_NrOfLodIndices = other.m_NrOfLodIndices;
+	m_BoundsMin = other.m_BoundsMin;
+	m_BoundsMax = other.m_BoundsMax;
+	m_QuantizationScale = other.m_QuantizationScale;
+	other.Clear();
+	return *this;
+}
+
+const InputVertex* MeshData::GetVertices() const
+{
+	return m_pVertices;
+}
+
+uint32_t MeshData::GetNrOfVertices() const
+{
+	return m_NrOfVertices;
+}
+
+const QuantizedVertex* MeshData::GetQuantizedVertices() const
+{
+	return m_pQuantizedVertices;
+}
+
+const Elite::FVector3& MeshData::GetQuantizationScale() const
+{
+	return m_QuantizationScale;
+}
+
+void MeshData::Quantize()
+{
+	m_QuantizedVertices.resize(m_NrOfVertices);
+	const Elite::FVector3 boundsExtent = m_BoundsMax - m_BoundsMin;
+	for (uint32_t i = 0; i < m_NrOfVertices; ++i)
+		m_QuantizedVertices[i] = VertexQuantization::Encode(m_pVertices[i], m_BoundsMin, boundsExtent);
+	m_pQuantizedVertices = m_QuantizedVertices.data();
+}
+
+const uint32_t* MeshData::GetIndices() const
+{
+	return m_pIndices;
+}
+
+uint32_t MeshData::GetNrOfIndices() const
+{
+	return m_NrOfIndices;
+}
+
+const Meshlet* MeshData::GetMeshlets() const
+{
+	return m_pMeshlets;
+}
+
+uint32_t MeshData::GetNrOfMeshlets() const
+{
+	return m_NrOfMeshlets;
+}
+
+const Elite::FPoint3& MeshData::GetBoundsMin() const
+{
+	return m_BoundsMin;
+}
+
+const Elite::FPoint3& MeshData::GetBoundsMax() const
+{
+	return m_BoundsMax;
+}
+
+void MeshData::SetMeshlets(std::vector<Meshlet> meshlets)
+{
+	m_Meshlets = std::move(meshlets);
+	m_pMeshlets = m_Meshlets.data();
+	m_NrOfMeshlets = (uint32_t)m_Meshlets.size();
+}
+
+const MeshLod* MeshData::GetLods() const
+{
+	return m_pLods;
+}
+
+uint32_t MeshData::GetNrOfLods() const
+{
+	return m_NrOfLods;
+}
+
+const uint32_t* MeshData::GetLodIndices() const
+{
+	return m_pLodIndices;
+}
+
+uint32_t MeshData::GetNrOfLodIndices() const
+{
+	return m_NrOfLodIndices;
+}
+
+void MeshData::SetLods(std::vector<MeshLod> lods, std::vector<uint32_t> lodIndices)
+{
+	m_Lods = std::move(lods);
+	m_LodIndices = std::move(lodIndices);
+	m_pLods = m_Lods.data();
+	m_NrOfLods = (uint32_t)m_Lods.size();
+	m_pLodIndices = m_LodIndices.data();
+	m_NrOfLodIndices = (uint32_t)m_LodIndices.size();
+}
+
+size_t MeshData::GetMemorySize() const
+{
+	return m_NrOfVertices * (sizeof(InputVertex) + (m_pQuantizedVertices ? sizeof(QuantizedVertex) : 0)) + m_NrOfIndices * sizeof(uint32_t) + m_NrOfMeshlets * sizeof(Meshlet)
+		+ m_NrOfLods * sizeof(MeshLod) + m_NrOfLodIndices * sizeof(uint32_t);
+}
+
+bool MeshData::IsMapped() const
+{
+	return m_pStorage != nullptr;
+}
+
+void MeshData::Clear()
+{
+	m_Vertices.clear();
+	m_QuantizedVertices.clear();
+	m_Indices.clear();
+	m_Meshlets.clear();
+	m_Lods.clear();
+	m_LodIndices.clear();
+	m_pStorage.reset();
+	m_pVertices = nullptr;
+	m_pQuantizedVertices = nullptr;
+	m_NrOfVertices = 0;
+	m_pIndices = nullptr;
+	m_NrOfIndices = 0;
+	m_pMeshlets = nullptr;
+	m_NrOfMeshlets = 0;
+	m_pLods = nullptr;
+	m_NrOfLods = 0;
+	m_pLodIndices = nullptr;
+	m_NrOfLodIndices = 0;
+	m_BoundsMin = Elite::FPoint3{ 0.f, 0.f, 0.f };
+	m_BoundsMax = Elite::FPoint3{ 0.f, 0.f, 0.f };
+	m_QuantizationScale = Elite::FVector3{ 0.f, 0.f, 0.f };
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <memory>
+#include <vector>
+#include "Structs.h"
+
+//Group of up to Meshlet::MaxTriangles neighbouring triangles with their bounds, cooked meshes store them for culling per group
+struct Meshlet
+{
+	static const uint32_t MaxTriangles = 128;
+
+	uint32_t FirstIndex;
+	uint32_t NrOfIndices;
+	Elite::FPoint3 BoundsMin;
+	Elite::FPoint3 BoundsMax;
+};
+
+//Simplified version of a mesh (MeshSimplifier), its indices point into the same vertices as the full mesh
+struct MeshLod
+{
+	uint32_t FirstIndex; //In the index buffer of the levels, GetLodIndices()
+	uint32_t NrOfIndices;
+	uint32_t NrOfVertices; //The level only uses the first NrOfVertices vertices
+	float Error; //Distance the simplified surface is off from the full mesh (estimate), in the units of the mesh
+};
+
+//Geometry of a mesh, shared between every Mesh that uses the same file (AssetCache).
+//The vertices and indices either belong to the MeshData (parsed or generated) or live in a mapped cooked file that it keeps open,
+//the users only ever see the pointers. Moving keeps the pointers valid, the moved from MeshData is empty.
+//The QuantizedVertex copy of the vertices is optional: parsed data gets it from Quantize(), cooked files always have it.
+//The levels of detail are optional as well, level n is GetLods()[n - 1], level 0 is the full mesh.
+class MeshData final
+{
+public:
+	MeshData(std::vector<InputVertex> vertices, std::vector<uint32_t> indices, std::vector<Meshlet> meshlets = {});
+	//pStorage keeps the memory the pointers point into alive, pQuantizedVertices can be nullptr
+	MeshData(std::shared_ptr<const void> pStorage, const InputVertex* pVertices, const QuantizedVertex* pQuantizedVertices, uint32_t nrOfVertices,
+		const uint32_t* pIndices, uint32_t nrOfIndices, const Meshlet* pMeshlets, uint32_t nrOfMeshlets,
+		const MeshLod* pLods, uint32_t nrOfLods, const uint32_t* pLodIndices, uint32_t nrOfLodIndices, const Elite::FPoint3& boundsMin, const Elite::FPoint3& boundsMax);
+	~MeshData() = default;
+	MeshData(const MeshData& other) = delete;
+	MeshData& operator=(const MeshData& other) = delete;
+	MeshData(MeshData&& other) noexcept;
+	MeshData& operator=(MeshData&& other) noexcept;
+
+	const InputVertex* GetVertices() const;
+	uint32_t GetNrOfVertices() const;
+	//nullptr without the quantized copy. The positions decode relative to GetBoundsMin() with GetQuantizationScale()
+	const QuantizedVertex* GetQuantizedVertices() const;
+	const Elite::FVector3& GetQuantizationScale() const;
+	void Quantize();
+	const uint32_t* GetIndices() const;
+	uint32_t GetNrOfIndices() const;
+	const Meshlet* GetMeshlets() const;
+	uint32_t GetNrOfMeshlets() const;
+	void SetMeshlets(std::vector<Meshlet> meshlets);
+	const MeshLod* GetLods() const;
+	uint32_t GetNrOfLods() const;
+	const uint32_t* GetLodIndices() const;
+	uint32_t GetNrOfLodIndices() const;
+	void SetLods(std::vector<MeshLod> lods, std::vector<uint32_t> lodIndices);
+	const Elite::FPoint3& GetBoundsMin() const;
+	const Elite::FPoint3& GetBoundsMax() const;
+	//Bytes of vertex (both formats), index, meshlet and level of detail data, mapped or not
+	size_t GetMemorySize() const;
+	bool IsMapped() const;
+private:
+	//Owned data, empty when the data is mapped
+	std::vector<InputVertex> m_Vertices;
+	std::vector<QuantizedVertex> m_QuantizedVertices;
+	std::vector<uint32_t> m_Indices;
+	std::vector<Meshlet> m_Meshlets;
+	std::vector<MeshLod> m_Lods;
+	std::vector<uint32_t> m_LodIndices;
+	std::shared_ptr<const void> m_pStorage;
+
+	const InputVertex* m_pVertices;
+	const QuantizedVertex* m_pQuantizedVertices;
+	uint32_t m_NrOfVertices;
+	const uint32_t* m_pIndices;
+	uint32_t m_NrOfIndices;
+	const Meshlet* m_pMeshlets;
+	uint32_t m_NrOfMeshlets;
+	const MeshLod* m_pLods;
+	uint32_t m_NrOfLods;
+	const uint32_t* m_pLodIndices;
+	uint32_t m_NrOfLodIndices;
+	Elite::FPoint3 m_BoundsMin;
+	Elite::FPoint3 m_BoundsMax;
+	Elite::FVector3 m_QuantizationScale;
+
+	void Clear();
+};
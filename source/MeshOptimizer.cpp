@@ -0,0 +1,335 @@
+#include "pch.h"
+#include "MeshOptimizer.h"
+#include "MeshData.h"
+#include <numeric>
+
+namespace
+{
+	//Triangles around every vertex, the ones of vertex v are Triangles[Offsets[v]] up to Triangles[Offsets[v + 1]]
+	struct Adjacency
+	{
+		std::vector<uint32_t> Offsets;
+		std::vector<uint32_t> Triangles;
+	};
+
+	Adjacency BuildAdjacency(const uint32_t* pIndices, uint32_t nrOfIndices, uint32_t nrOfVertices)
+	{
+		Adjacency adjacency{ std::vector<uint32_t>(nrOfVertices + 1, 0), std::vector<uint32_t>(nrOfIndices) };
+		for (uint32_t i = 0; i < nrOfIndices; ++i)
+			++adjacency.Offsets[pIndices[i] + 1];
+		std::partial_sum(adjacency.Offsets.begin(), adjacency.Offsets.end(), adjacency.Offsets.begin());
+
+		std::vector<uint32_t> next{ adjacency.Offsets.begin(), adjacency.Offsets.end() - 1 };
+		for (uint32_t i = 0; i < nrOfIndices; ++i)
+			adjacency.Triangles[next[pIndices[i]]++] = i / 3;
+		return adjacency;
+	}
+
+	//A vertex is in the FIFO cache when it was one of the last CacheSize vertices that went in, cacheTime holds when that was
+	inline bool CacheMiss(uint32_t vertex, std::vector<uint32_t>& cacheTime, uint32_t& time)
+	{
+		if (time - cacheTime[vertex] <= MeshOptimizer::CacheSize)
+			return false;
+
+		cacheTime[vertex] = time++;
+		return true;
+	}
+
+	uint32_t CountCacheMisses(const uint32_t* pIndices, uint32_t nrOfIndices, uint32_t nrOfVertices)
+	{
+		std::vector<uint32_t> cacheTime(nrOfVertices, 0);
+		uint32_t time = MeshOptimizer::CacheSize + 1;
+		uint32_t misses = 0;
+		for (uint32_t i = 0; i < nrOfIndices; ++i)
+			misses += CacheMiss(pIndices[i], cacheTime, time);
+		return misses;
+	}
+
+	//Emits every triangle around the current vertex, then moves on to the vertex of those triangles that stays in the cache
+	//the longest while its remaining triangles get emitted. At a dead end it takes the last vertex that still has triangles,
+	//or the next one in the input order; the triangles from there on start a new cluster in clusterStarts
+	std::vector<uint32_t> Tipsify(const uint32_t* pIndices, uint32_t nrOfIndices, uint32_t nrOfVertices, std::vector<uint32_t>& clusterStarts)
+	{
+		const Adjacency adjacency = BuildAdjacency(pIndices, nrOfIndices, nrOfVertices);
+		std::vector<uint32_t> liveTriangles(nrOfVertices);
+		for (uint32_t vertex = 0; vertex < nrOfVertices; ++vertex)
+			liveTriangles[vertex] = adjacency.Offsets[vertex + 1] - adjacency.Offsets[vertex];
+
+		std::vector<uint32_t> cacheTime(nrOfVertices, 0);
+		std::vector<bool> emitted(nrOfIndices / 3, false);
+		std::vector<uint32_t> deadEnd;
+		std::vector<uint32_t> candidates;
+		std::vector<uint32_t> indices;
+		deadEnd.reserve(nrOfIndices);
+		indices.reserve(nrOfIndices);
+		uint32_t time = MeshOptimizer::CacheSize + 1;
+		uint32_t cursor = 0;
+
+		int current = -1;
+		for (; cursor < nrOfVertices && current < 0; ++cursor)
+			current = liveTriangles[cursor] > 0 ? int(cursor) : -1;
+		if (current >= 0)
+			clusterStarts.push_back(0);
+
+		while (current >= 0) {
+
+			candidates.clear();
+			for (uint32_t i = adjacency.Offsets[current]; i < adjacency.Offsets[current + 1]; ++i) {
+
+				const uint32_t triangle = adjacency.Triangles[i];
+				if (emitted[triangle])
+					continue;
+
+				emitted[triangle] = true;
+				for (uint32_t corner = 0; corner < 3; ++corner) {
+
+					const uint32_t vertex = pIndices[triangle * 3 + corner];
+					indices.push_back(vertex);
+					deadEnd.push_back(vertex);
+					candidates.push_back(vertex);
+					--liveTriangles[vertex];
+					CacheMiss(vertex, cacheTime, time);
+				}
+			}
+
+			int next = -1;
+			int bestPriority = -1;
+			for (uint32_t vertex : candidates) {
+
+				if (liveTriangles[vertex] == 0)
+					continue;
+
+				//Vertices that would drop out of the cache before their fan is done get priority 0
+				const uint32_t age = time - cacheTime[vertex];
+				const int priority = age + 2 * liveTriangles[vertex] <= MeshOptimizer::CacheSize ? int(age) : 0;
+				if (priority > bestPriority) {
+
+					bestPriority = priority;
+					next = int(vertex);
+				}
+			}
+
+			if (next < 0) {
+
+				while (!deadEnd.empty() && next < 0) {
+
+					next = liveTriangles[deadEnd.back()] > 0 ? int(deadEnd.back()) : -1;
+					deadEnd.pop_back();
+				}
+				for (; cursor < nrOfVertices && next < 0; ++cursor)
+					next = liveTriangles[cursor] > 0 ? int(cursor) : -1;
+				if (next >= 0)
+					clusterStarts.push_back(uint32_t(indices.size() / 3));
+			}
+			current = next;
+		}
+		return indices;
+	}
+
+	//Cuts the clusters in smaller ones wherever the cache misses of the cluster so far (drawn after a cache flush)
+	//are at most threshold times the cache miss ratio of the whole mesh
+	std::vector<uint32_t> SplitClusters(const std::vector<uint32_t>& indices, uint32_t nrOfVertices, const std::vector<uint32_t>& hardStarts, float threshold)
+	{
+		const uint32_t nrOfTriangles = uint32_t(indices.size() / 3);
+		const float meshACMR = float(CountCacheMisses(indices.data(), uint32_t(indices.size()), nrOfVertices)) / nrOfTriangles;
+
+		std::vector<uint32_t> clusterStarts;
+		std::vector<uint32_t> cacheTime(nrOfVertices, 0);
+		uint32_t time = MeshOptimizer::CacheSize + 1;
+		for (size_t cluster = 0; cluster < hardStarts.size(); ++cluster) {
+
+			const uint32_t end = cluster + 1 < hardStarts.size() ? hardStarts[cluster + 1] : nrOfTriangles;
+			uint32_t start = hardStarts[cluster];
+			uint32_t misses = 0;
+			clusterStarts.push_back(start);
+			time += MeshOptimizer::CacheSize + 1;
+			for (uint32_t triangle = start; triangle < end; ++triangle) {
+
+				for (uint32_t corner = 0; corner < 3; ++corner)
+					misses += CacheMiss(indices[triangle * 3 + corner], cacheTime, time);
+
+				if (triangle + 1 < end && float(misses) <= threshold * meshACMR * float(triangle + 1 - start)) {
+
+					start = triangle + 1;
+					misses = 0;
+					clusterStarts.push_back(start);
+					time += MeshOptimizer::CacheSize + 1;
+				}
+			}
+		}
+		return clusterStarts;
+	}
+
+	//Clusters on the outside that face away from the center hide the ones behind them from most directions, they go first.
+	//The vertex normals are used instead of the winding, that works for both handednesses
+	std::vector<uint32_t> SortClusters(const std::vector<uint32_t>& indices, const InputVertex* pVertices, const std::vector<uint32_t>& clusterStarts)
+	{
+		const uint32_t nrOfTriangles = uint32_t(indices.size() / 3);
+		std::vector<Elite::FVector3> centroids(clusterStarts.size());
+		std::vector<Elite::FVector3> normals(clusterStarts.size());
+		Elite::FVector3 meshCentroid{ 0.f, 0.f, 0.f };
+		float meshArea = 0.f;
+		for (size_t cluster = 0; cluster < clusterStarts.size(); ++cluster) {
+
+			const uint32_t end = cluster + 1 < clusterStarts.size() ? clusterStarts[cluster + 1] : nrOfTriangles;
+			Elite::FVector3 centroid{ 0.f, 0.f, 0.f };
+			Elite::FVector3 normal{ 0.f, 0.f, 0.f };
+			float area = 0.f;
+			for (uint32_t triangle = clusterStarts[cluster]; triangle < end; ++triangle) {
+
+				const InputVertex& v0 = pVertices[indices[triangle * 3]];
+				const InputVertex& v1 = pVertices[indices[triangle * 3 + 1]];
+				const InputVertex& v2 = pVertices[indices[triangle * 3 + 2]];
+				const float triangleArea = Elite::Magnitude(Elite::Cross(v1.Position - v0.Position, v2.Position - v0.Position)) * 0.5f;
+				const Elite::FVector3 triangleCentroid = (Elite::FVector3{ v0.Position } + Elite::FVector3{ v1.Position } + Elite::FVector3{ v2.Position }) / 3.f;
+				centroid += triangleCentroid * triangleArea;
+				normal += (v0.Normal + v1.Normal + v2.Normal) * triangleArea;
+				area += triangleArea;
+			}
+
+			meshCentroid += centroid;
+			meshArea += area;
+			centroids[cluster] = area > 0.f ? centroid / area : centroid;
+			normals[cluster] = Elite::Magnitude(normal) > 0.f ? Elite::GetNormalized(normal) : normal;
+		}
+		if (meshArea > 0.f)
+			meshCentroid /= meshArea;
+
+		std::vector<float> sortKeys(clusterStarts.size());
+		for (size_t cluster = 0; cluster < clusterStarts.size(); ++cluster)
+			sortKeys[cluster] = Elite::Dot(centroids[cluster] - meshCentroid, normals[cluster]);
+
+		std::vector<uint32_t> order(clusterStarts.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&sortKeys](uint32_t left, uint32_t right) {
+			return sortKeys[left] > sortKeys[right];
+			});
+
+		std::vector<uint32_t> sortedIndices;
+		sortedIndices.reserve(indices.size());
+		for (uint32_t cluster : order) {
+
+			const uint32_t end = cluster + 1 < clusterStarts.size() ? clusterStarts[cluster + 1] : nrOfTriangles;
+			sortedIndices.insert(sortedIndices.end(), indices.begin() + clusterStarts[cluster] * 3, indices.begin() + end * 3);
+		}
+		return sortedIndices;
+	}
+
+	//Rasterizes the triangles in order with a depth test on a grid around the bounds, for both directions of every axis.
+	//Nothing gets culled, the back faces count as well
+	float MeasureOverdraw(const MeshData& meshData)
+	{
+		const int gridSize = 256;
+		const InputVertex* pVertices = meshData.GetVertices();
+		const uint32_t* pIndices = meshData.GetIndices();
+		const Elite::FPoint3& boundsMin = meshData.GetBoundsMin();
+		const Elite::FVector3 extent = meshData.GetBoundsMax() - boundsMin;
+
+		std::vector<float> depthBuffer(gridSize * gridSize);
+		uint64_t passed = 0;
+		uint64_t covered = 0;
+		for (int axis = 0; axis < 3; ++axis) {
+
+			const int u = (axis + 1) % 3;
+			const int v = (axis + 2) % 3;
+			const float scale = float(gridSize) / std::max(std::max(extent.data[u], extent.data[v]), 1e-6f);
+			for (float direction : { 1.f, -1.f }) {
+
+				std::fill(depthBuffer.begin(), depthBuffer.end(), FLT_MAX);
+				for (uint32_t i = 0; i + 2 < meshData.GetNrOfIndices(); i += 3) {
+
+					Elite::FPoint3 corners[3];
+					for (int corner = 0; corner < 3; ++corner) {
+
+						const Elite::FPoint3& position = pVertices[pIndices[i + corner]].Position;
+						corners[corner] = Elite::FPoint3{ (position.data[u] - boundsMin.data[u]) * scale, (position.data[v] - boundsMin.data[v]) * scale, direction * position.data[axis] };
+					}
+
+					const float area = (corners[1].x - corners[0].x) * (corners[2].y - corners[0].y) - (corners[1].y - corners[0].y) * (corners[2].x - corners[0].x);
+					if (std::abs(area) < 1e-8f)
+						continue;
+
+					const int minX = std::max(int(std::min({ corners[0].x, corners[1].x, corners[2].x })), 0);
+					const int maxX = std::min(int(std::max({ corners[0].x, corners[1].x, corners[2].x })), gridSize - 1);
+					const int minY = std::max(int(std::min({ corners[0].y, corners[1].y, corners[2].y })), 0);
+					const int maxY = std::min(int(std::max({ corners[0].y, corners[1].y, corners[2].y })), gridSize - 1);
+					for (int y = minY; y <= maxY; ++y) {
+						for (int x = minX; x <= maxX; ++x) {
+
+							const float px = x + 0.5f;
+							const float py = y + 0.5f;
+							const float w0 = ((corners[2].x - corners[1].x) * (py - corners[1].y) - (corners[2].y - corners[1].y) * (px - corners[1].x)) / area;
+							const float w1 = ((corners[0].x - corners[2].x) * (py - corners[2].y) - (corners[0].y - corners[2].y) * (px - corners[2].x)) / area;
+							const float w2 = 1.f - w0 - w1;
+							if (w0 < 0.f || w1 < 0.f || w2 < 0.f)
+								continue;
+
+							const float depth = w0 * corners[0].z + w1 * corners[1].z + w2 * corners[2].z;
+							float& storedDepth = depthBuffer[x + y * gridSize];
+							if (depth < storedDepth) {
+
+								storedDepth = depth;
+								++passed;
+							}
+						}
+					}
+				}
+
+				for (float depth : depthBuffer)
+					covered += depth != FLT_MAX;
+			}
+		}
+		return covered > 0 ? float(double(passed) / double(covered)) : 0.f;
+	}
+}
+
+MeshOptimizer::Statistics MeshOptimizer::Analyze(const MeshData& meshData)
+{
+	const uint32_t nrOfTriangles = meshData.GetNrOfIndices() / 3;
+	std::vector<bool> used(meshData.GetNrOfVertices(), false);
+	uint32_t nrOfUsedVertices = 0;
+	for (uint32_t i = 0; i < nrOfTriangles * 3; ++i) {
+
+		nrOfUsedVertices += !used[meshData.GetIndices()[i]];
+		used[meshData.GetIndices()[i]] = true;
+	}
+
+	const uint32_t misses = CountCacheMisses(meshData.GetIndices(), nrOfTriangles * 3, meshData.GetNrOfVertices());
+	return Statistics{
+		nrOfTriangles > 0 ? float(misses) / nrOfTriangles : 0.f,
+		nrOfUsedVertices > 0 ? float(misses) / nrOfUsedVertices : 0.f,
+		MeasureOverdraw(meshData) };
+}
+
+MeshData MeshOptimizer::Optimize(const MeshData& meshData, float overdrawThreshold)
+{
+	const uint32_t nrOfVertices = meshData.GetNrOfVertices();
+	const uint32_t nrOfIndices = meshData.GetNrOfIndices() / 3 * 3;
+	if (nrOfIndices == 0)
+		return MeshData{ std::vector<InputVertex>{ meshData.GetVertices(), meshData.GetVertices() + nrOfVertices }, std::vector<uint32_t>{} };
+
+	std::vector<uint32_t> hardStarts;
+	std::vector<uint32_t> indices = Tipsify(meshData.GetIndices(), nrOfIndices, nrOfVertices, hardStarts);
+	indices = SortClusters(indices, meshData.GetVertices(), SplitClusters(indices, nrOfVertices, hardStarts, overdrawThreshold));
+
+	//Vertex fetch order
+	std::vector<uint32_t> remap(nrOfVertices, UINT32_MAX);
+	std::vector<InputVertex> vertices;
+	vertices.reserve(nrOfVertices);
+	for (uint32_t& index : indices) {
+
+		if (remap[index] == UINT32_MAX) {
+
+			remap[index] = uint32_t(vertices.size());
+			vertices.push_back(meshData.GetVertices()[index]);
+		}
+		index = remap[index];
+	}
+	return MeshData{ std::move(vertices), std::move(indices) };
+}
+
+std::vector<uint32_t> MeshOptimizer::OptimizeVertexCache(const uint32_t* pIndices, uint32_t nrOfIndices, uint32_t nrOfVertices)
+{
+	std::vector<uint32_t> clusterStarts;
+	return Tipsify(pIndices, nrOfIndices / 3 * 3, nrOfVertices, clusterStarts);
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+class MeshData;
+
+//Reorders triangle lists for the hardware and the rasterizer, the triangles and vertices stay the same.
+//1. Vertex cache order (Tipsify, Sander et al. 2007) for a post-transform cache of CacheSize vertices
+//2. Overdraw order: the order gets cut in clusters that keep most of the cache efficiency, the clusters that face outwards are drawn first
+//3. Vertex fetch order: the vertices get renumbered in the order the indices first use them, unused vertices are dropped
+namespace MeshOptimizer
+{
+	const uint32_t CacheSize = 16;
+
+	struct Statistics {
+		float ACMR; //Average cache miss ratio, transformed vertices per triangle (0.5 is the best a big grid can do, 3 the worst)
+		float ATVR; //Average transform to vertex ratio, transformed vertices per vertex (1 is the best)
+		float Overdraw; //Depth test passes per covered pixel, averaged over 6 orthographic views along the axes
+	};
+
+	//FIFO cache of CacheSize vertices
+	Statistics Analyze(const MeshData& meshData);
+
+	//A cluster can be cut off once its own cache miss ratio is at most overdrawThreshold times the one of the whole mesh,
+	//higher values make smaller clusters: less overdraw, more cache misses
+	MeshData Optimize(const MeshData& meshData, float overdrawThreshold = 1.05f);
+
+	//Only the vertex cache order, for index buffers that share their vertices with other ones (levels of detail)
+	std::vector<uint32_t> OptimizeVertexCache(const uint32_t* pIndices, uint32_t nrOfIndices, uint32_t nrOfVertices);
+}
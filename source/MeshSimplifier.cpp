@@ -0,0 +1,375 @@
+#include "pch.h"
+#include "MeshSimplifier.h"
+#include "MeshData.h"
+#include "MeshOptimizer.h"
+#include <numeric>
+
+namespace
+{
+	//Sum of the squared distances to a set of planes, every plane weighted by the area of the triangle it came from.
+	//The symmetric 4x4 matrix is stored as its upper triangle: A (3x3), b and c, the distance of p is p.A.p + 2 b.p + c
+	struct Quadric
+	{
+		double A00, A01, A02, A11, A12, A22;
+		double B0, B1, B2;
+		double C;
+		double Weight;
+
+		Quadric& operator+=(const Quadric& rhs) {
+			A00 += rhs.A00; A01 += rhs.A01; A02 += rhs.A02; A11 += rhs.A11; A12 += rhs.A12; A22 += rhs.A22;
+			B0 += rhs.B0; B1 += rhs.B1; B2 += rhs.B2;
+			C += rhs.C;
+			Weight += rhs.Weight;
+			return *this;
+		}
+	};
+
+	Quadric MakePlaneQuadric(const Elite::FPoint3& p0, const Elite::FPoint3& p1, const Elite::FPoint3& p2)
+	{
+		const Elite::FVector3 cross = Elite::Cross(p1 - p0, p2 - p0);
+		const double length = Elite::Magnitude(cross);
+		if (!(length > 0.0))
+			return Quadric{};
+
+		const double area = length * 0.5;
+		const double x = cross.x / length, y = cross.y / length, z = cross.z / length;
+		const double d = -(x * p0.x + y * p0.y + z * p0.z);
+		return Quadric{ area * x * x, area * x * y, area * x * z, area * y * y, area * y * z, area * z * z, area * x * d, area * y * d, area * z * d, area * d * d, area };
+	}
+
+	//Mean squared distance of the point to the planes
+	double Evaluate(const Quadric& quadric, const Elite::FPoint3& p)
+	{
+		if (!(quadric.Weight > 0.0))
+			return 0.0;
+
+		const double x = p.x, y = p.y, z = p.z;
+		const double error = x * (quadric.A00 * x + 2.0 * (quadric.A01 * y + quadric.A02 * z + quadric.B0))
+			+ y * (quadric.A11 * y + 2.0 * (quadric.A12 * z + quadric.B1))
+			+ z * (quadric.A22 * z + 2.0 * quadric.B2) + quadric.C;
+		return std::max(error / quadric.Weight, 0.0);
+	}
+
+	struct Collapse
+	{
+		double Error;
+		uint32_t From; //Vertex that goes away
+		uint32_t To; //Vertex it gets replaced by
+	};
+
+	//Everything that carries over from one level to the next.
+	//Vertices with the same position share one quadric and one place in the topology, the one of the lowest vertex (Wedges)
+	struct Simplification
+	{
+		std::vector<Elite::FPoint3> Positions; //Scaled into [0, 1] by the largest extent of the bounds
+		std::vector<uint32_t> Wedges;
+		std::vector<Quadric> Quadrics;
+		std::vector<uint32_t> Indices;
+		double Error; //Largest collapse so far, squared
+	};
+
+	Simplification StartSimplification(const MeshData& meshData)
+	{
+		const uint32_t nrOfVertices = meshData.GetNrOfVertices();
+		const InputVertex* pVertices = meshData.GetVertices();
+		const Elite::FVector3 extent = meshData.GetBoundsMax() - meshData.GetBoundsMin();
+		const float largestExtent = std::max(std::max(extent.x, extent.y), extent.z);
+		const float scale = largestExtent > 0.f ? 1.f / largestExtent : 1.f;
+
+		Simplification simplification{ std::vector<Elite::FPoint3>(nrOfVertices), std::vector<uint32_t>(nrOfVertices), std::vector<Quadric>(nrOfVertices, Quadric{}), {}, 0.0 };
+		for (uint32_t i = 0; i < nrOfVertices; ++i)
+			simplification.Positions[i] = Elite::FPoint3{ (pVertices[i].Position - meshData.GetBoundsMin()) * scale };
+
+		//Sorting by position puts the vertices that only differ in their attributes next to each other
+		std::vector<uint32_t> order(nrOfVertices);
+		std::iota(order.begin(), order.end(), 0);
+		auto lessPosition = [pVertices](uint32_t lhs, uint32_t rhs) {
+			const Elite::FPoint3& a = pVertices[lhs].Position;
+			const Elite::FPoint3& b = pVertices[rhs].Position;
+			return a.x != b.x ? a.x < b.x : a.y != b.y ? a.y < b.y : a.z != b.z ? a.z < b.z : lhs < rhs;
+		};
+		std::sort(order.begin(), order.end(), lessPosition);
+		for (uint32_t i = 0; i < nrOfVertices; ++i) {
+
+			const bool samePosition = i > 0 && pVertices[order[i]].Position.x == pVertices[order[i - 1]].Position.x
+				&& pVertices[order[i]].Position.y == pVertices[order[i - 1]].Position.y && pVertices[order[i]].Position.z == pVertices[order[i - 1]].Position.z;
+			simplification.Wedges[order[i]] = samePosition ? simplification.Wedges[order[i - 1]] : order[i];
+		}
+
+		//Triangles without area stay in the full mesh, but not in the levels
+		const uint32_t nrOfIndices = meshData.GetNrOfIndices() / 3 * 3;
+		const uint32_t* pIndices = meshData.GetIndices();
+		simplification.Indices.reserve(nrOfIndices);
+		for (uint32_t i = 0; i < nrOfIndices; i += 3) {
+
+			const uint32_t wedge0 = simplification.Wedges[pIndices[i]];
+			const uint32_t wedge1 = simplification.Wedges[pIndices[i + 1]];
+			const uint32_t wedge2 = simplification.Wedges[pIndices[i + 2]];
+			if (wedge0 == wedge1 || wedge1 == wedge2 || wedge0 == wedge2)
+				continue;
+
+			const Quadric quadric = MakePlaneQuadric(simplification.Positions[wedge0], simplification.Positions[wedge1], simplification.Positions[wedge2]);
+			simplification.Quadrics[wedge0] += quadric;
+			simplification.Quadrics[wedge1] += quadric;
+			simplification.Quadrics[wedge2] += quadric;
+			simplification.Indices.insert(simplification.Indices.end(), pIndices + i, pIndices + i + 3);
+		}
+		return simplification;
+	}
+
+	//Positions used by more than one vertex, on an edge that doesn't have exactly two triangles or without triangles can't be collapsed
+	std::vector<bool> FindLockedWedges(const Simplification& simplification)
+	{
+		const std::vector<uint32_t>& indices = simplification.Indices;
+		const uint32_t nrOfVertices = uint32_t(simplification.Wedges.size());
+		std::vector<bool> locked(nrOfVertices, true);
+		std::vector<uint32_t> usedVertex(nrOfVertices, UINT32_MAX);
+		for (uint32_t index : indices) {
+
+			const uint32_t wedge = simplification.Wedges[index];
+			if (usedVertex[wedge] == UINT32_MAX) {
+
+				usedVertex[wedge] = index;
+				locked[wedge] = false;
+			}
+			else if (usedVertex[wedge] != index)
+				locked[wedge] = true;
+		}
+
+		std::vector<uint64_t> edges;
+		edges.reserve(indices.size());
+		for (size_t i = 0; i < indices.size(); i += 3) {
+
+			for (size_t corner = 0; corner < 3; ++corner) {
+
+				const uint64_t wedge0 = simplification.Wedges[indices[i + corner]];
+				const uint64_t wedge1 = simplification.Wedges[indices[i + (corner + 1) % 3]];
+				edges.push_back(std::min(wedge0, wedge1) << 32 | std::max(wedge0, wedge1));
+			}
+		}
+		std::sort(edges.begin(), edges.end());
+		for (size_t first = 0, last = 0; first < edges.size(); first = last) {
+
+			while (last < edges.size() && edges[last] == edges[first])
+				++last;
+			if (last - first != 2) {
+
+				locked[uint32_t(edges[first] >> 32)] = true;
+				locked[uint32_t(edges[first])] = true;
+			}
+		}
+		return locked;
+	}
+
+	//Moving wedge From onto To may not turn any of its other triangles around
+	bool FlipsTriangle(const Simplification& simplification, const std::vector<uint32_t>& wedgeTargets, const std::vector<uint32_t>& triangles, uint32_t from, uint32_t to, uint32_t& nrOfRemovedTriangles)
+	{
+		nrOfRemovedTriangles = 0;
+		for (uint32_t triangle : triangles) {
+
+			uint32_t wedges[3];
+			for (uint32_t corner = 0; corner < 3; ++corner)
+				wedges[corner] = wedgeTargets[simplification.Wedges[simplification.Indices[triangle * 3 + corner]]];
+			//Already gone with an earlier collapse of this pass
+			if (wedges[0] == wedges[1] || wedges[1] == wedges[2] || wedges[0] == wedges[2])
+				continue;
+			if (wedges[0] == to || wedges[1] == to || wedges[2] == to) {
+
+				++nrOfRemovedTriangles;
+				continue;
+			}
+
+			const Elite::FPoint3& p0 = simplification.Positions[wedges[0]];
+			const Elite::FPoint3& p1 = simplification.Positions[wedges[1]];
+			const Elite::FPoint3& p2 = simplification.Positions[wedges[2]];
+			const Elite::FVector3 normal = Elite::Cross(p1 - p0, p2 - p0);
+			const Elite::FPoint3& q0 = wedges[0] == from ? simplification.Positions[to] : p0;
+			const Elite::FPoint3& q1 = wedges[1] == from ? simplification.Positions[to] : p1;
+			const Elite::FPoint3& q2 = wedges[2] == from ? simplification.Positions[to] : p2;
+			if (Elite::Dot(normal, Elite::Cross(q1 - q0, q2 - q0)) <= 0.f)
+				return true;
+		}
+		return false;
+	}
+
+	//Collapses edges until the indices are down to targetNrOfIndices or every collapse that is left costs more than maxError.
+	//Each pass sorts the collapses by their cost and does the cheapest ones, a vertex only takes part in one collapse per pass
+	void Simplify(Simplification& simplification, uint32_t targetNrOfIndices, float maxError)
+	{
+		const uint32_t nrOfVertices = uint32_t(simplification.Wedges.size());
+		const double maxSquaredError = double(maxError) * maxError;
+		std::vector<uint32_t> wedgeTargets(nrOfVertices);
+		std::vector<uint32_t> vertexTargets(nrOfVertices);
+		std::vector<bool> collapsed(nrOfVertices);
+		std::vector<Collapse> collapses;
+		while (simplification.Indices.size() > targetNrOfIndices) {
+
+			std::vector<uint32_t>& indices = simplification.Indices;
+			const std::vector<bool> locked = FindLockedWedges(simplification);
+
+			collapses.clear();
+			for (size_t i = 0; i < indices.size(); i += 3) {
+
+				for (size_t corner = 0; corner < 3; ++corner) {
+
+					const uint32_t vertex0 = indices[i + corner];
+					const uint32_t vertex1 = indices[i + (corner + 1) % 3];
+					const uint32_t wedge0 = simplification.Wedges[vertex0];
+					const uint32_t wedge1 = simplification.Wedges[vertex1];
+					if (!locked[wedge0])
+						collapses.push_back(Collapse{ 0.0, vertex0, vertex1 });
+					if (!locked[wedge1])
+						collapses.push_back(Collapse{ 0.0, vertex1, vertex0 });
+				}
+			}
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& lhs, const Collapse& rhs) { return lhs.From != rhs.From ? lhs.From < rhs.From : lhs.To < rhs.To; });
+			collapses.erase(std::unique(collapses.begin(), collapses.end(), [](const Collapse& lhs, const Collapse& rhs) { return lhs.From == rhs.From && lhs.To == rhs.To; }), collapses.end());
+			for (Collapse& collapse : collapses) {
+
+				Quadric quadric = simplification.Quadrics[simplification.Wedges[collapse.From]];
+				quadric += simplification.Quadrics[simplification.Wedges[collapse.To]];
+				collapse.Error = Evaluate(quadric, simplification.Positions[simplification.Wedges[collapse.To]]);
+			}
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& lhs, const Collapse& rhs) { return lhs.Error < rhs.Error; });
+
+			//Triangles around every position
+			std::vector<uint32_t> offsets(nrOfVertices + 1, 0);
+			for (uint32_t index : indices)
+				++offsets[simplification.Wedges[index] + 1];
+			std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+			std::vector<uint32_t> adjacency(indices.size());
+			std::vector<uint32_t> next{ offsets.begin(), offsets.end() - 1 };
+			for (uint32_t i = 0; i < uint32_t(indices.size()); ++i)
+				adjacency[next[simplification.Wedges[indices[i]]]++] = i / 3;
+
+			std::iota(wedgeTargets.begin(), wedgeTargets.end(), 0);
+			std::iota(vertexTargets.begin(), vertexTargets.end(), 0);
+			std::fill(collapsed.begin(), collapsed.end(), false);
+			const uint32_t nrOfTrianglesToRemove = uint32_t(indices.size() - targetNrOfIndices + 2) / 3;
+			uint32_t nrOfRemovedTriangles = 0;
+			uint32_t nrOfCollapses = 0;
+			std::vector<uint32_t> triangles;
+			for (const Collapse& collapse : collapses) {
+
+				if (collapse.Error > maxSquaredError || nrOfRemovedTriangles >= nrOfTrianglesToRemove)
+					break;
+
+				const uint32_t from = simplification.Wedges[collapse.From];
+				const uint32_t to = simplification.Wedges[collapse.To];
+				if (collapsed[from] || collapsed[to])
+					continue;
+
+				triangles.assign(adjacency.begin() + offsets[from], adjacency.begin() + offsets[from + 1]);
+				uint32_t nrOfTriangles;
+				if (FlipsTriangle(simplification, wedgeTargets, triangles, from, to, nrOfTriangles))
+					continue;
+
+				wedgeTargets[from] = to;
+				vertexTargets[collapse.From] = collapse.To;
+				collapsed[from] = true;
+				collapsed[to] = true;
+				simplification.Quadrics[to] += simplification.Quadrics[from];
+				simplification.Error = std::max(simplification.Error, collapse.Error);
+				nrOfRemovedTriangles += nrOfTriangles;
+				++nrOfCollapses;
+			}
+			if (nrOfCollapses == 0)
+				break;
+
+			//The collapsed vertices aren't a corner of anything anymore, some triangles lost their area
+			size_t nrOfIndices = 0;
+			for (size_t i = 0; i < indices.size(); i += 3) {
+
+				const uint32_t vertex0 = vertexTargets[indices[i]];
+				const uint32_t vertex1 = vertexTargets[indices[i + 1]];
+				const uint32_t vertex2 = vertexTargets[indices[i + 2]];
+				const uint32_t wedge0 = simplification.Wedges[vertex0];
+				const uint32_t wedge1 = simplification.Wedges[vertex1];
+				const uint32_t wedge2 = simplification.Wedges[vertex2];
+				if (wedge0 == wedge1 || wedge1 == wedge2 || wedge0 == wedge2)
+					continue;
+
+				indices[nrOfIndices++] = vertex0;
+				indices[nrOfIndices++] = vertex1;
+				indices[nrOfIndices++] = vertex2;
+			}
+			indices.resize(nrOfIndices);
+		}
+	}
+}
+
+MeshData MeshSimplifier::BuildLods(const MeshData& meshData, const LodSettings& settings)
+{
+	const uint32_t nrOfVertices = meshData.GetNrOfVertices();
+	const Elite::FVector3 extent = meshData.GetBoundsMax() - meshData.GetBoundsMin();
+	const float largestExtent = std::max(std::max(extent.x, extent.y), extent.z);
+
+	//Every level gets the vertex cache order, the vertex fetch order is shared and done below
+	Simplification simplification = StartSimplification(meshData);
+	std::vector<std::vector<uint32_t>> levels;
+	std::vector<float> errors;
+	uint32_t nrOfIndices = meshData.GetNrOfIndices() / 3 * 3;
+	while (levels.size() < settings.MaxNrOfLods) {
+
+		Simplify(simplification, uint32_t(nrOfIndices / 3 * settings.TriangleRatio) * 3, settings.MaxError);
+		const uint32_t nrOfLevelIndices = uint32_t(simplification.Indices.size());
+		if (nrOfLevelIndices == 0 || nrOfLevelIndices > nrOfIndices * settings.MinReduction)
+			break;
+
+		levels.push_back(MeshOptimizer::OptimizeVertexCache(simplification.Indices.data(), nrOfLevelIndices, nrOfVertices));
+		errors.push_back(float(std::sqrt(simplification.Error)) * largestExtent);
+		nrOfIndices = nrOfLevelIndices;
+	}
+
+	//The vertices come in shells: the ones the coarsest level uses, then the ones the next level adds, and so on down to the full mesh.
+	//Every level only uses vertices of the levels above it, so it uses a prefix of the vertices.
+	//Within a shell the vertices keep the order the full mesh uses them first (the vertex fetch order of MeshOptimizer),
+	//the full mesh reads them as a few forward running streams instead of in the order of the coarsest level
+	std::vector<uint32_t> shells(nrOfVertices, 0);
+	for (size_t level = 0; level < levels.size(); ++level)
+		for (uint32_t index : levels[level])
+			shells[index] = std::max(shells[index], uint32_t(level + 1));
+
+	std::vector<uint32_t> firstUse(nrOfVertices, UINT32_MAX);
+	for (uint32_t i = 0, nrOfUsed = 0; i < meshData.GetNrOfIndices(); ++i)
+		if (firstUse[meshData.GetIndices()[i]] == UINT32_MAX)
+			firstUse[meshData.GetIndices()[i]] = nrOfUsed++;
+
+	std::vector<uint32_t> order(nrOfVertices);
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&shells, &firstUse](uint32_t left, uint32_t right) {
+		return shells[left] != shells[right] ? shells[left] > shells[right] : firstUse[left] < firstUse[right];
+		});
+
+	std::vector<uint32_t> remap(nrOfVertices);
+	std::vector<InputVertex> vertices;
+	vertices.reserve(nrOfVertices);
+	for (uint32_t vertex : order) {
+
+		remap[vertex] = uint32_t(vertices.size());
+		vertices.push_back(meshData.GetVertices()[vertex]);
+	}
+
+	std::vector<MeshLod> lods(levels.size());
+	for (size_t level = 0; level < levels.size(); ++level) {
+
+		for (uint32_t& index : levels[level])
+			index = remap[index];
+		const uint32_t nrOfLevelVertices = uint32_t(std::count_if(shells.begin(), shells.end(), [level](uint32_t shell) { return shell > level; }));
+		lods[level] = MeshLod{ 0, uint32_t(levels[level].size()), nrOfLevelVertices, errors[level] };
+	}
+	std::vector<uint32_t> indices{ meshData.GetIndices(), meshData.GetIndices() + meshData.GetNrOfIndices() };
+	for (uint32_t& index : indices)
+		index = remap[index];
+
+	std::vector<uint32_t> lodIndices;
+	for (size_t level = 0; level < levels.size(); ++level) {
+
+		lods[level].FirstIndex = uint32_t(lodIndices.size());
+		lodIndices.insert(lodIndices.end(), levels[level].begin(), levels[level].end());
+	}
+
+	MeshData result{ std::move(vertices), std::move(indices), std::vector<Meshlet>{ meshData.GetMeshlets(), meshData.GetMeshlets() + meshData.GetNrOfMeshlets() } };
+	result.SetLods(std::move(lods), std::move(lodIndices));
+	return result;
+}
@@ -0,0 +1,24 @@
+#pragma once
+#include <cstdint>
+
+class MeshData;
+
+//Levels of detail with the quadric error metric (Garland and Heckbert 1997).
+//Edges get collapsed onto one of their vertices, cheapest first, so every level is an index buffer over the vertices of the mesh.
+//The levels are one chain: level n + 1 keeps simplifying level n, the quadrics keep measuring against the full mesh.
+//Vertices on an open border, a non-manifold edge or an attribute seam (same position, other uv or normal) never move,
+//which keeps holes and uv islands from opening up but also limits how far meshes with many hard edges can go.
+namespace MeshSimplifier
+{
+	struct LodSettings {
+		uint32_t MaxNrOfLods = 4; //Besides the full mesh
+		float TriangleRatio = 0.5f; //Triangles a level aims for, compared to the level before it
+		float MaxError = 0.02f; //Biggest distance a collapse may move the surface, relative to the largest extent of the bounds
+		float MinReduction = 0.85f; //The chain ends at a level that keeps more than this part of the triangles of the level before it
+	};
+
+	//Returns the mesh with its levels (MeshData::GetLods()), the triangle order of the full mesh stays the same.
+	//The vertices get renumbered so every level uses the first MeshLod::NrOfVertices of them, coarsest level first.
+	//Within those steps the vertices stay in the order the full mesh first uses them
+	MeshData BuildLods(const MeshData& meshData, const LodSettings& settings = LodSettings{});
+}
@@ -1,154 +1,287 @@
 #include "pch.h"
 #include "ObjParser.h"
-#include "Structs.h"
-#include <fstream>
+#include "MappedFile.h"
+#include "MeshData.h"
+#include <charconv>
+#include <cstring>
 #include <iostream>
-#include <regex>
 
-ObjParser* ObjParser::m_Instance = nullptr;
+namespace
+{
+	inline const char* SkipSpaces(const char* it, const char* end)
+	{
+		while (it != end && (*it == ' ' || *it == '\t' || *it == '\r'))
+			++it;
+		return it;
+	}
+
+	//Reads the number that starts at it and moves it past the number, false if there is none
+	template<typename T>
+	inline bool ParseNumberAt(const char*& it, const char* end, T& value)
+	{
+		const std::from_chars_result result = std::from_chars(it, end, value);
+		if (result.ec != std::errc{})
+			return false;
+
+		it = result.ptr;
+		return true;
+	}
+
+	template<typename T>
+	inline bool ParseNumber(const char*& it, const char* end, T& value)
+	{
+		it = SkipSpaces(it, end);
+		return ParseNumberAt(it, end, value);
+	}
+
+	//OBJ indices start at 1, negative ones count back from the last element read so far.
+	//Returns -1 for indices outside of [0, count)
+	inline int ResolveIndex(int index, size_t count)
+	{
+		const long long resolved = index > 0 ? (long long)index - 1 : (long long)count + index;
+		return (index != 0 && resolved >= 0 && resolved < (long long)count) ? int(resolved) : -1;
+	}
+
+	//Unit vector perpendicular to normal, crossed with the axis it is least aligned with
+	inline Elite::FVector3 GetPerpendicular(const Elite::FVector3& normal)
+	{
+		const Elite::FVector3 axis = std::abs(normal.x) < 0.9f ? Elite::FVector3{ 1.f, 0.f, 0.f } : Elite::FVector3{ 0.f, 1.f, 0.f };
+		return Elite::GetNormalized(Elite::Cross(axis, normal));
+	}
+}
+
 ObjParser::ObjParser()
-	: m_InputVertexBuffer{}
-	, m_IndexBuffer{}
-	, m_VertexBuffer{}
+	: m_VertexBuffer{}
 	, m_NormalBuffer{}
 	, m_UvBuffer{}
 	, m_FaceBuffer{}
+	, m_FaceCorners{}
+	, m_CornerToVertex{}
 {
 }
 
-std::pair<const std::vector<InputVertex>&, const std::vector<uint32_t>&> ObjParser::ReadObjFile(std::string path)
+MeshData ObjParser::ReadObjFile(const std::string& path)
+{
+	ObjParser parser{};
+	return parser.Parse(path);
+}
+
+//Walks the mapped file line by line and parses the numbers in place, the only allocations are the growing buffers.
+//Faces can be v, v/vt, v//vn or v/vt/vn with negative (relative) indices; polygons with more than 3 corners get fanned into triangles
+MeshData ObjParser::Parse(const std::string& path)
 {
-	int index{};
-	std::ifstream input(path);
-	std::string currentLine{};
-	m_InputVertexBuffer.clear();
-	m_IndexBuffer.clear();
 	m_VertexBuffer.clear();
 	m_NormalBuffer.clear();
 	m_UvBuffer.clear();
 	m_FaceBuffer.clear();
-	if (!input)
+	m_CornerToVertex.clear();
+
+	const MappedFile file{ path };
+	if (!file.IsOpen())
 		ThrowFileError(path);
+	std::vector<InputVertex> vertices;
+	std::vector<uint32_t> indices;
+	ReserveBuffers(file.GetData(), file.GetSize(), vertices, indices);
 
-	while (std::getline(input, currentLine)) {
+	const char* it = file.GetData();
+	const char* const fileEnd = it + file.GetSize();
+	int lineIndex{};
+	while (it != fileEnd) {
 
-		++index;
-		std::smatch match{};
-		std::regex lineType{ "^([#A-Za-z]+)\\s+(.*)" };
-		if (std::regex_match(currentLine.cbegin(), currentLine.cend(), match, lineType)) {
+		++lineIndex;
+		const char* lineEnd = static_cast<const char*>(std::memchr(it, '\n', size_t(fileEnd - it)));
+		if (!lineEnd)
+			lineEnd = fileEnd;
 
-			if (match[1] == "v") {
+		//Keyword, everything up to the first space
+		const char* keyword = SkipSpaces(it, lineEnd);
+		it = keyword;
+		while (it != lineEnd && *it != ' ' && *it != '\t')
+			++it;
+		const size_t keywordLength = size_t(it - keyword);
 
-				std::string dataToCheck{ match[2].str() };
-				std::regex dataSearch{ "^([\\-\\.0-9e]+) ([\\-\\.0-9e]+) ([\\-\\.0-9e]+)" };
-				if (std::regex_match(dataToCheck.cbegin(), dataToCheck.cend(), match, dataSearch)) {
+		if (keywordLength == 1 && keyword[0] == 'v') {
 
-					m_VertexBuffer.push_back(Elite::FPoint3{std::stof(match[1].str()) , std::stof(match[2].str()), std::stof(match[3].str())} );
-				}
-				else {
+			Elite::FPoint3 position;
+			if (!ParseNumber(it, lineEnd, position.x) || !ParseNumber(it, lineEnd, position.y) || !ParseNumber(it, lineEnd, position.z))
+				ThrowIndexError("Vertex", lineIndex);
+			m_VertexBuffer.push_back(position);
+		}
+		else if (keywordLength == 2 && keyword[0] == 'v' && keyword[1] == 'n') {
 
-					ThrowIndexError("Vertex", index);
-				}
-			}
-			else if (match[1] == "vn") {
+			Elite::FVector3 normal;
+			if (!ParseNumber(it, lineEnd, normal.x) || !ParseNumber(it, lineEnd, normal.y) || !ParseNumber(it, lineEnd, normal.z))
+				ThrowIndexError("Normal", lineIndex);
+			m_NormalBuffer.push_back(normal);
+		}
+		else if (keywordLength == 2 && keyword[0] == 'v' && keyword[1] == 't') {
 
-				std::string dataToCheck{ match[2].str() };
-				std::regex dataSearch{ "^([\\-\\.0-9e]+) ([\\-\\.0-9e]+) ([\\-\\.0-9e]+)\\s*" };
-				if (std::regex_match(dataToCheck.cbegin(), dataToCheck.cend(), match, dataSearch)) {
+			//The optional w coordinate is ignored
+			Elite::FVector2 uv;
+			if (!ParseNumber(it, lineEnd, uv.x) || !ParseNumber(it, lineEnd, uv.y))
+				ThrowIndexError("Texture Coords", lineIndex);
+			m_UvBuffer.push_back(Elite::FVector2{ uv.x, 1 - uv.y });
+		}
+		else if (keywordLength == 1 && keyword[0] == 'f') {
 
-					m_NormalBuffer.push_back(Elite::FVector3{ std::stof(match[1].str()) , std::stof(match[2].str()), std::stof(match[3].str()) });
-				}
-				else {
+			//Corners are (position, uv, normal), -1 when the face leaves it out
+			m_FaceCorners.clear();
+			int position{};
+			while (ParseNumber(it, lineEnd, position)) {
 
-					ThrowIndexError("Normal", index);
-				}
-			}
-			else if (match[1] == "vt") {
+				Elite::IPoint3 corner{ ResolveIndex(position, m_VertexBuffer.size()), -1, -1 };
+				bool valid = corner.x >= 0;
+				if (it != lineEnd && *it == '/') {
 
-				std::string dataToCheck{ match[2].str() };
-				std::regex dataSearch{ "^([\\-\\.0-9e]+) ([\\-\\.0-9e]+) [\\-\\.0-9e]+\\s*" };
-				if (std::regex_match(dataToCheck.cbegin(), dataToCheck.cend(), match, dataSearch)) {
+					int index{};
+					++it;
+					if (it != lineEnd && *it != '/') {
 
-					m_UvBuffer.push_back(Elite::FVector2{ std::stof(match[1].str()) , 1 - std::stof(match[2].str()) });
-				}
-				else {
+						valid = valid && ParseNumberAt(it, lineEnd, index);
+						corner.y = ResolveIndex(index, m_UvBuffer.size());
+						valid = valid && corner.y >= 0;
+					}
+					if (it != lineEnd && *it == '/') {
 
-					ThrowIndexError("Texture Coords", index);
+						++it;
+						valid = valid && ParseNumberAt(it, lineEnd, index);
+						corner.z = ResolveIndex(index, m_NormalBuffer.size());
+						valid = valid && corner.z >= 0;
+					}
 				}
-			}
-			else if (match[1] == "f") {
 
-				std::string dataToCheck{ match[2].str() };
-				std::regex dataSearch{ "^(\\d+)/(\\d+)/(\\d+)\\s(\\d+)/(\\d+)/(\\d+)\\s(\\d+)/(\\d+)/(\\d+)\\s*" };
-				if (std::regex_match(dataToCheck.cbegin(), dataToCheck.cend(), match, dataSearch)) {
+				if (!valid || (it != lineEnd && *it != ' ' && *it != '\t' && *it != '\r'))
+					ThrowIndexError("Face", lineIndex);
+				m_FaceCorners.push_back(corner);
+			}
 
-					m_FaceBuffer.push_back({ std::stoi(match[1].str()) - 1, std::stoi(match[2].str()) - 1, (std::stoi(match[3].str()) - 1) });
-					m_FaceBuffer.push_back({ std::stoi(match[4].str()) - 1, std::stoi(match[5].str()) - 1, (std::stoi(match[6].str()) - 1) });
-					m_FaceBuffer.push_back({ std::stoi(match[7].str()) - 1, std::stoi(match[8].str()) - 1, (std::stoi(match[9].str()) - 1) });
-				}
-				else {
+			if (m_FaceCorners.size() < 3)
+				ThrowIndexError("Face", lineIndex);
+			for (size_t corner = 1; corner + 1 < m_FaceCorners.size(); ++corner) {
 
-					ThrowIndexError("Face", index);
-				}
+				m_FaceBuffer.push_back(m_FaceCorners[0]);
+				m_FaceBuffer.push_back(m_FaceCorners[corner]);
+				m_FaceBuffer.push_back(m_FaceCorners[corner + 1]);
 			}
 		}
+
+		//Comments, groups, materials and the rest are skipped
+		it = lineEnd == fileEnd ? fileEnd : lineEnd + 1;
 	}
-	input.close();
 
-	for (Elite::IPoint3 face : m_FaceBuffer) {
-		InputVertex vertex = { m_VertexBuffer[face.x], m_UvBuffer[face.y], m_NormalBuffer[face.z] };
+	//Corners with the same index triple become the same vertex, one hash lookup per corner.
+	//Corners without uv get (0, 0), corners without a normal get the normal of their triangle and are only welded within it
+	for (size_t i = 0; i < m_FaceBuffer.size(); ++i) {
 
-		int index{ 0 };
-		bool found{ false };
-		for (; index < m_InputVertexBuffer.size(); ++index)
-			if (found = (vertex == m_InputVertexBuffer[index]))
-				break;
+		const Elite::IPoint3& face = m_FaceBuffer[i];
+		const size_t triangle = i - i % 3;
+		const Elite::IPoint3 key{ face.x, face.y, face.z >= 0 ? face.z : -1 - int(triangle / 3) };
+		const auto inserted = m_CornerToVertex.emplace(key, uint32_t(vertices.size()));
+		indices.push_back(inserted.first->second);
+		if (!inserted.second)
+			continue;
 
-		if (!found) {
-			
-			m_IndexBuffer.push_back(int(m_InputVertexBuffer.size()));
-			m_InputVertexBuffer.push_back(vertex);
-		}
-		else {
-			
-			m_IndexBuffer.push_back(index);
-		}
+		//A triangle without area has no normal of its own, it covers no pixels so any unit vector will do
+		Elite::FVector3 faceNormal = face.z >= 0 ? Elite::FVector3{} : Elite::GetNormalized(Elite::Cross(m_VertexBuffer[m_FaceBuffer[triangle + 1].x] - m_VertexBuffer[m_FaceBuffer[triangle].x], m_VertexBuffer[m_FaceBuffer[triangle + 2].x] - m_VertexBuffer[m_FaceBuffer[triangle].x]));
+		if (face.z < 0 && Elite::SqrMagnitude(faceNormal) == 0.f)
+			faceNormal = Elite::FVector3{ 0.f, 1.f, 0.f };
+
+		//The tangent gets calculated below, .obj files have no vertex colors
+		vertices.push_back(InputVertex{ m_VertexBuffer[face.x], face.y >= 0 ? m_UvBuffer[face.y] : Elite::FVector2{}, face.z >= 0 ? m_NormalBuffer[face.z] : faceNormal, Elite::FVector3{}, Elite::RGBColor{} });
 	}
 
 	//Following code is heavily based on code found at the following link:
 	//https://stackoverflow.com/questions/5255806/how-to-calculate-tangent-and-binormal
-	for (uint32_t i = 0; i < m_IndexBuffer.size(); i += 3) {
+	for (uint32_t i = 0; i < indices.size(); i += 3) {
 
-		uint32_t index0 = m_IndexBuffer[i];
-		uint32_t index1 = m_IndexBuffer[i + 1];
-		uint32_t index2 = m_IndexBuffer[i + 2];
+		uint32_t index0 = indices[i];
+		uint32_t index1 = indices[i + 1];
+		uint32_t index2 = indices[i + 2];
 
-		const Elite::FPoint3& p0 = m_InputVertexBuffer[index0].Position;
-		const Elite::FPoint3& p1 = m_InputVertexBuffer[index1].Position;
-		const Elite::FPoint3& p2 = m_InputVertexBuffer[index2].Position;
-		const Elite::FVector2& uv0 = m_InputVertexBuffer[index0].UV;
-		const Elite::FVector2& uv1 = m_InputVertexBuffer[index1].UV;
-		const Elite::FVector2& uv2 = m_InputVertexBuffer[index2].UV;
+		const Elite::FPoint3& p0 = vertices[index0].Position;
+		const Elite::FPoint3& p1 = vertices[index1].Position;
+		const Elite::FPoint3& p2 = vertices[index2].Position;
+		const Elite::FVector2& uv0 = vertices[index0].UV;
+		const Elite::FVector2& uv1 = vertices[index1].UV;
+		const Elite::FVector2& uv2 = vertices[index2].UV;
 
 		const Elite::FVector3 edge0 = p1 - p0;
 		const Elite::FVector3 edge1 = p2 - p0;
 		const Elite::FVector2 diffX = Elite::FVector2(uv1.x - uv0.x, uv2.x - uv0.x);
 		const Elite::FVector2 diffY = Elite::FVector2(uv1.y - uv0.y, uv2.y - uv0.y);
-		float r = 1.f / Elite::Cross(diffX, diffY);
+
+		//Faces without uvs or with all their uvs on a line don't say which way u runs, they add nothing
+		const float determinant = Elite::Cross(diffX, diffY);
+		if (std::abs(determinant) < 1e-12f)
+			continue;
+		float r = 1.f / determinant;
 
 		Elite::FVector3 tangent = (edge0 * diffY.y - edge1 * diffY.x) * r;
-		m_InputVertexBuffer[index0].Tangent += tangent;
-		m_InputVertexBuffer[index1].Tangent += tangent;
-		m_InputVertexBuffer[index2].Tangent += tangent;
+		vertices[index0].Tangent += tangent;
+		vertices[index1].Tangent += tangent;
+		vertices[index2].Tangent += tangent;
 	}
-	//Create the tangets (reject vector) + fix the tangents per vertex
-	for (auto& v : m_InputVertexBuffer)
+	//Create the tangets (reject vector) + fix the tangents per vertex.
+	//Vertices that got no usable tangent (or whose tangent lies along the normal) get any tangent perpendicular to the normal
+	for (auto& v : vertices) {
+
+		if (Elite::SqrMagnitude(v.Normal) == 0.f) {
+
+			v.Tangent = Elite::GetNormalized(v.Tangent);
+			continue;
+		}
+
 		v.Tangent = Elite::GetNormalized(Elite::Reject(v.Tangent, v.Normal));
+		if (Elite::SqrMagnitude(v.Tangent) == 0.f || !std::isfinite(v.Tangent.x + v.Tangent.y + v.Tangent.z))
+			v.Tangent = GetPerpendicular(Elite::GetNormalized(v.Normal));
+	}
 
-	return std::pair<const std::vector<InputVertex>&, const std::vector<uint32_t>&>(m_InputVertexBuffer, m_IndexBuffer);
+	return MeshData{ std::move(vertices), std::move(indices) };
 }
 
 
+//The indices of the three corners land in different bits, multiplied by large odd constants
+size_t ObjParser::CornerHash::operator()(const Elite::IPoint3& corner) const
+{
+	uint64_t hash = uint64_t(uint32_t(corner.x)) * 0x9E3779B97F4A7C15ull;
+	hash ^= uint64_t(uint32_t(corner.y)) * 0xC2B2AE3D27D4EB4Full + (hash >> 29);
+	hash ^= uint64_t(uint32_t(corner.z)) * 0x165667B19E3779F9ull + (hash >> 32);
+	return size_t(hash ^ (hash >> 31));
+}
+
+//Counts the lines per keyword in one quick pass (memchr from line to line) so no buffer has to grow while parsing.
+//Faces are counted as triangles, polygons still make their buffers grow
+void ObjParser::ReserveBuffers(const char* data, size_t size, std::vector<InputVertex>& vertices, std::vector<uint32_t>& indices)
+{
+	size_t nrOfPositions{}, nrOfUvs{}, nrOfNormals{}, nrOfFaces{};
+	const char* const end = data + size;
+	for (const char* it = data; it != nullptr && it < end;) {
+
+		if (end - it > 1 && it[0] == 'v') {
+
+			nrOfPositions += it[1] == ' ' || it[1] == '\t';
+			nrOfUvs += it[1] == 't';
+			nrOfNormals += it[1] == 'n';
+		}
+		else if (end - it > 1 && it[0] == 'f')
+			nrOfFaces += it[1] == ' ' || it[1] == '\t';
+
+		it = static_cast<const char*>(std::memchr(it, '\n', size_t(end - it)));
+		if (it)
+			++it;
+	}
+
+	//Every position usually ends up in at least one vertex, seams add a few more
+	const size_t nrOfVertices = std::max(nrOfPositions, nrOfUvs);
+	m_VertexBuffer.reserve(nrOfPositions);
+	m_UvBuffer.reserve(nrOfUvs);
+	m_NormalBuffer.reserve(nrOfNormals);
+	m_FaceBuffer.reserve(nrOfFaces * 3);
+	indices.reserve(nrOfFaces * 3);
+	vertices.reserve(nrOfVertices);
+	m_CornerToVertex.reserve(nrOfVertices);
+}
+
 void ObjParser::ThrowFileError(const std::string& path)
 {
 	throw std::runtime_error("Could not open file '" + path + "', file not found.\n");
@@ -1,38 +1,41 @@
 #pragma once
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 struct InputVertex;
+class MeshData;
+
+//Reads .obj files into a MeshData of their own. The parsers share nothing, any number of threads can read files at the same time.
+//A parser keeps its scratch buffers between files, a thread that loads a lot of files can keep one around; ReadObjFile uses a parser for one file.
 class ObjParser final
 {
 public:
-	static ObjParser* GetInstance() {
-		if (m_Instance == nullptr) {
-			m_Instance = new ObjParser();
-		}
-		return m_Instance;
-	}
+	ObjParser();
 	~ObjParser() = default;
 	ObjParser(const ObjParser& other) = delete;
 	ObjParser& operator=(const ObjParser& other) = delete;
 	ObjParser(ObjParser&& other) = delete;
 	ObjParser& operator=(ObjParser&& other) = delete;
 
-	std::pair<const std::vector<InputVertex>&, const std::vector<uint32_t>&> ReadObjFile(std::string path);
+	static MeshData ReadObjFile(const std::string& path);
+	MeshData Parse(const std::string& path);
 private:
-	ObjParser();
+	struct CornerHash {
+		size_t operator()(const Elite::IPoint3& corner) const;
+	};
 
-	//Variables
-	static ObjParser* m_Instance;
-	std::vector<InputVertex> m_InputVertexBuffer;
-	std::vector<uint32_t> m_IndexBuffer;
+	//Variables, scratch buffers of the file that is being read
 	std::vector<Elite::FPoint3> m_VertexBuffer;
 	std::vector<Elite::FVector3> m_NormalBuffer;
 	std::vector<Elite::FVector2> m_UvBuffer;
-	std::vector<Elite::IPoint3> m_FaceBuffer;
+	std::vector<Elite::IPoint3> m_FaceBuffer; //Three corners per triangle
+	std::vector<Elite::IPoint3> m_FaceCorners; //Corners of the face that is being read
+	std::unordered_map<Elite::IPoint3, uint32_t, CornerHash> m_CornerToVertex; //Welding, (position, uv, normal) index triple to output vertex
 
 	//Functions
-	void ThrowFileError(const std::string& path);
-	void ThrowIndexError(const std::string& dataType, int index);
+	void ReserveBuffers(const char* data, size_t size, std::vector<InputVertex>& vertices, std::vector<uint32_t>& indices);
+	static void ThrowFileError(const std::string& path);
+	static void ThrowIndexError(const std::string& dataType, int index);
 };
 
@@ -0,0 +1,263 @@
+#include "pch.h"
+#include "Profiler.h"
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+
+Profiler* Profiler::m_Instance = nullptr;
+
+namespace
+{
+	//Gives the ring back to the profiler when its thread ends, so new thread pools reuse the rings of the old ones
+	struct ThreadRingOwner {
+		std::shared_ptr<void> pRing;
+		std::atomic<bool>* pInUse = nullptr;
+		~ThreadRingOwner() {
+			if (pInUse)
+				pInUse->store(false);
+		}
+	};
+	thread_local ThreadRingOwner t_RingOwner;
+
+	uint64_t GetNanoseconds()
+	{
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+}
+
+Profiler::Profiler()
+	: m_Enabled{ true }
+	, m_FrameIndex{ 0 }
+	, m_FrameStart{ 0 }
+	, m_StartTime{ GetNanoseconds() - 1 } //Time 0 means "not measured" in ProfileScope
+	, m_RingsMutex{}
+	, m_Rings{}
+	, m_HistorySize{ 120 }
+	, m_FrameHistory{}
+{
+}
+
+Profiler::~Profiler()
+{
+}
+
+bool Profiler::IsEnabled() const
+{
+	return m_Enabled.load(std::memory_order_relaxed);
+}
+
+void Profiler::ToggleEnabled()
+{
+	m_Enabled = !m_Enabled;
+	PrintEnabledInformation();
+}
+
+void Profiler::PrintEnabledInformation() const
+{
+	std::cout << "Profiling: ";
+	if (m_Enabled)
+		std::cout << "true\n";
+	else
+		std::cout << "false\n";
+}
+
+//Name of the calling thread in the exported trace
+void Profiler::SetThreadName(const std::string& name)
+{
+	ThreadRing& ring = GetThreadRing();
+	std::lock_guard<std::mutex> lock{ m_RingsMutex };
+	ring.ThreadName = name;
+}
+
+void Profiler::SetHistorySize(uint32_t nrOfFrames)
+{
+	m_HistorySize = std::max(nrOfFrames, 1u);
+	while (m_FrameHistory.size() > m_HistorySize)
+		m_FrameHistory.pop_front();
+}
+
+uint64_t Profiler::GetTime() const
+{
+	return GetNanoseconds() - m_StartTime;
+}
+
+void Profiler::AddZone(const char* name, uint64_t start, uint64_t end)
+{
+	ThreadRing& ring = GetThreadRing();
+	const uint64_t writeIndex = ring.WriteIndex.load(std::memory_order_relaxed);
+	ring.Zones[writeIndex % m_RingSize] = Zone{ name, start, end, m_FrameIndex.load(std::memory_order_relaxed) };
+	ring.WriteIndex.store(writeIndex + 1, std::memory_order_release);
+}
+
+void Profiler::BeginFrame()
+{
+	m_FrameStart = GetTime();
+}
+
+//Sums the zones every thread added since the last frame and moves on to the next frame
+void Profiler::EndFrame()
+{
+	if (!IsEnabled())
+		return;
+
+	const uint32_t frameIndex = m_FrameIndex.load();
+	AddZone("Frame", m_FrameStart, GetTime());
+
+	FrameProfile profile{ frameIndex, {} };
+	{
+		std::lock_guard<std::mutex> lock{ m_RingsMutex };
+		for (const std::shared_ptr<ThreadRing>& pRing : m_Rings) {
+
+			//Zones that got overwritten before this frame ended are lost
+			const uint64_t writeIndex = pRing->WriteIndex.load(std::memory_order_acquire);
+			pRing->ReadIndex = std::max(pRing->ReadIndex, writeIndex > m_RingSize ? writeIndex - m_RingSize : 0);
+			for (; pRing->ReadIndex < writeIndex; ++pRing->ReadIndex) {
+
+				const Zone& zone = pRing->Zones[pRing->ReadIndex % m_RingSize];
+				if (zone.FrameIndex != frameIndex)
+					continue;
+
+				//A handful of stages, a linear search beats hashing the names
+				auto it = std::find_if(profile.Stages.begin(), profile.Stages.end(), [&zone](const StageTime& stage) {
+					return std::strcmp(stage.Name, zone.Name) == 0;
+					});
+				if (it == profile.Stages.end())
+					it = profile.Stages.insert(profile.Stages.end(), StageTime{ zone.Name, 0.0, 0 });
+
+				it->Milliseconds += double(zone.End - zone.Start) / 1000000.0;
+				++it->NrOfZones;
+			}
+		}
+	}
+
+	m_FrameHistory.push_back(std::move(profile));
+	while (m_FrameHistory.size() > m_HistorySize)
+		m_FrameHistory.pop_front();
+
+	m_FrameIndex.store(frameIndex + 1);
+}
+
+const std::deque<Profiler::FrameProfile>& Profiler::GetFrameHistory() const
+{
+	return m_FrameHistory;
+}
+
+std::vector<Profiler::StageStatistics> Profiler::GetStageStatistics() const
+{
+	//Stages that are missing in a frame count as 0 ms for that frame
+	std::vector<StageStatistics> statistics;
+	std::vector<size_t> nrOfFrames;
+	for (size_t frame = 0; frame < m_FrameHistory.size(); ++frame) {
+		for (const StageTime& stage : m_FrameHistory[frame].Stages) {
+
+			auto it = std::find_if(statistics.begin(), statistics.end(), [&stage](const StageStatistics& stageStatistics) {
+				return stageStatistics.Name == stage.Name;
+				});
+			if (it == statistics.end()) {
+
+				it = statistics.insert(statistics.end(), StageStatistics{ stage.Name, 0.0, stage.Milliseconds, 0.0, 0.0 });
+				nrOfFrames.push_back(0);
+			}
+
+			++nrOfFrames[it - statistics.begin()];
+			it->MeanMilliseconds += stage.Milliseconds;
+			it->MinMilliseconds = std::min(it->MinMilliseconds, stage.Milliseconds);
+			it->MaxMilliseconds = std::max(it->MaxMilliseconds, stage.Milliseconds);
+		}
+	}
+
+	if (m_FrameHistory.empty())
+		return statistics;
+
+	const FrameProfile& lastFrame = m_FrameHistory.back();
+	for (size_t i = 0; i < statistics.size(); ++i) {
+
+		StageStatistics& stageStatistics = statistics[i];
+		stageStatistics.MeanMilliseconds /= m_FrameHistory.size();
+		if (nrOfFrames[i] < m_FrameHistory.size())
+			stageStatistics.MinMilliseconds = 0.0;
+		for (const StageTime& stage : lastFrame.Stages) {
+
+			if (stageStatistics.Name == stage.Name)
+				stageStatistics.LastMilliseconds = stage.Milliseconds;
+		}
+	}
+	return statistics;
+}
+
+void Profiler::PrintStageStatistics() const
+{
+	//Stages that run on several threads add up the time of every thread, only "Frame" is wall clock time
+	std::cout << "Stages over the last " << m_FrameHistory.size() << " frames (mean/min/max ms):\n";
+	for (const StageStatistics& stage : GetStageStatistics())
+		std::cout << "  " << stage.Name << ": " << stage.MeanMilliseconds << " / " << stage.MinMilliseconds << " / " << stage.MaxMilliseconds << '\n';
+}
+
+//Complete ("X") events in microseconds, one track per thread
+bool Profiler::ExportChromeTrace(const std::string& path) const
+{
+	std::ofstream file{ path };
+	if (!file) {
+
+		std::cout << "Could not write " << path << '\n';
+		return false;
+	}
+
+	std::lock_guard<std::mutex> lock{ m_RingsMutex };
+	bool first = true;
+	file << std::fixed << std::setprecision(3);
+	file << "{\"traceEvents\":[\n";
+	for (const std::shared_ptr<ThreadRing>& pRing : m_Rings) {
+
+		file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << pRing->ThreadId << ",\"args\":{\"name\":\"" << pRing->ThreadName << "\"}}";
+		first = false;
+
+		const uint64_t writeIndex = pRing->WriteIndex.load(std::memory_order_acquire);
+		for (uint64_t i = writeIndex > m_RingSize ? writeIndex - m_RingSize : 0; i < writeIndex; ++i) {
+
+			const Zone& zone = pRing->Zones[i % m_RingSize];
+			file << ",\n{\"name\":\"" << zone.Name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << pRing->ThreadId
+				<< ",\"ts\":" << zone.Start / 1000.0 << ",\"dur\":" << (zone.End - zone.Start) / 1000.0 << ",\"args\":{\"frame\":" << zone.FrameIndex << "}}";
+		}
+	}
+	file << "\n]}\n";
+
+	std::cout << "Trace written to " << path << '\n';
+	return bool(file);
+}
+
+//The first zone of a thread takes the lock once to add or reuse a ring, every zone after that is lock free
+Profiler::ThreadRing& Profiler::GetThreadRing()
+{
+	if (t_RingOwner.pRing)
+		return *static_cast<ThreadRing*>(t_RingOwner.pRing.get());
+
+	std::lock_guard<std::mutex> lock{ m_RingsMutex };
+	std::shared_ptr<ThreadRing> pRing;
+	for (const std::shared_ptr<ThreadRing>& pFreeRing : m_Rings) {
+
+		bool inUse = false;
+		if (pFreeRing->InUse.compare_exchange_strong(inUse, true)) {
+
+			pRing = pFreeRing;
+			break;
+		}
+	}
+
+	if (!pRing) {
+
+		pRing = std::make_shared<ThreadRing>();
+		pRing->Zones.resize(m_RingSize);
+		pRing->WriteIndex = 0;
+		pRing->ReadIndex = 0;
+		pRing->InUse = true;
+		pRing->ThreadId = (uint32_t)m_Rings.size();
+		m_Rings.push_back(pRing);
+	}
+	pRing->ThreadName = "Thread " + std::to_string(pRing->ThreadId);
+
+	t_RingOwner.pRing = pRing;
+	t_RingOwner.pInUse = &pRing->InUse;
+	return *pRing;
+}
@@ -0,0 +1,130 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//Measures how long the named zones of the renderer take.
+//Every thread writes its zones into its own ring buffer without locking, the oldest zones get overwritten.
+//EndFrame() sums the zones of the frame per name and keeps the last frames around for statistics,
+//the rings can also be written to a Chrome/Perfetto trace (chrome://tracing or ui.perfetto.dev).
+class Profiler final
+{
+public:
+	struct Zone {
+		const char* Name; //Has to outlive the profiler, zones use string literals
+		uint64_t Start; //Nanoseconds since the profiler was made
+		uint64_t End;
+		uint32_t FrameIndex;
+	};
+
+	//Time spent in all zones with the same name during one frame, summed over every thread
+	struct StageTime {
+		const char* Name;
+		double Milliseconds;
+		uint32_t NrOfZones;
+	};
+
+	struct FrameProfile {
+		uint32_t FrameIndex;
+		std::vector<StageTime> Stages;
+	};
+
+	//Per stage over the frames in the history
+	struct StageStatistics {
+		std::string Name;
+		double MeanMilliseconds;
+		double MinMilliseconds;
+		double MaxMilliseconds;
+		double LastMilliseconds;
+	};
+
+	static Profiler* GetInstance() {
+		if (m_Instance == nullptr) {
+			m_Instance = new Profiler();
+		}
+		return m_Instance;
+	}
+	~Profiler();
+	Profiler(const Profiler& other) = delete;
+	Profiler& operator=(const Profiler& other) = delete;
+	Profiler(Profiler&& other) = delete;
+	Profiler& operator=(Profiler&& other) = delete;
+
+	bool IsEnabled() const;
+	void ToggleEnabled();
+	void PrintEnabledInformation() const;
+	void SetThreadName(const std::string& name);
+	void SetHistorySize(uint32_t nrOfFrames);
+
+	uint64_t GetTime() const;
+	void AddZone(const char* name, uint64_t start, uint64_t end);
+	void BeginFrame();
+	void EndFrame();
+
+	const std::deque<FrameProfile>& GetFrameHistory() const;
+	std::vector<StageStatistics> GetStageStatistics() const;
+	void PrintStageStatistics() const;
+
+	//Only call this between frames, the rings get read while no zone can be written
+	bool ExportChromeTrace(const std::string& path) const;
+private:
+	Profiler();
+
+	static const uint32_t m_RingSize = 1 << 14;
+	struct ThreadRing {
+		std::vector<Zone> Zones;
+		std::atomic<uint64_t> WriteIndex; //Only the owning thread writes, it counts every zone ever added
+		uint64_t ReadIndex; //Only EndFrame() touches this
+		std::atomic<bool> InUse;
+		uint32_t ThreadId;
+		std::string ThreadName;
+	};
+
+	//Variables
+	static Profiler* m_Instance;
+	std::atomic<bool> m_Enabled;
+	std::atomic<uint32_t> m_FrameIndex;
+	uint64_t m_FrameStart;
+	uint64_t m_StartTime;
+
+	//Only taken when a thread adds its ring and when the rings get read
+	mutable std::mutex m_RingsMutex;
+	std::vector<std::shared_ptr<ThreadRing>> m_Rings;
+
+	uint32_t m_HistorySize;
+	std::deque<FrameProfile> m_FrameHistory;
+
+	//Functions
+	ThreadRing& GetThreadRing();
+};
+
+//Adds a zone from its construction until the end of the scope
+class ProfileScope final
+{
+public:
+	ProfileScope(const char* name)
+		: m_Name{ name }
+		, m_Start{ Profiler::GetInstance()->IsEnabled() ? Profiler::GetInstance()->GetTime() : 0 }
+	{
+	}
+	~ProfileScope()
+	{
+		if (m_Start != 0)
+			Profiler::GetInstance()->AddZone(m_Name, m_Start, Profiler::GetInstance()->GetTime());
+	}
+	ProfileScope(const ProfileScope& other) = delete;
+	ProfileScope& operator=(const ProfileScope& other) = delete;
+	ProfileScope(ProfileScope&& other) = delete;
+	ProfileScope& operator=(ProfileScope&& other) = delete;
+private:
+	const char* m_Name;
+	uint64_t m_Start;
+};
+
+#define PROFILE_CONCATENATE_IMPLEMENTATION(a, b) a##b
+#define PROFILE_CONCATENATE(a, b) PROFILE_CONCATENATE_IMPLEMENTATION(a, b)
+#define PROFILE_ZONE(name) ProfileScope PROFILE_CONCATENATE(profileScope, __LINE__){ name }
@@ -1,17 +1,73 @@
 #pragma once
 #include <vector>
+#include <immintrin.h>
 #include "Structs.h"
+#include "BaseEffect.h"
+#include "VertexQuantization.h"
 
 namespace Rasterizer {
 	
-	inline void VertexTransformationFunction(const std::vector<InputVertex>& originalVertices,
-		std::vector<OutputVertex>& transformedVertices, const Elite::FPoint3& cameraPos, const Elite::FMatrix4& cameraToWorld, const Elite::FMatrix4& world,
-		const Elite::FMatrix4& ProjectionMatrix, float screenWidth, float screenHeight, float near, float far, float FOV) {
+	//Frustum planes in clip space, the guard band planes lie GuardBand times further out than the screen edges
+	enum ClipCode : uint32_t {
+		Left = 1 << 0,
+		Right = 1 << 1,
+		Bottom = 1 << 2,
+		Top = 1 << 3,
+		Near = 1 << 4,
+		Far = 1 << 5,
+		GuardLeft = 1 << 6,
+		GuardRight = 1 << 7,
+		GuardBottom = 1 << 8,
+		GuardTop = 1 << 9
+	};
+	const float GuardBand = 2.f;
+
+	//A triangle with all vertices outside one of these planes is invisible
+	const uint32_t FrustumPlanes = Left | Right | Bottom | Top | Near | Far;
+
+	//Only these planes get clipped, the part between the screen and the guard band is skipped by the bounding box
+	const uint32_t ClippingPlanes = Near | Far | GuardLeft | GuardRight | GuardBottom | GuardTop;
+
+	//No branches, every plane test becomes one bit
+	inline uint32_t ComputeOutCode(const Elite::FPoint4& position) {
+
+		const float guardW = GuardBand * position.w;
+		return uint32_t(position.x < -position.w) * Left
+			| uint32_t(position.x > position.w) * Right
+			| uint32_t(position.y < -position.w) * Bottom
+			| uint32_t(position.y > position.w) * Top
+			| uint32_t(position.z < 0.f) * Near
+			| uint32_t(position.z > position.w) * Far
+			| uint32_t(position.x < -guardW) * GuardLeft
+			| uint32_t(position.x > guardW) * GuardRight
+			| uint32_t(position.y < -guardW) * GuardBottom
+			| uint32_t(position.y > guardW) * GuardTop;
+	}
+
+	//Perspective divide and viewport transformation, w is kept for the perspective correct interpolation
+	inline void ProjectToScreen(Elite::FPoint4& position, float screenWidth, float screenHeight) {
+
+		position.x /= position.w;
+		position.y /= position.w;
+		position.z /= position.w;
+
+		position.x = ((position.x + 1) / 2) * screenWidth;
+		position.y = ((1 - position.y) / 2) * screenHeight;
+	}
+
+	//fetchVertex(i) returns vertex i as an InputVertex, a reference into the mesh or a decoded copy
+	template<typename VertexFetch>
+	inline void TransformVertices(VertexFetch fetchVertex, uint32_t nrOfVertices,
+		std::vector<OutputVertex>& transformedVertices, std::vector<ClipVertex>& clipVertices, const Elite::FPoint3& cameraPos, const Elite::FMatrix4& cameraToWorld, const Elite::FMatrix4& world,
+		const Elite::FMatrix4& ProjectionMatrix, float screenWidth, float screenHeight) {
 
 		Elite::FMatrix4 WorldViewProjectionMatrix = ProjectionMatrix * cameraToWorld * world;
 
 		transformedVertices.clear();
-		for (const InputVertex& currentVertex : originalVertices) {
+		clipVertices.clear();
+		for (uint32_t i = 0; i < nrOfVertices; ++i) {
+
+			const auto& currentVertex = fetchVertex(i);
 
 			//ViewDirection
 			Elite::FVector3 direction = Elite::GetNormalized(cameraPos - currentVertex.Position);
@@ -27,9 +83,8 @@ namespace Rasterizer {
 			normal = (Elite::FMatrix3)world * Elite::GetNormalized(normal);
 			tangent = (Elite::FMatrix3)world * Elite::GetNormalized(tangent);
 
-			position.x /= position.w;
-			position.y /= position.w;
-			position.z /= position.w;
+			//The clipper needs the position before the divide
+			clipVertices.push_back(ClipVertex{ position, ComputeOutCode(position) });
 
 			//ProjectionSpace
 			/*reference.x = (reference.x / -reference.z) / (aspectRatio * FOV);
@@ -37,11 +92,27 @@ namespace Rasterizer {
 			reference.z = -reference.z;*/
 			
 			//ScreenSpace
-			position.x = ((position.x + 1) / 2) * screenWidth;
-			position.y = ((1 - position.y) / 2) * screenHeight;
+			ProjectToScreen(position, screenWidth, screenHeight);
 		}
 	}
 
+	inline void VertexTransformationFunction(const InputVertex* pOriginalVertices, uint32_t nrOfVertices,
+		std::vector<OutputVertex>& transformedVertices, std::vector<ClipVertex>& clipVertices, const Elite::FPoint3& cameraPos, const Elite::FMatrix4& cameraToWorld, const Elite::FMatrix4& world,
+		const Elite::FMatrix4& ProjectionMatrix, float screenWidth, float screenHeight, float near, float far, float FOV) {
+
+		TransformVertices([pOriginalVertices](uint32_t i) -> const InputVertex& { return pOriginalVertices[i]; }, nrOfVertices,
+			transformedVertices, clipVertices, cameraPos, cameraToWorld, world, ProjectionMatrix, screenWidth, screenHeight);
+	}
+
+	//The quantized vertices get decoded while they're transformed, the positions relative to quantizationOffset (the bounds minimum of the mesh)
+	inline void VertexTransformationFunction(const QuantizedVertex* pQuantizedVertices, const Elite::FPoint3& quantizationOffset, const Elite::FVector3& quantizationScale, uint32_t nrOfVertices,
+		std::vector<OutputVertex>& transformedVertices, std::vector<ClipVertex>& clipVertices, const Elite::FPoint3& cameraPos, const Elite::FMatrix4& cameraToWorld, const Elite::FMatrix4& world,
+		const Elite::FMatrix4& ProjectionMatrix, float screenWidth, float screenHeight, float near, float far, float FOV) {
+
+		TransformVertices([pQuantizedVertices, &quantizationOffset, &quantizationScale](uint32_t i) { return VertexQuantization::Decode(pQuantizedVertices[i], quantizationOffset, quantizationScale); }, nrOfVertices,
+			transformedVertices, clipVertices, cameraPos, cameraToWorld, world, ProjectionMatrix, screenWidth, screenHeight);
+	}
+
 	inline std::pair<Elite::FPoint2, Elite::FPoint2> CreateBoundingBox(const std::vector<OutputVertex>& vertices, uint32_t width, uint32_t height) {
 		
 		std::pair<Elite::FPoint2, Elite::FPoint2> minMax;
@@ -85,33 +156,501 @@ namespace Rasterizer {
 		return minMax;
 	}
 
-	inline Elite::RGBColor PixelShading(const OutputVertex& v, Elite::RGBColor normalMapSample, Elite::RGBColor SpecularMapSample, float GlossyMapSample, float Shininess, float DirLightIntensity) {
+	//Polygon that comes out of clipping a triangle, every clipping plane adds at most one vertex
+	struct ClipPolygon {
+
+		OutputVertex Vertices[9];
+		uint32_t NrOfVertices;
+	};
+
+	//Signed distance to a clipping plane, positive on the inside
+	inline float PlaneDistance(const Elite::FPoint4& position, ClipCode plane) {
+
+		switch (plane)
+		{
+		case Near:
+			return position.z;
+		case Far:
+			return position.w - position.z;
+		case GuardLeft:
+			return position.x + GuardBand * position.w;
+		case GuardRight:
+			return GuardBand * position.w - position.x;
+		case GuardBottom:
+			return position.y + GuardBand * position.w;
+		case GuardTop:
+			return GuardBand * position.w - position.y;
+		default:
+			return 0.f;
+		}
+	}
+
+	//Everything is still linear in clip space, so the attributes can be interpolated with the same t as the position
+	inline OutputVertex LerpVertex(const OutputVertex& from, const OutputVertex& to, float t) {
+
+		OutputVertex result{};
+		result.Position.x = from.Position.x + (to.Position.x - from.Position.x) * t;
+		result.Position.y = from.Position.y + (to.Position.y - from.Position.y) * t;
+		result.Position.z = from.Position.z + (to.Position.z - from.Position.z) * t;
+		result.Position.w = from.Position.w + (to.Position.w - from.Position.w) * t;
+		result.UV = from.UV + (to.UV - from.UV) * t;
+		result.Normal = from.Normal + (to.Normal - from.Normal) * t;
+		result.Tangent = from.Tangent + (to.Tangent - from.Tangent) * t;
+		result.Color = from.Color + (to.Color - from.Color) * t;
+		result.ViewDirection = from.ViewDirection + (to.ViewDirection - from.ViewDirection) * t;
+		return result;
+	}
+
+	//Sutherland-Hodgman against every plane in clipPlanes, the vertices need clip space positions.
+	//Returns false when nothing is left of the polygon
+	inline bool ClipPolygonToPlanes(ClipPolygon& polygon, uint32_t clipPlanes) {
+
+		ClipPolygon clipped;
+		for (uint32_t plane = Near; plane <= GuardTop; plane <<= 1) {
+
+			if (!(clipPlanes & plane))
+				continue;
+
+			clipped.NrOfVertices = 0;
+			for (uint32_t i = 0; i < polygon.NrOfVertices; ++i) {
+
+				const OutputVertex& current = polygon.Vertices[i];
+				const OutputVertex& next = polygon.Vertices[(i + 1) % polygon.NrOfVertices];
+				const float currentDistance = PlaneDistance(current.Position, ClipCode(plane));
+				const float nextDistance = PlaneDistance(next.Position, ClipCode(plane));
+
+				if (currentDistance >= 0.f)
+					clipped.Vertices[clipped.NrOfVertices++] = current;
+
+				//The edge crosses the plane
+				if ((currentDistance >= 0.f) != (nextDistance >= 0.f))
+					clipped.Vertices[clipped.NrOfVertices++] = LerpVertex(current, next, currentDistance / (currentDistance - nextDistance));
+			}
+
+			polygon = clipped;
+			if (polygon.NrOfVertices < 3)
+				return false;
+		}
+
+		return true;
+	}
+
+	//Twice the signed screen space area, equal to the sum of the weights Renderer::PixelInTri calculates.
+	//Positive for back faces, negative for front faces
+	inline float SignedArea(const Elite::FPoint4& v0, const Elite::FPoint4& v1, const Elite::FPoint4& v2) {
+
+		return Elite::Cross(v0.xy - v1.xy, v0.xy - v2.xy);
+	}
+
+	//The pixel weights always add up to the signed area, so a triangle whose sign goes against the cull mode
+	//can't have a single pixel where all weights pass the test of Renderer::PixelInTri
+	inline bool IsCulled(float signedArea, BaseEffect::Culling cullMode) {
+
+		switch (cullMode)
+		{
+		case BaseEffect::Culling::Back:
+			return signedArea > 0.f;
+		case BaseEffect::Culling::Front:
+			return signedArea < 0.f;
+		default:
+			return false;
+		}
+	}
+
+	//Calculates the edge equations of a screen space triangle once, so they can be stepped over the pixels afterwards
+	//Returns false for triangles without area
+	inline bool SetupTriangle(BinnedTriangle& triangle, const Elite::FPoint4& v0, const Elite::FPoint4& v1, const Elite::FPoint4& v2) {
+
+		const float totalWeight = SignedArea(v0, v1, v2);
+		if (totalWeight == 0.f)
+			return false;
+
+		//Cross(to - from, pixel - from) written out as A * dx + B * dy, relative to the start of the edge to keep the precision
+		auto createEdge = [](const Elite::FPoint4& from, const Elite::FPoint4& to) {
+			return EdgeEquation{ from.y - to.y, to.x - from.x, from.x, from.y };
+		};
+
+		triangle.Edges[0] = createEdge(v1, v2);
+		triangle.Edges[1] = createEdge(v2, v0);
+		triangle.Edges[2] = createEdge(v0, v1);
+		triangle.InverseArea = 1.f / totalWeight;
+		return true;
+	}
+
+	//Turns the vertex attributes into planes over the screen, needs the edge equations of SetupTriangle.
+	//z after the divide is already affine over the screen, so depth is interpolated as is: 1/z would blow up for the vertices the near clipper puts at z = 0.
+	//The gradient of the barycentric weight i is (Edges[i].A, Edges[i].B) * InverseArea.
+	inline void SetupAttributes(TriangleAttributes& attributes, const BinnedTriangle& triangle, const OutputVertex& v0, const OutputVertex& v1, const OutputVertex& v2) {
+
+		auto fillSlots = [](const OutputVertex& vertex, float (&slots)[TriangleAttributes::NrOfPaddedSlots]) {
+
+			const float inverseW = 1.f / vertex.Position.w;
+			slots[TriangleAttributes::Depth] = vertex.Position.z;
+			slots[TriangleAttributes::InverseW] = inverseW;
+			slots[TriangleAttributes::U] = vertex.UV.x * inverseW;
+			slots[TriangleAttributes::V] = vertex.UV.y * inverseW;
+			slots[TriangleAttributes::NormalX] = vertex.Normal.x * inverseW;
+			slots[TriangleAttributes::NormalY] = vertex.Normal.y * inverseW;
+			slots[TriangleAttributes::NormalZ] = vertex.Normal.z * inverseW;
+			slots[TriangleAttributes::TangentX] = vertex.Tangent.x * inverseW;
+			slots[TriangleAttributes::TangentY] = vertex.Tangent.y * inverseW;
+			slots[TriangleAttributes::TangentZ] = vertex.Tangent.z * inverseW;
+			slots[TriangleAttributes::ViewDirectionX] = vertex.ViewDirection.x * inverseW;
+			slots[TriangleAttributes::ViewDirectionY] = vertex.ViewDirection.y * inverseW;
+			slots[TriangleAttributes::ViewDirectionZ] = vertex.ViewDirection.z * inverseW;
+			for (int slot = TriangleAttributes::NrOfSlots; slot < TriangleAttributes::NrOfPaddedSlots; ++slot)
+				slots[slot] = 0.f;
+		};
+
+		float slots[3][TriangleAttributes::NrOfPaddedSlots];
+		fillSlots(v0, slots[0]);
+		fillSlots(v1, slots[1]);
+		fillSlots(v2, slots[2]);
+
+		//Edge 2 starts at vertex 0, its origin is the position SetupTriangle got, which can be snapped
+		attributes.OriginX = triangle.Edges[2].OriginX;
+		attributes.OriginY = triangle.Edges[2].OriginY;
+		for (int slot = 0; slot < TriangleAttributes::NrOfPaddedSlots; ++slot) {
+
+			attributes.Base[slot] = slots[0][slot];
+			attributes.DX[slot] = (slots[0][slot] * triangle.Edges[0].A + slots[1][slot] * triangle.Edges[1].A + slots[2][slot] * triangle.Edges[2].A) * triangle.InverseArea;
+			attributes.DY[slot] = (slots[0][slot] * triangle.Edges[0].B + slots[1][slot] * triangle.Edges[1].B + slots[2][slot] * triangle.Edges[2].B) * triangle.InverseArea;
+		}
+	}
+
+	inline float InterpolateAttribute(const TriangleAttributes& attributes, TriangleAttributes::Slot slot, float x, float y) {
+
+		return attributes.Base[slot] + attributes.DX[slot] * (x - attributes.OriginX) + attributes.DY[slot] * (y - attributes.OriginY);
+	}
+
+	//Evaluates all the planes at pixel (x, y), 4 slots per multiply-add
+	inline void InterpolateAttributes(const TriangleAttributes& attributes, float x, float y, float (&values)[TriangleAttributes::NrOfPaddedSlots]) {
+
+		const __m128 deltaX = _mm_set1_ps(x - attributes.OriginX);
+		const __m128 deltaY = _mm_set1_ps(y - attributes.OriginY);
+		for (int slot = 0; slot < TriangleAttributes::NrOfPaddedSlots; slot += 4) {
+
+			const __m128 gradient = _mm_add_ps(_mm_mul_ps(_mm_load_ps(attributes.DX + slot), deltaX), _mm_mul_ps(_mm_load_ps(attributes.DY + slot), deltaY));
+			_mm_store_ps(values + slot, _mm_add_ps(_mm_load_ps(attributes.Base + slot), gradient));
+		}
+	}
+
+	//Uv derivatives of a 2x2 pixel quad like ddx/ddy on a GPU, (x, y) is the sample position of the top left pixel of the quad.
+	//The planes get evaluated at the other pixels of the quad, also when they lie outside of the triangle
+	inline void CalculateUVDerivatives(const TriangleAttributes& attributes, float x, float y, Elite::FVector2& dUVdx, Elite::FVector2& dUVdy) {
+
+		auto getUV = [&attributes](float sampleX, float sampleY) {
+			const float depth = 1.f / InterpolateAttribute(attributes, TriangleAttributes::InverseW, sampleX, sampleY);
+			return Elite::FVector2{ InterpolateAttribute(attributes, TriangleAttributes::U, sampleX, sampleY) * depth, InterpolateAttribute(attributes, TriangleAttributes::V, sampleX, sampleY) * depth };
+		};
+
+		const Elite::FVector2 uv = getUV(x, y);
+		dUVdx = getUV(x + 1.f, y) - uv;
+		dUVdy = getUV(x, y + 1.f) - uv;
+	}
+
+	//Edge values of 4 neighbouring pixels on a row (x .. x + 3), Step() moves them 4 pixels to the right.
+	//The pixel positions are stepped instead of the edge values, integer steps are exact in float so the
+	//values stay identical to the ones Renderer::PixelInTri calculates.
+	struct EdgeBlock4 {
+
+		__m128 PixelX;
+		__m128 OriginX[3];
+		__m128 EdgeA[3];
+		__m128 EdgeY[3];
+		__m128 Values[3];
+
+		EdgeBlock4(const BinnedTriangle& triangle, float x, float y) {
+
+			PixelX = _mm_add_ps(_mm_set1_ps(x), _mm_set_ps(3.f, 2.f, 1.f, 0.f));
+			for (int i = 0; i < 3; ++i) {
+
+				const EdgeEquation& edge = triangle.Edges[i];
+				OriginX[i] = _mm_set1_ps(edge.OriginX);
+				EdgeA[i] = _mm_set1_ps(edge.A);
+				EdgeY[i] = _mm_set1_ps(edge.B * (y - edge.OriginY));
+			}
+			Evaluate();
+		}
+
+		inline void Step() {
+
+			PixelX = _mm_add_ps(PixelX, _mm_set1_ps(4.f));
+			Evaluate();
+		}
+
+		inline void Evaluate() {
+
+			Values[0] = _mm_add_ps(_mm_mul_ps(EdgeA[0], _mm_sub_ps(PixelX, OriginX[0])), EdgeY[0]);
+			Values[1] = _mm_add_ps(_mm_mul_ps(EdgeA[1], _mm_sub_ps(PixelX, OriginX[1])), EdgeY[1]);
+			Values[2] = _mm_add_ps(_mm_mul_ps(EdgeA[2], _mm_sub_ps(PixelX, OriginX[2])), EdgeY[2]);
+		}
+
+		//Returns a bit per pixel that lies in the triangle, using the same rules as Renderer::PixelInTri
+		inline int CoverageMask(BaseEffect::Culling cullMode) const {
+
+			const __m128 zero = _mm_setzero_ps();
+			__m128 inside{};
+			switch (cullMode)
+			{
+			case BaseEffect::Culling::Back:
+				inside = _mm_and_ps(_mm_and_ps(_mm_cmple_ps(Values[0], zero), _mm_cmple_ps(Values[1], zero)), _mm_cmple_ps(Values[2], zero));
+				break;
+			case BaseEffect::Culling::Front:
+				inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(Values[0], zero), _mm_cmpge_ps(Values[1], zero)), _mm_cmpge_ps(Values[2], zero));
+				break;
+			case BaseEffect::Culling::None:
+				inside = _mm_or_ps(
+					_mm_and_ps(_mm_and_ps(_mm_cmpgt_ps(Values[0], zero), _mm_cmpgt_ps(Values[1], zero)), _mm_cmpgt_ps(Values[2], zero)),
+					_mm_and_ps(_mm_and_ps(_mm_cmplt_ps(Values[0], zero), _mm_cmplt_ps(Values[1], zero)), _mm_cmplt_ps(Values[2], zero)));
+				break;
+			default:
+				break;
+			}
+
+			return _mm_movemask_ps(inside);
+		}
+	};
+
+	//28.4 fixed point, every pixel has 16 x 16 sub pixel positions
+	const int32_t SubPixelBits = 4;
+	const int32_t SubPixelScale = 1 << SubPixelBits;
+
+	//Rounds x and y to the sub pixel grid the way SetupFixedPointTriangle does
+	inline Elite::FPoint4 SnapToSubPixel(const Elite::FPoint4& position) {
+
+		return Elite::FPoint4{ std::llround(position.x * SubPixelScale) / float(SubPixelScale), std::llround(position.y * SubPixelScale) / float(SubPixelScale), position.z, position.w };
+	}
+
+	//Snaps the vertices to the sub pixel grid and sets up integer edge equations that are positive inside the triangle.
+	//Pixels exactly on an edge only belong to the triangle if it is a top or left edge, so a pixel on a shared edge gets drawn once.
+	//Returns false when the snapped triangle has no area
+	inline bool SetupFixedPointTriangle(BinnedTriangle& triangle, const Elite::FPoint4& v0, const Elite::FPoint4& v1, const Elite::FPoint4& v2) {
+
+		const int64_t x[3] = { std::llround(v0.x * SubPixelScale), std::llround(v1.x * SubPixelScale), std::llround(v2.x * SubPixelScale) };
+		const int64_t y[3] = { std::llround(v0.y * SubPixelScale), std::llround(v1.y * SubPixelScale), std::llround(v2.y * SubPixelScale) };
+
+		//Same layout as SetupTriangle, edge i lies opposite of vertex i
+		const int from[3] = { 1, 2, 0 };
+		const int to[3] = { 2, 0, 1 };
+
+		//The value of edge 0 at vertex 0 is the (doubled) signed area, flip all edges if it is negative
+		const int64_t area = (y[1] - y[2]) * (x[0] - x[1]) + (x[2] - x[1]) * (y[0] - y[1]);
+		if (area == 0)
+			return false;
+		const int64_t sign = area > 0 ? 1 : -1;
+
+		for (int i = 0; i < 3; ++i) {
+
+			FixedPointEdgeEquation& edge = triangle.FixedPointEdges[i];
+			edge.A = (y[from[i]] - y[to[i]]) * sign;
+			edge.B = (x[to[i]] - x[from[i]]) * sign;
+			edge.C = -(edge.A * x[from[i]] + edge.B * y[from[i]]);
+
+			//Y points down: on a left edge the inside lies to the right (A > 0), on a top edge the inside lies below (A == 0, B > 0).
+			//Other edges lose the pixels exactly on them, E >= 0 becomes E > 0
+			const bool topLeft = edge.A > 0 || (edge.A == 0 && edge.B > 0);
+			if (!topLeft)
+				edge.C -= 1;
+		}
+		return true;
+	}
+
+	//Fixed point edge values of 4 neighbouring pixel centers on a row.
+	//Only edges that cross the block get tested, their values stay small enough for 32 bit integers
+	struct FixedPointEdgeBlock4 {
+
+		__m128i Values[3];
+		__m128i Step[3];
+		int TestedEdges;
+
+		FixedPointEdgeBlock4(const int32_t (&startValues)[3], const BinnedTriangle& triangle, int testedEdges)
+			: TestedEdges{ testedEdges } {
+
+			for (int i = 0; i < 3; ++i) {
+
+				const int32_t stepX = int32_t(triangle.FixedPointEdges[i].A * SubPixelScale);
+				Values[i] = _mm_add_epi32(_mm_set1_epi32(startValues[i]), _mm_set_epi32(3 * stepX, 2 * stepX, stepX, 0));
+				Step[i] = _mm_set1_epi32(4 * stepX);
+			}
+		}
+
+		inline void StepX() {
+
+			Values[0] = _mm_add_epi32(Values[0], Step[0]);
+			Values[1] = _mm_add_epi32(Values[1], Step[1]);
+			Values[2] = _mm_add_epi32(Values[2], Step[2]);
+		}
+
+		//Returns a bit per pixel center that lies in the triangle
+		inline int CoverageMask() const {
+
+			const __m128i minusOne = _mm_set1_epi32(-1);
+			__m128i inside = minusOne;
+			for (int i = 0; i < 3; ++i) {
+
+				if (TestedEdges & (1 << i))
+					inside = _mm_and_si128(inside, _mm_cmpgt_epi32(Values[i], minusOne));
+			}
+
+			return _mm_movemask_ps(_mm_castsi128_ps(inside));
+		}
+	};
+
+	//Amount of pixels in a 4 bit coverage mask
+	inline uint32_t CountCoveredPixels(int coverage) {
+
+		return uint32_t((coverage & 1) + ((coverage >> 1) & 1) + ((coverage >> 2) & 1) + ((coverage >> 3) & 1));
+	}
+
+	enum class BlockCoverage {
+		Outside,
+		Partial,
+		Inside
+	};
+
+	//Tests the size x size pixels starting at (x, y) against the edge equations by looking at the corner pixels only.
+	//An edge function is linear, so if the corners agree all the pixels in between agree as well.
+	inline BlockCoverage ClassifyBlock(const BinnedTriangle& triangle, float x, float y, float size, BaseEffect::Culling cullMode) {
+
+		const float cornersX[2] = { x, x + size - 1.f };
+		const float cornersY[2] = { y, y + size - 1.f };
+
+		bool anyEdgeAllPositive = false;
+		bool anyEdgeAllNegative = false;
+		bool allEdgesPositive = true;
+		bool allEdgesNegative = true;
+		bool allEdgesStrictPositive = true;
+		bool allEdgesStrictNegative = true;
+		bool anyEdgeNoPositive = false;
+		bool anyEdgeNoNegative = false;
+		for (const EdgeEquation& edge : triangle.Edges) {
+
+			float minValue = FLT_MAX;
+			float maxValue = -FLT_MAX;
+			for (float cornerY : cornersY) {
+				for (float cornerX : cornersX) {
+
+					const float value = edge.A * (cornerX - edge.OriginX) + edge.B * (cornerY - edge.OriginY);
+					minValue = std::min(minValue, value);
+					maxValue = std::max(maxValue, value);
+				}
+			}
+
+			anyEdgeAllPositive |= minValue > 0.f;
+			anyEdgeAllNegative |= maxValue < 0.f;
+			allEdgesPositive &= minValue >= 0.f;
+			allEdgesNegative &= maxValue <= 0.f;
+			allEdgesStrictPositive &= minValue > 0.f;
+			allEdgesStrictNegative &= maxValue < 0.f;
+			anyEdgeNoPositive |= maxValue <= 0.f;
+			anyEdgeNoNegative |= minValue >= 0.f;
+		}
+
+		//Same rules as Renderer::PixelInTri, but for the whole block
+		switch (cullMode)
+		{
+		case BaseEffect::Culling::Back:
+			if (anyEdgeAllPositive)
+				return BlockCoverage::Outside;
+			if (allEdgesNegative)
+				return BlockCoverage::Inside;
+			break;
+		case BaseEffect::Culling::Front:
+			if (anyEdgeAllNegative)
+				return BlockCoverage::Outside;
+			if (allEdgesPositive)
+				return BlockCoverage::Inside;
+			break;
+		case BaseEffect::Culling::None:
+			if (anyEdgeNoPositive && anyEdgeNoNegative)
+				return BlockCoverage::Outside;
+			if (allEdgesStrictPositive || allEdgesStrictNegative)
+				return BlockCoverage::Inside;
+			break;
+		default:
+			break;
+		}
+
+		return BlockCoverage::Partial;
+	}
+
+	//Fixed point version of ClassifyBlock, looks at the centers of the corner pixels.
+	//For partial blocks it gives the edge values at the center of pixel (x, y) and which edges still need a test per pixel
+	inline BlockCoverage ClassifyFixedPointBlock(const BinnedTriangle& triangle, uint32_t x, uint32_t y, uint32_t size, int32_t (&startValues)[3], int& testedEdges) {
+
+		const int64_t centerX = int64_t(x) * SubPixelScale + SubPixelScale / 2;
+		const int64_t centerY = int64_t(y) * SubPixelScale + SubPixelScale / 2;
+		const int64_t span = int64_t(size - 1) * SubPixelScale;
+
+		testedEdges = 0;
+		for (int i = 0; i < 3; ++i) {
+
+			const FixedPointEdgeEquation& edge = triangle.FixedPointEdges[i];
+			const int64_t value = edge.A * centerX + edge.B * centerY + edge.C;
+			const int64_t minValue = value + std::min(edge.A * span, int64_t(0)) + std::min(edge.B * span, int64_t(0));
+			const int64_t maxValue = value + std::max(edge.A * span, int64_t(0)) + std::max(edge.B * span, int64_t(0));
+
+			if (maxValue < 0)
+				return BlockCoverage::Outside;
+
+			//The edge crosses the block, so no value in the block is further from 0 than the span of the block
+			if (minValue < 0) {
+
+				testedEdges |= 1 << i;
+				startValues[i] = int32_t(value);
+			}
+			else {
+				startValues[i] = 0;
+			}
+		}
+
+		return testedEdges == 0 ? BlockCoverage::Inside : BlockCoverage::Partial;
+	}
+
+	//Heat map color for the amount of times (at least 1) a pixel got written: blue, cyan, green, yellow, red and white from 16 writes on
+	inline Elite::RGBColor OverdrawColor(uint32_t nrOfWrites) {
+
+		const uint32_t stops[] = { 1, 2, 3, 5, 8, 16 };
+		const Elite::RGBColor colors[] = { { 0.f, 0.f, 1.f }, { 0.f, 1.f, 1.f }, { 0.f, 1.f, 0.f }, { 1.f, 1.f, 0.f }, { 1.f, 0.f, 0.f }, { 1.f, 1.f, 1.f } };
+		const int nrOfStops = sizeof(stops) / sizeof(stops[0]);
+
+		if (nrOfWrites >= stops[nrOfStops - 1])
+			return colors[nrOfStops - 1];
+
+		int stop = 0;
+		while (nrOfWrites >= stops[stop + 1])
+			++stop;
+
+		const float t = float(nrOfWrites - stops[stop]) / float(stops[stop + 1] - stops[stop]);
+		return colors[stop] * (1.f - t) + colors[stop + 1] * t;
+	}
+
+	inline Elite::RGBColor PixelShading(const OutputVertex& v, const MaterialSample& material, float Shininess, float DirLightIntensity) {
 
 		Elite::FVector3 binormal = Elite::GetNormalized(Elite::Cross(v.Tangent, v.Normal));
 		Elite::FMatrix3 tangentSpaceAxis = Elite::FMatrix3(v.Tangent, binormal, v.Normal);
 
-		//We already return a color / 255.f in our Texture Sample(). So we don't need to do it here!
-		Elite::FVector3 sampledNormal = { normalMapSample.r, normalMapSample.g, normalMapSample.b };
-		sampledNormal = 2.f * sampledNormal - Elite::FVector3{ 1.f, 1.f, 1.f };
-
-		Elite::FVector3 newNormal = tangentSpaceAxis * sampledNormal;
+		//The material sample already holds the normal in [-1, 1], so we don't need to remap it here!
+		Elite::FVector3 newNormal = tangentSpaceAxis * material.Normal;
 		Elite::FVector3 lightDirection = { 0.577f, -0.577f, -0.577f };
 		float observedArea = Elite::Dot(-newNormal, lightDirection);
 
 		//Lambert calculation
 		Elite::RGBColor lightColor = { 1.f, 1.f, 1.f };
-		Elite::RGBColor Lambert = (SpecularMapSample * v.Color) / (float)M_PI;
+		Elite::RGBColor Lambert = (v.Color * material.Specular) / (float)M_PI;
 		Lambert *= lightColor * DirLightIntensity * observedArea;
 
 		//Phong calculations
 		//observedArea is the same calculation as LambertCosignLaw
-		//Specular- and glossy map are greyscales, so every value of RGB is the same value!
+		//Specular- and glossy map are greyscales, they only take one channel of the material texture!
 		Elite::RGBColor Phong{0.f, 0.f, 0.f};
 		if (observedArea >= 0) {
 
 			Elite::FVector3 reflect = lightDirection - 2 * (observedArea * -newNormal);
 			float angle = Elite::Clamp(Elite::Dot(reflect, v.ViewDirection), 0.f, 1.f);
-			Phong = SpecularMapSample * (float)pow(angle, int(GlossyMapSample * Shininess));
+			const float phong = material.Specular * (float)pow(angle, int(material.Glossiness * Shininess));
+			Phong = Elite::RGBColor{ phong, phong, phong };
 		}
 
 		
@@ -28,6 +28,13 @@ void SceneGraph::AddObjectToGraph(Mesh* object) {
 	m_Objects.push_back(object);
 }
 
+void SceneGraph::ClearObjects()
+{
+	for (Mesh* pObj : m_Objects)
+		delete pObj;
+	m_Objects.clear();
+}
+
 const std::vector<Mesh*>& SceneGraph::GetObjects()
 {
 	return m_Objects;
@@ -20,6 +20,7 @@ public:
 
 	void Update(float deltaTime);
 	void AddObjectToGraph(Mesh* object);
+	void ClearObjects();
 	const std::vector<Mesh*>& GetObjects();
 	const RenderMode GetRenderMode() const;
 	void ToggleRenderMode();
@@ -1,4 +1,6 @@
 #pragma once
+#include <cstdint>
+#include <vector>
 #include "EMath.h"
 #include "ERGBColor.h"
 
@@ -15,6 +17,17 @@ struct InputVertex
 	}
 };
 
+//InputVertex in 22 bytes instead of 56 (VertexQuantization): the position relative to the bounds of the mesh, half float uv,
+//octahedral normal and tangent, 8 bit color
+struct QuantizedVertex
+{
+	uint16_t Position[3];
+	uint16_t UV[2];
+	int16_t Normal[2];
+	int16_t Tangent[2];
+	uint8_t Color[4]; //Alpha is unused
+};
+
 struct OutputVertex
 {
 	Elite::FPoint4 Position;
@@ -25,7 +38,184 @@ struct OutputVertex
 	Elite::FVector3 ViewDirection;
 };
 
+//One fetch of the packed material texture (Texture), unpacked for shading
+struct MaterialSample
+{
+	Elite::FVector3 Normal; //Tangent space, [-1, 1]
+	float Specular;
+	float Glossiness;
+};
+
+//Clip space position of a transformed vertex with the frustum planes it lies outside of (Rasterizer::ClipCode)
+struct ClipVertex
+{
+	Elite::FPoint4 Position;
+	uint32_t OutCode;
+};
+
+//Edge function E(x, y) = A * (x - OriginX) + B * (y - OriginY), gives the same value as the Cross() in Renderer::PixelInTri
+struct EdgeEquation
+{
+	float A;
+	float B;
+	float OriginX;
+	float OriginY;
+};
+
+//Perspective correct attribute planes of a triangle, calculated once in the triangle setup.
+//Every slot holds z, 1/w or attribute/w as Base + DX * (x - OriginX) + DY * (y - OriginY),
+//stored as structure of arrays so 4 slots can be interpolated at once.
+struct TriangleAttributes
+{
+	enum Slot {
+		Depth = 0,
+		InverseW,
+		U,
+		V,
+		NormalX,
+		NormalY,
+		NormalZ,
+		TangentX,
+		TangentY,
+		TangentZ,
+		ViewDirectionX,
+		ViewDirectionY,
+		ViewDirectionZ,
+		NrOfSlots,
+		NrOfPaddedSlots = 16
+	};
+
+	float OriginX;
+	float OriginY;
+	alignas(16) float Base[NrOfPaddedSlots];
+	alignas(16) float DX[NrOfPaddedSlots];
+	alignas(16) float DY[NrOfPaddedSlots];
+};
+
+//Edge function in 28.4 fixed point, E(x, y) = A * x + B * y + C with x and y in sub pixels.
+//Positive inside the triangle, the top-left rule is already folded into C
+struct FixedPointEdgeEquation
+{
+	int64_t A;
+	int64_t B;
+	int64_t C;
+};
+
+//Triangle that survived primitive assembly, waiting in the tile bins to be rasterized
+struct BinnedTriangle
+{
+	uint32_t MeshIndex;
+	int Index0;
+	int Index1;
+	int Index2;
+
+	//Pixel bounds (max is exclusive)
+	uint32_t MinX;
+	uint32_t MinY;
+	uint32_t MaxX;
+	uint32_t MaxY;
+
+	//Triangle setup, Edges[i] is the weight of vertex i
+	EdgeEquation Edges[3];
+	float InverseArea;
+
+	//Only set up in RasterizationMode::FixedPoint
+	FixedPointEdgeEquation FixedPointEdges[3];
+
+	//Closest depth of the triangle, used to test it against the Hi-Z buffer
+	float MinDepth;
+};
+
+//Depths one triangle wrote into one Hi-Z block, gathered while shading so the block never has to be read back
+struct HiZBlockWrite
+{
+	float FarthestDepth = 0.f;
+	uint32_t NrOfPixels = 0; //Pixels that passed the depth test
+	uint32_t NrOfNewPixels = 0; //Of those, the pixels that were still empty
+};
+
+//Pipeline statistics of one mesh, like the D3D11_QUERY_DATA_PIPELINE_STATISTICS counters
+struct MeshStatistics
+{
+	//Vertex transformation and primitive assembly
+	uint32_t VerticesTransformed = 0;
+	uint32_t VertexBytesRead = 0; //Size of the vertex format times the vertices transformed
+	uint32_t TrianglesSubmitted = 0;
+	uint32_t TrianglesSaved = 0; //Triangles of the full mesh the level of detail left out
+	uint32_t BackFacesCulled = 0;
+	uint32_t FrontFacesCulled = 0;
+	uint32_t DegenerateCulled = 0; //Triangles without area
+	uint32_t FrustumCulled = 0; //Triangles completely outside of one of the frustum planes
+	uint32_t TrianglesClipped = 0; //Triangles crossing the near/far plane or the guard band
+
+	//Rasterization and shading
+	uint32_t PixelsEdgeTested = 0; //Pixels of which the edge functions got evaluated, blocks completely inside the triangle skip this
+	uint32_t PixelsDepthPassed = 0;
+	uint32_t PixelsCovered = 0; //Depth writes to a pixel that was still empty, the meshes add up to the pixels with at least one triangle on them
+	uint32_t PixelsShaded = 0;
+	uint32_t TexelFetches = 0; //Texels read by the sample calls, 1 for point, 4 for bilinear and 8 for trilinear sampling
+
+	MeshStatistics& operator+=(const MeshStatistics& rhs) {
+		VerticesTransformed += rhs.VerticesTransformed;
+		VertexBytesRead += rhs.VertexBytesRead;
+		TrianglesSubmitted += rhs.TrianglesSubmitted;
+		TrianglesSaved += rhs.TrianglesSaved;
+		BackFacesCulled += rhs.BackFacesCulled;
+		FrontFacesCulled += rhs.FrontFacesCulled;
+		DegenerateCulled += rhs.DegenerateCulled;
+		FrustumCulled += rhs.FrustumCulled;
+		TrianglesClipped += rhs.TrianglesClipped;
+		PixelsEdgeTested += rhs.PixelsEdgeTested;
+		PixelsDepthPassed += rhs.PixelsDepthPassed;
+		PixelsCovered += rhs.PixelsCovered;
+		PixelsShaded += rhs.PixelsShaded;
+		TexelFetches += rhs.TexelFetches;
+		return *this;
+	}
+};
+
+//Counters collected while rendering a frame with the software rasterizer.
+//Every tile counts into its own FrameStatistics, they get merged once the frame is done
+struct FrameStatistics
+{
+	uint32_t HiZTrianglesRejected = 0; //Triangles skipped for a whole tile
+	uint32_t HiZBlocksRejected = 0; //8x8 blocks skipped
+
+	//Same index as the rendered meshes
+	std::vector<MeshStatistics> Meshes;
+
+	FrameStatistics& operator+=(const FrameStatistics& rhs) {
+		HiZTrianglesRejected += rhs.HiZTrianglesRejected;
+		HiZBlocksRejected += rhs.HiZBlocksRejected;
+		if (Meshes.size() < rhs.Meshes.size())
+			Meshes.resize(rhs.Meshes.size());
+		for (size_t i = 0; i < rhs.Meshes.size(); ++i)
+			Meshes[i] += rhs.Meshes[i];
+		return *this;
+	}
+
+	//The counters of all meshes added up
+	MeshStatistics GetTotal() const {
+		MeshStatistics total{};
+		for (const MeshStatistics& mesh : Meshes)
+			total += mesh;
+		return total;
+	}
+
+	//Amount of times a covered pixel passed the depth test, 1 means every pixel got written once
+	float GetOverdrawRatio() const {
+		const MeshStatistics total = GetTotal();
+		return total.PixelsCovered > 0 ? float(total.PixelsDepthPassed) / float(total.PixelsCovered) : 0.f;
+	}
+};
+
 enum class RenderMode {
 	Rasterizer = -1,
 	DirectX = 1
+};
+
+enum class RasterizationMode {
+	Reference = 0,
+	SIMD,
+	FixedPoint
 };
\ No newline at end of file
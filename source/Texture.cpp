@@ -1,20 +1,286 @@
 #include "pch.h"
 #include "Texture.h"
 #include <SDL_image.h>
+#include <immintrin.h>
 
-Texture::Texture(const std::string& path, ID3D11Device* pDevice)
-	: m_pTexture{ nullptr }
-	, m_pGPUTexture{ nullptr }
+bool Texture::m_SIMDGather = true;
+
+namespace
+{
+	//Position of a texel in the tiled storage of a level
+	inline size_t GetTexelIndex(uint32_t tilesPerRow, uint32_t x, uint32_t y)
+	{
+		const uint32_t tile = (x >> 2) + (y >> 2) * tilesPerRow;
+		const uint32_t morton = (x & 1) | ((y & 1) << 1) | ((x & 2) << 1) | ((y & 2) << 2);
+		return size_t(tile) * 16 + morton;
+	}
+
+	inline Elite::FVector4 UnpackTexel(uint32_t texel)
+	{
+		const float toFloat = 1.f / 255.f;
+		return Elite::FVector4{ float(texel & 0xFF) * toFloat, float((texel >> 8) & 0xFF) * toFloat, float((texel >> 16) & 0xFF) * toFloat, float(texel >> 24) * toFloat };
+	}
+
+	//Loads an image file as RGBA8, whatever format the file had
+	SDL_Surface* LoadSurface(const std::string& path)
+	{
+		if (path.empty())
+			return nullptr;
+
+		SDL_Surface* pLoaded = IMG_Load(path.c_str());
+		if (!pLoaded)
+			return nullptr;
+
+		SDL_Surface* pSurface = SDL_ConvertSurfaceFormat(pLoaded, SDL_PIXELFORMAT_RGBA32, 0);
+		SDL_FreeSurface(pLoaded);
+		if (!pSurface)
+			std::cout << "Texture could not be converted: " << SDL_GetError() << '\n';
+		return pSurface;
+	}
+
+	//Red channel of the texel of the surface that lies at the same relative position as (x, y) in a width x height image
+	inline uint32_t GetResampledRed(const SDL_Surface* pSurface, uint32_t x, uint32_t y, uint32_t width, uint32_t height)
+	{
+		const uint32_t surfaceX = uint32_t((uint64_t(x) * pSurface->w) / width);
+		const uint32_t surfaceY = uint32_t((uint64_t(y) * pSurface->h) / height);
+		return ((const uint32_t*)((const uint8_t*)pSurface->pixels + size_t(surfaceY) * pSurface->pitch))[surfaceX] & 0xFF;
+	}
+}
+
+Texture::Texture(const std::string& path, ID3D11Device* pDevice, bool keepMipChain)
+	: m_pGPUTexture{ nullptr }
 	, m_pTextureResourceView{ nullptr }
+	, m_MipLevels{}
 {
-	if (path.empty())
+	if (!keepMipChain && !pDevice)
+		return;
+
+	//Both the mip chain and the DirectX texture want RGBA8
+	SDL_Surface* pSurface = LoadSurface(path);
+	if (!pSurface)
 		return;
 
-	m_pTexture = IMG_Load(path.c_str());
+	//Everything the surface held lives on in the mip chain and the GPU texture
+	CreateFromSurface(pSurface, pDevice, keepMipChain);
+	SDL_FreeSurface(pSurface);
+}
+
+Texture::Texture(const std::string& normalMapPath, const std::string& specularMapPath, const std::string& glossinessMapPath)
+	: m_pGPUTexture{ nullptr }
+	, m_pTextureResourceView{ nullptr }
+	, m_MipLevels{}
+{
+	SDL_Surface* pNormalMap = LoadSurface(normalMapPath);
+	SDL_Surface* pSpecularMap = LoadSurface(specularMapPath);
+	SDL_Surface* pGlossinessMap = LoadSurface(glossinessMapPath);
+	PackMaterialMaps(pNormalMap, pSpecularMap, pGlossinessMap);
+
+	if (pNormalMap)
+		SDL_FreeSurface(pNormalMap);
+	if (pSpecularMap)
+		SDL_FreeSurface(pSpecularMap);
+	if (pGlossinessMap)
+		SDL_FreeSurface(pGlossinessMap);
+}
+
+Texture::Texture(const SDL_Surface* pSurface, ID3D11Device* pDevice, bool keepMipChain)
+	: m_pGPUTexture{ nullptr }
+	, m_pTextureResourceView{ nullptr }
+	, m_MipLevels{}
+{
+	if (pSurface)
+		CreateFromSurface(pSurface, pDevice, keepMipChain);
+}
+
+Texture::Texture(const SDL_Surface* pNormalMap, const SDL_Surface* pSpecularMap, const SDL_Surface* pGlossinessMap)
+	: m_pGPUTexture{ nullptr }
+	, m_pTextureResourceView{ nullptr }
+	, m_MipLevels{}
+{
+	PackMaterialMaps(pNormalMap, pSpecularMap, pGlossinessMap);
+}
+
+Texture::~Texture()
+{
+	if (m_pTextureResourceView)
+		m_pTextureResourceView->Release();
+	if (m_pGPUTexture)
+		m_pGPUTexture->Release();
+}
+
+void Texture::CreateFromSurface(const SDL_Surface* pSurface, ID3D11Device* pDevice, bool keepMipChain)
+{
+	if (keepMipChain) {
+
+		std::vector<uint32_t> linearTexels(size_t(pSurface->w) * pSurface->h);
+		for (int y = 0; y < pSurface->h; ++y) {
+
+			const uint32_t* pRow = (const uint32_t*)((const uint8_t*)pSurface->pixels + size_t(y) * pSurface->pitch);
+			std::copy(pRow, pRow + pSurface->w, linearTexels.begin() + size_t(y) * pSurface->w);
+		}
+		BuildMipChain(std::move(linearTexels), uint32_t(pSurface->w), uint32_t(pSurface->h));
+	}
+
+	//Headless (no device), the software rasterizer only samples the mip chain
+	if (pDevice)
+		CreateGPUTexture(pSurface, pDevice);
+}
+
+void Texture::PackMaterialMaps(const SDL_Surface* pNormalMap, const SDL_Surface* pSpecularMap, const SDL_Surface* pGlossinessMap)
+{
+	//Without all three maps there is nothing to pack, the mesh then gets shaded without them
+	if (pNormalMap && pSpecularMap && pGlossinessMap) {
+
+		const uint32_t width = uint32_t(pNormalMap->w);
+		const uint32_t height = uint32_t(pNormalMap->h);
+		std::vector<uint32_t> linearTexels(size_t(width) * height);
+		for (uint32_t y = 0; y < height; ++y) {
+
+			const uint32_t* pNormalRow = (const uint32_t*)((const uint8_t*)pNormalMap->pixels + size_t(y) * pNormalMap->pitch);
+			for (uint32_t x = 0; x < width; ++x) {
+
+				const uint32_t normalXY = pNormalRow[x] & 0xFFFF;
+				linearTexels[x + size_t(y) * width] = normalXY | (GetResampledRed(pSpecularMap, x, y, width, height) << 16) | (GetResampledRed(pGlossinessMap, x, y, width, height) << 24);
+			}
+		}
+		BuildMipChain(std::move(linearTexels), width, height);
+	}
+}
+
+void Texture::SetSIMDGather(bool enabled)
+{
+	m_SIMDGather = enabled;
+}
+
+bool Texture::IsValid() const
+{
+	return !m_MipLevels.empty();
+}
+
+uint32_t Texture::GetNrOfMipLevels() const
+{
+	return (uint32_t)m_MipLevels.size();
+}
 
+Elite::RGBColor Texture::Sample(const Elite::FVector2& uv, const Elite::FVector2& dUVdx, const Elite::FVector2& dUVdy, BaseEffect::SampleMode mode) const
+{
+	const Elite::FVector4 texel = SampleRGBA(uv, dUVdx, dUVdy, mode);
+	return Elite::RGBColor{ texel.r, texel.g, texel.b };
+}
+
+uint32_t Texture::GetNrOfTexelFetches(BaseEffect::SampleMode mode)
+{
+	switch (mode)
+	{
+	case BaseEffect::SampleMode::Linear:
+		return 4;
+	case BaseEffect::SampleMode::Anisotropic:
+		return 8;
+	default:
+		return 1;
+	}
+}
+
+//Point and Linear use the closest mip level, Anisotropic blends the two closest levels (trilinear)
+Elite::FVector4 Texture::SampleRGBA(const Elite::FVector2& uv, const Elite::FVector2& dUVdx, const Elite::FVector2& dUVdy, BaseEffect::SampleMode mode) const
+{
+	const float maxLod = float(m_MipLevels.size() - 1);
+	const float lod = std::min(CalculateLod(dUVdx, dUVdy), maxLod);
+
+	switch (mode)
+	{
+	case BaseEffect::SampleMode::Point:
+		return SamplePoint(m_MipLevels[size_t(lod + 0.5f)], uv);
+	case BaseEffect::SampleMode::Linear:
+		return m_SIMDGather ? SampleBilinearSIMD(m_MipLevels[size_t(lod + 0.5f)], uv) : SampleBilinear(m_MipLevels[size_t(lod + 0.5f)], uv);
+	case BaseEffect::SampleMode::Anisotropic:
+		{
+			const size_t level = size_t(lod);
+			const size_t nextLevel = std::min(level + 1, m_MipLevels.size() - 1);
+			const float weight = lod - float(level);
+			if (m_SIMDGather)
+				return SampleBilinearSIMD(m_MipLevels[level], uv) * (1.f - weight) + SampleBilinearSIMD(m_MipLevels[nextLevel], uv) * weight;
+			return SampleBilinear(m_MipLevels[level], uv) * (1.f - weight) + SampleBilinear(m_MipLevels[nextLevel], uv) * weight;
+		}
+	default:
+		return SamplePoint(m_MipLevels[0], uv);
+	}
+}
+
+//Bytes of the mip chain plus the DirectX texture (RGBA8, one level)
+size_t Texture::GetMemorySize() const
+{
+	size_t size = 0;
+	for (const MipLevel& level : m_MipLevels)
+		size += level.Texels.size() * sizeof(uint32_t);
+
+	if (m_pGPUTexture) {
+
+		D3D11_TEXTURE2D_DESC desc;
+		m_pGPUTexture->GetDesc(&desc);
+		size += size_t(desc.Width) * desc.Height * 4;
+	}
+	return size;
+}
+
+ID3D11ShaderResourceView* Texture::GetTextureResourceView() const
+{
+	return m_pTextureResourceView;
+}
+
+//Halves the texels with a box filter until they are 1x1, odd sizes repeat their last row or column.
+//The levels get built in scanline order and swizzled into tiles afterwards
+void Texture::BuildMipChain(std::vector<uint32_t> linearTexels, uint32_t width, uint32_t height)
+{
+	while (true) {
+
+		//Store the level, padded to whole tiles
+		MipLevel level{ width, height, (width + 3) / 4, {} };
+		level.Texels.resize(size_t(level.TilesPerRow) * ((height + 3) / 4) * 16);
+		for (uint32_t y = 0; y < height; ++y)
+			for (uint32_t x = 0; x < width; ++x)
+				level.Texels[GetTexelIndex(level.TilesPerRow, x, y)] = linearTexels[x + size_t(y) * width];
+		m_MipLevels.push_back(std::move(level));
+
+		if (width == 1 && height == 1)
+			break;
+
+		const uint32_t nextWidth = std::max(width / 2, 1u);
+		const uint32_t nextHeight = std::max(height / 2, 1u);
+		std::vector<uint32_t> nextTexels(size_t(nextWidth) * nextHeight);
+		for (uint32_t y = 0; y < nextHeight; ++y) {
+			for (uint32_t x = 0; x < nextWidth; ++x) {
+
+				const uint32_t x0 = std::min(x * 2, width - 1);
+				const uint32_t x1 = std::min(x * 2 + 1, width - 1);
+				const uint32_t y0 = std::min(y * 2, height - 1);
+				const uint32_t y1 = std::min(y * 2 + 1, height - 1);
+				const uint32_t texels[4] = { linearTexels[x0 + y0 * width], linearTexels[x1 + y0 * width], linearTexels[x0 + y1 * width], linearTexels[x1 + y1 * width] };
+
+				//Average every channel, rounded
+				uint32_t average = 0;
+				for (uint32_t shift = 0; shift < 32; shift += 8) {
+
+					uint32_t sum = 2;
+					for (uint32_t texel : texels)
+						sum += (texel >> shift) & 0xFF;
+					average |= (sum / 4) << shift;
+				}
+				nextTexels[x + y * nextWidth] = average;
+			}
+		}
+
+		linearTexels = std::move(nextTexels);
+		width = nextWidth;
+		height = nextHeight;
+	}
+}
+
+void Texture::CreateGPUTexture(const SDL_Surface* pSurface, ID3D11Device* pDevice)
+{
 	D3D11_TEXTURE2D_DESC desc;
-	desc.Width = m_pTexture->w;
-	desc.Height = m_pTexture->h;
+	desc.Width = pSurface->w;
+	desc.Height = pSurface->h;
 	desc.MipLevels = 1;
 	desc.ArraySize = 1;
 	desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
@@ -26,9 +292,9 @@ Texture::Texture(const std::string& path, ID3D11Device* pDevice)
 	desc.MiscFlags = 0;
 
 	D3D11_SUBRESOURCE_DATA initData;
-	initData.pSysMem = m_pTexture->pixels;
-	initData.SysMemPitch = static_cast<UINT>(m_pTexture->pitch);
-	initData.SysMemSlicePitch = static_cast<UINT>(m_pTexture->h * m_pTexture->pitch);
+	initData.pSysMem = pSurface->pixels;
+	initData.SysMemPitch = static_cast<UINT>(pSurface->pitch);
+	initData.SysMemSlicePitch = static_cast<UINT>(pSurface->h * pSurface->pitch);
 
 	HRESULT hr = pDevice->CreateTexture2D(&desc, &initData, &m_pGPUTexture);
 
@@ -38,35 +304,101 @@ Texture::Texture(const std::string& path, ID3D11Device* pDevice)
 	SRVDesc.Texture2D.MipLevels = 1;
 
 	hr = pDevice->CreateShaderResourceView(m_pGPUTexture, &SRVDesc, &m_pTextureResourceView);
-	
-	
 }
 
-Texture::~Texture()
+//log2 of the amount of texels (of level 0) the pixel covers along its longest side, like the LOD of a GPU
+float Texture::CalculateLod(const Elite::FVector2& dUVdx, const Elite::FVector2& dUVdy) const
 {
-	SDL_FreeSurface(m_pTexture);
-	if (m_pTextureResourceView)
-		m_pTextureResourceView->Release();
-	if (m_pGPUTexture)
-		m_pGPUTexture->Release();
+	const float width = float(m_MipLevels[0].Width);
+	const float height = float(m_MipLevels[0].Height);
+	const float lengthX = (dUVdx.x * width) * (dUVdx.x * width) + (dUVdx.y * height) * (dUVdx.y * height);
+	const float lengthY = (dUVdy.x * width) * (dUVdy.x * width) + (dUVdy.y * height) * (dUVdy.y * height);
+
+	//log2(sqrt(x)) = 0.5 * log2(x), magnification and invalid derivatives use level 0
+	const float lod = 0.5f * std::log2(std::max(lengthX, lengthY));
+	return lod > 0.f ? lod : 0.f;
 }
 
-bool Texture::IsValid() const
+//Coordinates outside of the level are clamped to its edge, min/max compile to conditional moves instead of branches
+uint32_t Texture::FetchTexel(const MipLevel& level, int x, int y) const
 {
-	return (m_pTexture != nullptr);
+	x = std::min(std::max(x, 0), int(level.Width) - 1);
+	y = std::min(std::max(y, 0), int(level.Height) - 1);
+	return level.Texels[GetTexelIndex(level.TilesPerRow, uint32_t(x), uint32_t(y))];
 }
 
-Elite::RGBColor Texture::Sample(const Elite::FVector2& uv) const
+Elite::FVector4 Texture::SamplePoint(const MipLevel& level, const Elite::FVector2& uv) const
 {
-	Uint8 r, g, b;
-	Elite::IVector2 newUv = { int(m_pTexture->w * uv.x), int(m_pTexture->h * uv.y) };
+	return UnpackTexel(FetchTexel(level, int(std::floor(uv.x * level.Width)), int(std::floor(uv.y * level.Height))));
+}
 
-	uint32_t pixel = *((uint32_t*)m_pTexture->pixels + newUv.y * (size_t)m_pTexture->w + newUv.x);
+//Blends the 4 texels around uv, texel centers lie at half texel offsets
+Elite::FVector4 Texture::SampleBilinear(const MipLevel& level, const Elite::FVector2& uv) const
+{
+	const float x = uv.x * level.Width - 0.5f;
+	const float y = uv.y * level.Height - 0.5f;
+	const float x0 = std::floor(x);
+	const float y0 = std::floor(y);
+	const float weightX = x - x0;
+	const float weightY = y - y0;
 
-	SDL_GetRGB(pixel, m_pTexture->format, &r, &g, &b);
-	return Elite::RGBColor{ float(r), float(g) ,float(b) } / 255.f;
+	const Elite::FVector4 top = UnpackTexel(FetchTexel(level, int(x0), int(y0))) * (1.f - weightX) + UnpackTexel(FetchTexel(level, int(x0) + 1, int(y0))) * weightX;
+	const Elite::FVector4 bottom = UnpackTexel(FetchTexel(level, int(x0), int(y0) + 1)) * (1.f - weightX) + UnpackTexel(FetchTexel(level, int(x0) + 1, int(y0) + 1)) * weightX;
+	return top * (1.f - weightY) + bottom * weightY;
 }
-ID3D11ShaderResourceView* Texture::GetTextureResourceView() const
+
+//Same as SampleBilinear, the 4 texels get unpacked to one float vector each and blended with SSE
+Elite::FVector4 Texture::SampleBilinearSIMD(const MipLevel& level, const Elite::FVector2& uv) const
 {
-	return m_pTextureResourceView;
+	const float x = uv.x * level.Width - 0.5f;
+	const float y = uv.y * level.Height - 0.5f;
+	const float x0 = std::floor(x);
+	const float y0 = std::floor(y);
+
+	//Gather the quad, every byte becomes a 32 bit lane
+	const __m128i texels = _mm_set_epi32(int(FetchTexel(level, int(x0) + 1, int(y0) + 1)), int(FetchTexel(level, int(x0), int(y0) + 1)), int(FetchTexel(level, int(x0) + 1, int(y0))), int(FetchTexel(level, int(x0), int(y0))));
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i topTexels = _mm_unpacklo_epi8(texels, zero);
+	const __m128i bottomTexels = _mm_unpackhi_epi8(texels, zero);
+	const __m128 topLeft = _mm_cvtepi32_ps(_mm_unpacklo_epi16(topTexels, zero));
+	const __m128 topRight = _mm_cvtepi32_ps(_mm_unpackhi_epi16(topTexels, zero));
+	const __m128 bottomLeft = _mm_cvtepi32_ps(_mm_unpacklo_epi16(bottomTexels, zero));
+	const __m128 bottomRight = _mm_cvtepi32_ps(_mm_unpackhi_epi16(bottomTexels, zero));
+
+	const __m128 weightX = _mm_set1_ps(x - x0);
+	const __m128 weightY = _mm_set1_ps(y - y0);
+	const __m128 top = _mm_add_ps(topLeft, _mm_mul_ps(_mm_sub_ps(topRight, topLeft), weightX));
+	const __m128 bottom = _mm_add_ps(bottomLeft, _mm_mul_ps(_mm_sub_ps(bottomRight, bottomLeft), weightX));
+	const __m128 color = _mm_mul_ps(_mm_add_ps(top, _mm_mul_ps(_mm_sub_ps(bottom, top), weightY)), _mm_set1_ps(1.f / 255.f));
+
+	alignas(16) float channels[4];
+	_mm_store_ps(channels, color);
+	return Elite::FVector4{ channels[0], channels[1], channels[2], channels[3] };
+}
+
+std::shared_ptr<const MaterialMaps> MaterialMaps::Load(const std::string& normalMapPath, const std::string& specularMapPath, const std::string& glossinessMapPath, ID3D11Device* pDevice)
+{
+	//Decoded once for both, the DirectX textures and the packed texture are made from the same surfaces
+	SDL_Surface* pNormalMap = LoadSurface(normalMapPath);
+	SDL_Surface* pSpecularMap = LoadSurface(specularMapPath);
+	SDL_Surface* pGlossinessMap = LoadSurface(glossinessMapPath);
+
+	auto pMaps = std::make_shared<MaterialMaps>();
+	pMaps->NormalMap = std::make_unique<Texture>(pNormalMap, pDevice, false);
+	pMaps->SpecularMap = std::make_unique<Texture>(pSpecularMap, pDevice, false);
+	pMaps->GlossinessMap = std::make_unique<Texture>(pGlossinessMap, pDevice, false);
+	pMaps->MaterialMap = std::make_unique<Texture>(pNormalMap, pSpecularMap, pGlossinessMap);
+
+	if (pNormalMap)
+		SDL_FreeSurface(pNormalMap);
+	if (pSpecularMap)
+		SDL_FreeSurface(pSpecularMap);
+	if (pGlossinessMap)
+		SDL_FreeSurface(pGlossinessMap);
+	return pMaps;
+}
+
+size_t MaterialMaps::GetMemorySize() const
+{
+	return NormalMap->GetMemorySize() + SpecularMap->GetMemorySize() + GlossinessMap->GetMemorySize() + MaterialMap->GetMemorySize();
 }
@@ -1,20 +1,74 @@
 #pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include "BaseEffect.h"
+
 class Texture final
 {
 public:
-	Texture(const std::string& path, ID3D11Device* pDevice);
+	//Without keepMipChain only the DirectX texture gets made, for maps the software rasterizer reads from a packed texture instead
+	Texture(const std::string& path, ID3D11Device* pDevice, bool keepMipChain = true);
+	//Packed material texture for the software rasterizer: normal.xy in red and green, specular in blue and glossiness in alpha.
+	//The specular and glossiness maps are resampled to the size of the normal map, normal.z gets rebuilt when shading
+	Texture(const std::string& normalMapPath, const std::string& specularMapPath, const std::string& glossinessMapPath);
+	//Same as above for images that are decoded already (RGBA32), the surfaces stay owned by the caller
+	Texture(const SDL_Surface* pSurface, ID3D11Device* pDevice, bool keepMipChain);
+	Texture(const SDL_Surface* pNormalMap, const SDL_Surface* pSpecularMap, const SDL_Surface* pGlossinessMap);
 	~Texture();
 	Texture(const Texture& other) = delete;
 	Texture& operator=(const Texture& other) = delete;
 	Texture(Texture&& other) = delete;
 	Texture& operator=(Texture&& other) = delete;
 
+	//Bilinear and trilinear sampling fetch their 4 texels with SSE, the scalar path is kept as a reference
+	static void SetSIMDGather(bool enabled);
+	//Texels one Sample or SampleRGBA call reads with the given mode
+	static uint32_t GetNrOfTexelFetches(BaseEffect::SampleMode mode);
+
 	bool IsValid() const;
-	Elite::RGBColor Sample(const Elite::FVector2& uv) const;
+	uint32_t GetNrOfMipLevels() const;
+	Elite::RGBColor Sample(const Elite::FVector2& uv, const Elite::FVector2& dUVdx, const Elite::FVector2& dUVdy, BaseEffect::SampleMode mode) const;
+	Elite::FVector4 SampleRGBA(const Elite::FVector2& uv, const Elite::FVector2& dUVdx, const Elite::FVector2& dUVdy, BaseEffect::SampleMode mode) const;
+	size_t GetMemorySize() const;
 	ID3D11ShaderResourceView* GetTextureResourceView() const;
 private:
-	SDL_Surface* m_pTexture;
+	//Texels as RGBA8, red in the lowest byte. Level 0 is the full texture, every next level half the size down to 1x1.
+	//The texels are stored in 4x4 tiles (64 bytes, one cache line) in Morton order, the tiles row by row,
+	//so texels that are close in u and v are close in memory as well
+	struct MipLevel {
+		uint32_t Width;
+		uint32_t Height;
+		uint32_t TilesPerRow;
+		std::vector<uint32_t> Texels;
+	};
+
+	static bool m_SIMDGather;
+
 	ID3D11Texture2D* m_pGPUTexture;
 	ID3D11ShaderResourceView* m_pTextureResourceView;
+	std::vector<MipLevel> m_MipLevels;
+
+	void CreateFromSurface(const SDL_Surface* pSurface, ID3D11Device* pDevice, bool keepMipChain);
+	void PackMaterialMaps(const SDL_Surface* pNormalMap, const SDL_Surface* pSpecularMap, const SDL_Surface* pGlossinessMap);
+	void BuildMipChain(std::vector<uint32_t> linearTexels, uint32_t width, uint32_t height);
+	void CreateGPUTexture(const SDL_Surface* pSurface, ID3D11Device* pDevice);
+	float CalculateLod(const Elite::FVector2& dUVdx, const Elite::FVector2& dUVdy) const;
+	uint32_t FetchTexel(const MipLevel& level, int x, int y) const;
+	Elite::FVector4 SamplePoint(const MipLevel& level, const Elite::FVector2& uv) const;
+	Elite::FVector4 SampleBilinear(const MipLevel& level, const Elite::FVector2& uv) const;
+	Elite::FVector4 SampleBilinearSIMD(const MipLevel& level, const Elite::FVector2& uv) const;
 };
 
+//The lighting maps of a material with every file decoded once: DirectX binds the separate maps, the software rasterizer samples the packed one.
+//Without a device the separate maps stay empty and only the packed one gets made
+struct MaterialMaps final
+{
+	std::unique_ptr<const Texture> NormalMap;
+	std::unique_ptr<const Texture> SpecularMap;
+	std::unique_ptr<const Texture> GlossinessMap;
+	std::unique_ptr<const Texture> MaterialMap;
+
+	static std::shared_ptr<const MaterialMaps> Load(const std::string& normalMapPath, const std::string& specularMapPath, const std::string& glossinessMapPath, ID3D11Device* pDevice);
+	size_t GetMemorySize() const;
+};
@@ -0,0 +1,161 @@
+#include "pch.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
+
+ThreadPool::ThreadPool(uint32_t nrOfWorkers)
+	: m_Queues{}
+	, m_Workers{}
+	, m_SleepMutex{}
+	, m_WakeUp{}
+	, m_PendingTasks{ 0 }
+	, m_NextQueue{ 0 }
+	, m_Stop{ false }
+{
+	//The workers name themselves in the profiler, it has to exist before they race to make it
+	Profiler::GetInstance();
+
+	//Queue 0 belongs to the thread that calls ParallelFor
+	for (uint32_t i = 0; i <= nrOfWorkers; ++i)
+		m_Queues.push_back(std::make_unique<TaskQueue>());
+
+	for (uint32_t i = 1; i <= nrOfWorkers; ++i)
+		m_Workers.emplace_back(&ThreadPool::WorkerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock{ m_SleepMutex };
+		m_Stop = true;
+	}
+	m_WakeUp.notify_all();
+
+	for (std::thread& worker : m_Workers)
+		worker.join();
+}
+
+uint32_t ThreadPool::GetNrOfThreads() const
+{
+	return (uint32_t)m_Queues.size();
+}
+
+void ThreadPool::ParallelFor(uint32_t count, const Job& job)
+{
+	if (count == 0)
+		return;
+
+	//Give every thread a contiguous range of jobs, neighbouring jobs (tiles) tend to cost the same
+	std::atomic<uint32_t> remainingJobs{ count };
+	const uint32_t nrOfThreads = GetNrOfThreads();
+	for (uint32_t i = 0; i < count; ++i) {
+
+		uint32_t queueIndex = uint32_t((uint64_t(i) * nrOfThreads) / count);
+		PushTask(queueIndex, [&job, &remainingJobs, i](uint32_t threadIndex) {
+			job(i, threadIndex);
+			remainingJobs.fetch_sub(1, std::memory_order_release);
+			});
+	}
+
+	//Taking the lock makes sure no worker is between checking for work and going to sleep
+	{
+		std::lock_guard<std::mutex> lock{ m_SleepMutex };
+	}
+	m_WakeUp.notify_all();
+
+	//Help out until every job of this call is done
+	while (remainingJobs.load(std::memory_order_acquire) > 0) {
+
+		if (!RunPendingTask(0))
+			std::this_thread::yield();
+	}
+}
+
+void ThreadPool::Submit(std::function<void()> task)
+{
+	if (m_Workers.empty()) {
+
+		task();
+		return;
+	}
+
+	//Round robin over the worker queues, idle workers steal whatever ends up unbalanced
+	const uint32_t queueIndex = 1 + m_NextQueue.fetch_add(1) % uint32_t(m_Workers.size());
+	PushTask(queueIndex, [task](uint32_t) {
+		task();
+		});
+
+	{
+		std::lock_guard<std::mutex> lock{ m_SleepMutex };
+	}
+	m_WakeUp.notify_one();
+}
+
+void ThreadPool::WorkerLoop(uint32_t threadIndex)
+{
+	Profiler::GetInstance()->SetThreadName("Worker " + std::to_string(threadIndex));
+	while (true) {
+
+		if (RunPendingTask(threadIndex))
+			continue;
+
+		std::unique_lock<std::mutex> lock{ m_SleepMutex };
+		m_WakeUp.wait(lock, [this]() {
+			return m_Stop || m_PendingTasks.load() > 0;
+			});
+
+		if (m_Stop)
+			return;
+	}
+}
+
+void ThreadPool::PushTask(uint32_t queueIndex, Task&& task)
+{
+	TaskQueue& queue = *m_Queues[queueIndex];
+	std::lock_guard<std::mutex> lock{ queue.Mutex };
+	queue.Tasks.push_back(std::move(task));
+	++m_PendingTasks;
+}
+
+bool ThreadPool::RunPendingTask(uint32_t threadIndex)
+{
+	Task task;
+	if (!PopTask(threadIndex, task) && !StealTask(threadIndex, task))
+		return false;
+
+	task(threadIndex);
+	return true;
+}
+
+//Own queue gets emptied from the front
+bool ThreadPool::PopTask(uint32_t queueIndex, Task& task)
+{
+	TaskQueue& queue = *m_Queues[queueIndex];
+	std::lock_guard<std::mutex> lock{ queue.Mutex };
+	if (queue.Tasks.empty())
+		return false;
+
+	task = std::move(queue.Tasks.front());
+	queue.Tasks.pop_front();
+	--m_PendingTasks;
+	return true;
+}
+
+//Other queues get robbed from the back, so the owner and the thief don't fight over the same tasks
+bool ThreadPool::StealTask(uint32_t queueIndex, Task& task)
+{
+	const uint32_t nrOfQueues = (uint32_t)m_Queues.size();
+	for (uint32_t offset = 1; offset < nrOfQueues; ++offset) {
+
+		TaskQueue& queue = *m_Queues[(queueIndex + offset) % nrOfQueues];
+		std::lock_guard<std::mutex> lock{ queue.Mutex };
+		if (queue.Tasks.empty())
+			continue;
+
+		task = std::move(queue.Tasks.back());
+		queue.Tasks.pop_back();
+		--m_PendingTasks;
+		return true;
+	}
+
+	return false;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//Pool of worker threads with one task queue per thread.
+//A thread first empties its own queue and then steals from the back of the others,
+//so uneven jobs (like tiles with a lot of triangles) get balanced automatically.
+class ThreadPool final
+{
+public:
+	using Job = std::function<void(uint32_t jobIndex, uint32_t threadIndex)>;
+
+	ThreadPool(uint32_t nrOfWorkers);
+	~ThreadPool();
+	ThreadPool(const ThreadPool& other) = delete;
+	ThreadPool& operator=(const ThreadPool& other) = delete;
+	ThreadPool(ThreadPool&& other) = delete;
+	ThreadPool& operator=(ThreadPool&& other) = delete;
+
+	//Returns the amount of threads that can run jobs, the calling thread included (index 0)
+	uint32_t GetNrOfThreads() const;
+
+	//Runs job(i, threadIndex) for every i in [0, count) and returns once all of them are done.
+	//The calling thread helps out instead of just waiting.
+	void ParallelFor(uint32_t count, const Job& job);
+
+	//Runs task on one of the workers and returns right away, without workers the calling thread runs it before returning
+	void Submit(std::function<void()> task);
+private:
+	using Task = std::function<void(uint32_t threadIndex)>;
+	struct TaskQueue {
+		std::mutex Mutex;
+		std::deque<Task> Tasks;
+	};
+
+	//Variables
+	std::vector<std::unique_ptr<TaskQueue>> m_Queues;
+	std::vector<std::thread> m_Workers;
+	std::mutex m_SleepMutex;
+	std::condition_variable m_WakeUp;
+	std::atomic<uint32_t> m_PendingTasks;
+	std::atomic<uint32_t> m_NextQueue;
+	bool m_Stop;
+
+	//Functions
+	void WorkerLoop(uint32_t threadIndex);
+	void PushTask(uint32_t queueIndex, Task&& task);
+	bool RunPendingTask(uint32_t threadIndex);
+	bool PopTask(uint32_t queueIndex, Task& task);
+	bool StealTask(uint32_t queueIndex, Task& task);
+};
@@ -0,0 +1,118 @@
+#pragma once
+#include <cmath>
+#include <cstring>
+#include "Structs.h"
+
+//Conversion between InputVertex and QuantizedVertex.
+//Positions become 16 bit fractions of the bounds of their mesh, decoded as offset + q * scale (scale = bounds extent / 65535).
+//Normals and tangents are folded on an octahedron, two 16 bit components each; uvs are half floats, colors 8 bit in [0, 1]
+namespace VertexQuantization
+{
+	inline uint16_t FloatToHalf(float value) {
+
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		const uint32_t sign = (bits >> 16) & 0x8000;
+		bits &= 0x7FFFFFFF;
+
+		//Too big for a half (or inf, nan)
+		if (bits >= 0x47800000)
+			return uint16_t(sign | (bits > 0x7F800000 ? 0x7E00 : 0x7C00));
+
+		//Below the smallest normal half, counted in steps of 2^-24
+		if (bits < 0x38800000) {
+
+			float absolute;
+			std::memcpy(&absolute, &bits, sizeof(absolute));
+			return uint16_t(sign | uint32_t(std::lround(absolute * 16777216.f)));
+		}
+
+		//Exponent bias 127 to 15, the mantissa rounded to the nearest even 10 bits
+		bits -= 0x38000000;
+		bits += 0x0FFF + ((bits >> 13) & 1);
+		return uint16_t(sign | (bits >> 13));
+	}
+
+	inline float HalfToFloat(uint16_t half) {
+
+		const uint32_t exponent = (half >> 10) & 0x1F;
+		const uint32_t mantissa = half & 0x3FF;
+		uint32_t bits;
+		if (exponent == 0) {
+
+			const float value = float(mantissa) * (1.f / 16777216.f);
+			std::memcpy(&bits, &value, sizeof(bits));
+		}
+		else
+			bits = ((exponent == 31 ? 255u : exponent + 112) << 23) | (mantissa << 13);
+
+		bits |= uint32_t(half & 0x8000) << 16;
+		float value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	//The vector is projected on the octahedron |x| + |y| + |z| = 1, the lower half gets folded over the upper one.
+	//A zero (or nan) vector becomes (0, 0), which decodes to (0, 0, 1)
+	inline void EncodeOctahedral(const Elite::FVector3& vector, int16_t encoded[2]) {
+
+		const float length = std::abs(vector.x) + std::abs(vector.y) + std::abs(vector.z);
+		if (!(length > 0.f)) {
+
+			encoded[0] = 0;
+			encoded[1] = 0;
+			return;
+		}
+
+		float x = vector.x / length;
+		float y = vector.y / length;
+		if (vector.z < 0.f) {
+
+			const float foldedX = (1.f - std::abs(y)) * (x >= 0.f ? 1.f : -1.f);
+			y = (1.f - std::abs(x)) * (y >= 0.f ? 1.f : -1.f);
+			x = foldedX;
+		}
+		encoded[0] = int16_t(std::lround(Elite::Clamp(x, -1.f, 1.f) * 32767.f));
+		encoded[1] = int16_t(std::lround(Elite::Clamp(y, -1.f, 1.f) * 32767.f));
+	}
+
+	inline Elite::FVector3 DecodeOctahedral(const int16_t encoded[2]) {
+
+		float x = encoded[0] * (1.f / 32767.f);
+		float y = encoded[1] * (1.f / 32767.f);
+		const float z = 1.f - std::abs(x) - std::abs(y);
+		const float fold = std::max(-z, 0.f);
+		x += x >= 0.f ? -fold : fold;
+		y += y >= 0.f ? -fold : fold;
+		return Elite::GetNormalized(Elite::FVector3{ x, y, z });
+	}
+
+	inline QuantizedVertex Encode(const InputVertex& vertex, const Elite::FPoint3& boundsMin, const Elite::FVector3& boundsExtent) {
+
+		QuantizedVertex quantized{};
+		for (int axis = 0; axis < 3; ++axis) {
+
+			const float fraction = boundsExtent.data[axis] > 0.f ? (vertex.Position.data[axis] - boundsMin.data[axis]) / boundsExtent.data[axis] : 0.f;
+			quantized.Position[axis] = uint16_t(std::lround(Elite::Clamp(fraction, 0.f, 1.f) * 65535.f));
+		}
+		quantized.UV[0] = FloatToHalf(vertex.UV.x);
+		quantized.UV[1] = FloatToHalf(vertex.UV.y);
+		EncodeOctahedral(vertex.Normal, quantized.Normal);
+		EncodeOctahedral(vertex.Tangent, quantized.Tangent);
+		quantized.Color[0] = uint8_t(std::lround(Elite::Clamp(vertex.Color.r, 0.f, 1.f) * 255.f));
+		quantized.Color[1] = uint8_t(std::lround(Elite::Clamp(vertex.Color.g, 0.f, 1.f) * 255.f));
+		quantized.Color[2] = uint8_t(std::lround(Elite::Clamp(vertex.Color.b, 0.f, 1.f) * 255.f));
+		quantized.Color[3] = 255;
+		return quantized;
+	}
+
+	inline InputVertex Decode(const QuantizedVertex& quantized, const Elite::FPoint3& offset, const Elite::FVector3& scale) {
+
+		return InputVertex{
+			Elite::FPoint3{ offset.x + quantized.Position[0] * scale.x, offset.y + quantized.Position[1] * scale.y, offset.z + quantized.Position[2] * scale.z },
+			Elite::FVector2{ HalfToFloat(quantized.UV[0]), HalfToFloat(quantized.UV[1]) },
+			DecodeOctahedral(quantized.Normal),
+			DecodeOctahedral(quantized.Tangent),
+			Elite::RGBColor{ quantized.Color[0] * (1.f / 255.f), quantized.Color[1] * (1.f / 255.f), quantized.Color[2] * (1.f / 255.f) } };
+	}
+}
@@ -3,6 +3,9 @@
 
 //Standard includes
 #include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <string>
 
 //Project includes
 #include "ETimer.h"
@@ -11,7 +14,9 @@
 #include "SceneGraph.h"
 #include "CameraManager.h"
 #include "EffectManager.h"
-#include "ObjParser.h"
+#include "CookedMesh.h"
+#include "AssetCache.h"
+#include "Profiler.h"
 
 void ShutDown(SDL_Window* pWindow)
 {
@@ -39,6 +44,193 @@ void CheckMouseInputs() {
 	}
 }
 
+//Settings that can be changed on the command line
+struct CommandLineOptions {
+
+	bool Headless = false;
+	uint32_t Width = 640;
+	uint32_t Height = 480;
+	uint32_t NrOfFrames = 100;
+	std::string DumpPrefix; //Empty means no frames get written
+	std::string DumpFormat = "ppm";
+	std::string TracePath; //Empty means no trace gets written
+	std::vector<std::string> CookPaths; //.obj files to cook before quitting, nothing gets rendered
+};
+
+void PrintUsage() {
+
+	std::cout << "Usage: directx [--headless] [--width W] [--height H] [--frames N] [--dump prefix] [--format ppm|png] [--trace trace.json] [--cook file.obj]...\n";
+	std::cout << "--headless: Render with the software rasterizer only, without a window or DirectX device\n";
+	std::cout << "--frames: Amount of frames to render before quitting (headless only)\n";
+	std::cout << "--dump: Write every frame to prefix_0000.ppm, prefix_0001.ppm, ... (headless only)\n";
+	std::cout << "--trace: Write the timings of the last frames as a Chrome trace (headless only)\n";
+	std::cout << "--cook: Write the cooked mesh of the .obj file next to it and quit, can be given more than once\n";
+}
+
+//Returns false if the arguments could not be parsed
+bool ParseCommandLine(int argc, char* args[], CommandLineOptions& options) {
+
+	try {
+		for (int i = 1; i < argc; ++i) {
+
+			const std::string argument = args[i];
+			const bool hasValue = i + 1 < argc;
+			if (argument == "--headless")
+				options.Headless = true;
+			else if (argument == "--width" && hasValue)
+				options.Width = uint32_t(std::stoul(args[++i]));
+			else if (argument == "--height" && hasValue)
+				options.Height = uint32_t(std::stoul(args[++i]));
+			else if (argument == "--frames" && hasValue)
+				options.NrOfFrames = uint32_t(std::stoul(args[++i]));
+			else if (argument == "--dump" && hasValue)
+				options.DumpPrefix = args[++i];
+			else if (argument == "--format" && hasValue)
+				options.DumpFormat = args[++i];
+			else if (argument == "--trace" && hasValue)
+				options.TracePath = args[++i];
+			else if (argument == "--cook" && hasValue)
+				options.CookPaths.push_back(args[++i]);
+			else
+				return false;
+		}
+	}
+	catch (const std::exception&) {
+		return false;
+	}
+
+	return options.Width > 0 && options.Height > 0 && (options.DumpFormat == "ppm" || options.DumpFormat == "png");
+}
+
+//pDevice can be nullptr when running headless
+void CreateScene(ID3D11Device* pDevice, uint32_t width, uint32_t height) {
+
+	try {
+		bool rotate = true;
+
+		//Start loading the files of both meshes, they load on the asset threads while the effects get compiled
+		const Mesh::Assets vehicleAssets = Mesh::LoadAssets("Resources/vehicle.obj", "Resources/vehicle_diffuse.png", "Resources/vehicle_normal.png", "Resources/vehicle_specular.png", "Resources/vehicle_gloss.png", pDevice);
+		const Mesh::Assets flameAssets = Mesh::LoadAssets("Resources/fireFX.obj", "Resources/fireFX_diffuse.png", "", "", "", pDevice);
+
+		//Add Camera
+		CameraManager::GetInstance()->AddNewCamera(new Camera{ { 0.f, 5.f, 35.f }, {0.f, 0.f, 1.f}, width, height });
+
+		//Create Effect
+		EffectManager::GetInstance()->AddEffect("VehicleEffect", new MaterialEffect{pDevice, L"Resources/PosCol3D.fx" });
+		EffectManager::GetInstance()->AddEffect("FlameEffect", new FlatEffect{pDevice, L"Resources/Transparency.fx" });
+
+		//Add Objects to SceneGraph, every mesh waits for its own files
+		SceneGraph::GetInstance()->AddObjectToGraph(new Mesh{ rotate, {}, vehicleAssets, pDevice, EffectManager::GetInstance()->GetEffect("VehicleEffect")});
+
+		SceneGraph::GetInstance()->AddObjectToGraph(new Mesh{ rotate, {}, flameAssets, pDevice, EffectManager::GetInstance()->GetEffect("FlameEffect") });
+
+	}
+	catch (std::runtime_error e) {
+		std::cout << e.what();
+	}
+}
+
+void DeleteScene() {
+
+	delete SceneGraph::GetInstance();
+	delete CameraManager::GetInstance();
+	delete EffectManager::GetInstance();
+	delete AssetCache::GetInstance();
+	delete Profiler::GetInstance();
+}
+
+//Startup latency, from the start of main until the first frame got rendered
+void PrintTimeToFirstFrame(uint64_t startCounter, uint64_t sceneLoadedCounter) {
+
+	const double toMilliseconds = 1000.0 / double(SDL_GetPerformanceFrequency());
+	std::cout << "Time to first frame: " << double(SDL_GetPerformanceCounter() - startCounter) * toMilliseconds << " ms (scene loaded after "
+		<< double(sceneLoadedCounter - startCounter) * toMilliseconds << " ms)\n";
+}
+
+//The offline cook step, afterwards loading these meshes maps the cooked files instead of parsing the .obj files
+int CookMeshes(const CommandLineOptions& options) {
+
+	int result = 0;
+	for (const std::string& path : options.CookPaths) {
+
+		try {
+			CookedMesh::CookStatistics statistics{};
+			if (CookedMesh::Cook(path, true, &statistics)) {
+
+				std::cout << "Cooked " << path << " to " << CookedMesh::GetCookedPath(path) << '\n';
+				std::cout << "  ACMR " << statistics.Parsed.ACMR << " -> " << statistics.Cooked.ACMR
+					<< ", ATVR " << statistics.Parsed.ATVR << " -> " << statistics.Cooked.ATVR
+					<< ", overdraw " << statistics.Parsed.Overdraw << " -> " << statistics.Cooked.Overdraw << '\n';
+				std::cout << "  Levels of detail:";
+				for (uint32_t triangles : statistics.LodTriangles)
+					std::cout << ' ' << triangles;
+				std::cout << " triangles\n";
+			}
+			else {
+				std::cout << "Could not write " << CookedMesh::GetCookedPath(path) << '\n';
+				result = 1;
+			}
+		}
+		catch (const std::exception& exception) {
+			std::cout << exception.what() << '\n';
+			result = 1;
+		}
+	}
+
+	return result;
+}
+
+//Renders a fixed amount of frames without a window, every frame advances the scene by 1/60th of a second
+int RunHeadless(const CommandLineOptions& options, uint64_t startCounter) {
+
+	//The software rasterizer only, the cameras have to be made for it
+	if (SceneGraph::GetInstance()->GetRenderMode() != RenderMode::Rasterizer)
+		SceneGraph::GetInstance()->ToggleRenderMode();
+
+	auto pRenderer{ std::make_unique<Elite::Renderer>(options.Width, options.Height) };
+	CreateScene(nullptr, options.Width, options.Height);
+	const uint64_t sceneLoadedCounter = SDL_GetPerformanceCounter();
+
+	const float frameTime = 1.f / 60.f;
+	const uint64_t frequency = SDL_GetPerformanceFrequency();
+	uint64_t totalCounts = 0;
+	for (uint32_t frame = 0; frame < options.NrOfFrames; ++frame) {
+
+		const uint64_t start = SDL_GetPerformanceCounter();
+		pRenderer->Render();
+		totalCounts += SDL_GetPerformanceCounter() - start;
+		if (frame == 0)
+			PrintTimeToFirstFrame(startCounter, sceneLoadedCounter);
+
+		if (!options.DumpPrefix.empty()) {
+
+			std::stringstream path;
+			path << options.DumpPrefix << '_' << std::setw(4) << std::setfill('0') << frame << '.' << options.DumpFormat;
+			pRenderer->SaveFrame(path.str());
+		}
+
+		SceneGraph::GetInstance()->Update(frameTime);
+	}
+
+	if (options.NrOfFrames > 0) {
+
+		const double totalMilliseconds = double(totalCounts) * 1000.0 / double(frequency);
+		std::cout << "Rendered " << options.NrOfFrames << " frames in " << totalMilliseconds << " ms ("
+			<< totalMilliseconds / options.NrOfFrames << " ms per frame)\n";
+		pRenderer->PrintFrameStatistics();
+		Profiler::GetInstance()->PrintStageStatistics();
+		AssetCache::GetInstance()->PrintMemoryUsage();
+	}
+
+	if (!options.TracePath.empty())
+		Profiler::GetInstance()->ExportChromeTrace(options.TracePath);
+
+	pRenderer.reset();
+	DeleteScene();
+	SDL_Quit();
+	return 0;
+}
+
 void PrintStartUpInformation() {
 
 	std::cout << "-------Rasterizer and DirectX Combo-------\n";
@@ -52,23 +244,43 @@ void PrintStartUpInformation() {
 	std::cout << "R: Swap render mode (DirectX or Rasterizer)\n";
 	std::cout << "T: Toggle transparency of flames (DirectX only)\n";
 	std::cout << "D: Toggle depth rendering (Rasterizer only)\n";
-	std::cout << "F: Toggle sampling mode (Point, Linear, Anisotropic) (DirectX only)\n";
+	std::cout << "F: Toggle sampling mode (Point, Linear, Anisotropic) (Rasterizer: point, bilinear, trilinear)\n";
 	std::cout << "X: Toggle rendering of effects (DirectX or Rasterizer)\n";
 	std::cout << "C: Toggle cullmode (Back, Front, None)\n";
+	std::cout << "M: Toggle multithreaded tile rendering (Rasterizer only)\n";
+	std::cout << "S: Toggle rasterization mode (Reference, SIMD, FixedPoint) (Rasterizer only)\n";
+	std::cout << "V: Toggle visibility buffer rendering (Rasterizer only)\n";
+	std::cout << "O: Toggle overdraw heat map rendering (Rasterizer only)\n";
+	std::cout << "P: Toggle profiling of the render stages\n";
+	std::cout << "E: Export the profiled frames to trace.json (chrome://tracing or ui.perfetto.dev)\n";
+	std::cout << "A: Print the memory used by every loaded asset\n";
+	std::cout << "Q: Toggle quantized vertices (Rasterizer only, cooked meshes)\n";
+	std::cout << "L: Toggle level of detail selection (DirectX or Rasterizer)\n";
+	std::cout << "K: Toggle the level of detail error threshold (0.5, 1, 2, 4, 8 pixels)\n";
+	std::cout << "H: Toggle the Hi-Z rejection (Rasterizer only, SIMD and FixedPoint)\n";
 	std::cout << "-----------------------------------------\n";
 }
 
 int main(int argc, char* args[])
 {
-	//Unreferenced parameters
-	(void)argc;
-	(void)args;
+	const uint64_t startCounter = SDL_GetPerformanceCounter();
+	CommandLineOptions options{};
+	if (!ParseCommandLine(argc, args, options)) {
+
+		PrintUsage();
+		return 1;
+	}
+
+	if (!options.CookPaths.empty())
+		return CookMeshes(options);
+	if (options.Headless)
+		return RunHeadless(options, startCounter);
 
 	//Create window + surfaces
 	SDL_Init(SDL_INIT_VIDEO);
 
-	const uint32_t width = 640;
-	const uint32_t height = 480;
+	const uint32_t width = options.Width;
+	const uint32_t height = options.Height;
 	SDL_Window* pWindow = SDL_CreateWindow(
 		"DirectX - **Elias De Herdt**",
 		SDL_WINDOWPOS_UNDEFINED,
@@ -83,29 +295,9 @@ int main(int argc, char* args[])
 	//Initialize "framework"
 	auto pTimer{ std::make_unique<Elite::Timer>() };
 	auto pRenderer{ std::make_unique<Elite::Renderer>(pWindow) };
-	ID3D11Device* pDevice = pRenderer->GetDevice();
-
-	try {
-		bool rotate = true;
-
-		//Add Camera
-		CameraManager::GetInstance()->AddNewCamera(new Camera{ { 0.f, 5.f, 35.f }, {0.f, 0.f, 1.f}, width, height });
-
-		//Create Effect
-		EffectManager::GetInstance()->AddEffect("VehicleEffect", new MaterialEffect{pDevice, L"Resources/PosCol3D.fx" });
-		EffectManager::GetInstance()->AddEffect("FlameEffect", new FlatEffect{pDevice, L"Resources/Transparency.fx" });
-
-		//Add Objects to SceneGraph
-		auto readFile1 = ObjParser::GetInstance()->ReadObjFile("Resources/vehicle.obj");
-		SceneGraph::GetInstance()->AddObjectToGraph(new Mesh{ rotate, {}, "Resources/vehicle_diffuse.png", "Resources/vehicle_normal.png", "Resources/vehicle_specular.png", "Resources/vehicle_gloss.png", pDevice, readFile1.first, readFile1.second, EffectManager::GetInstance()->GetEffect("VehicleEffect")});
-
-		auto readFile2 = ObjParser::GetInstance()->ReadObjFile("Resources/fireFX.obj");
-		SceneGraph::GetInstance()->AddObjectToGraph(new Mesh{ rotate, {}, "Resources/fireFX_diffuse.png", "", "", "", pDevice, readFile2.first, readFile2.second, EffectManager::GetInstance()->GetEffect("FlameEffect") });
-
-	}
-	catch (std::runtime_error e) {
-		std::cout << e.what();
-	}
+	CreateScene(pRenderer->GetDevice(), width, height);
+	const uint64_t sceneLoadedCounter = SDL_GetPerformanceCounter();
+	bool firstFrame = true;
 	
 	//Start loop
 	pTimer->Start();
@@ -139,6 +331,28 @@ int main(int argc, char* args[])
 					pRenderer->ToggleEffectRendering();
 				if (e.key.keysym.scancode == SDL_SCANCODE_C)
 					EffectManager::GetInstance()->ToggleObjectCulling();
+				if (e.key.keysym.scancode == SDL_SCANCODE_M)
+					pRenderer->ToggleMultiThreading();
+				if (e.key.keysym.scancode == SDL_SCANCODE_S)
+					pRenderer->ToggleRasterizationMode();
+				if (e.key.keysym.scancode == SDL_SCANCODE_V)
+					pRenderer->ToggleVisibilityBufferRendering();
+				if (e.key.keysym.scancode == SDL_SCANCODE_O)
+					pRenderer->ToggleOverdrawRendering();
+				if (e.key.keysym.scancode == SDL_SCANCODE_P)
+					Profiler::GetInstance()->ToggleEnabled();
+				if (e.key.keysym.scancode == SDL_SCANCODE_E)
+					Profiler::GetInstance()->ExportChromeTrace("trace.json");
+				if (e.key.keysym.scancode == SDL_SCANCODE_A)
+					AssetCache::GetInstance()->PrintMemoryUsage();
+				if (e.key.keysym.scancode == SDL_SCANCODE_Q)
+					pRenderer->ToggleQuantizedVertices();
+				if (e.key.keysym.scancode == SDL_SCANCODE_L)
+					pRenderer->ToggleLodSelection();
+				if (e.key.keysym.scancode == SDL_SCANCODE_K)
+					pRenderer->ToggleLodErrorThreshold();
+				if (e.key.keysym.scancode == SDL_SCANCODE_H)
+					pRenderer->ToggleHiZ();
 				break;
 			}
 		}
@@ -147,6 +361,11 @@ int main(int argc, char* args[])
 
 		//--------- Render ---------
 		pRenderer->Render();
+		if (firstFrame) {
+
+			PrintTimeToFirstFrame(startCounter, sceneLoadedCounter);
+			firstFrame = false;
+		}
 
 		//--------- Timer ---------
 		pTimer->Update();
@@ -155,6 +374,10 @@ int main(int argc, char* args[])
 		{
 			printTimer = 0.f;
 			std::cout << "FPS: " << pTimer->GetFPS() << std::endl;
+			if (SceneGraph::GetInstance()->GetRenderMode() == RenderMode::Rasterizer)
+				pRenderer->PrintFrameStatistics();
+			if (Profiler::GetInstance()->IsEnabled())
+				Profiler::GetInstance()->PrintStageStatistics();
 		}
 
 		//Update
@@ -162,10 +385,7 @@ int main(int argc, char* args[])
 
 	}
 	pTimer->Stop();
-	delete SceneGraph::GetInstance();
-	delete CameraManager::GetInstance();
-	delete EffectManager::GetInstance();
-	delete ObjParser::GetInstance();
+	DeleteScene();
 
 	//Shutdown "framework"
 	ShutDown(pWindow);